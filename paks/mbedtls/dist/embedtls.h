@@ -19,6 +19,12 @@
     #define MBEDTLS_THREADING_C
     #define MBEDTLS_THREADING_ALT
     typedef struct MprMutex* mbedtls_threading_mutex_t;
+#elif ME_GOAHEAD_THREADS
+    /*
+        GoAhead event loop threads share the random generator, session cache, ticket keys and private key
+     */
+    #define MBEDTLS_THREADING_C
+    #define MBEDTLS_THREADING_PTHREAD
 #endif
 
 #if ME_DEBUG
@@ -35,6 +35,8 @@
 
 static WebsHash users = -1;
 static WebsHash roles = -1;
+static WebsHash stageUsers = -1;        /* Users being loaded by websReload */
+static WebsHash stageRoles = -1;        /* Roles being loaded by websReload */
 static char *masterSecret;
 static int autoLogin = ME_GOAHEAD_AUTO_LOGIN;
 static WebsVerify verifyPassword = websVerifyPasswordFromFile;
@@ -63,6 +65,8 @@ static void computeUserAbilities(WebsUser *user);
 static WebsUser *createUser(cchar *username, cchar *password, cchar *roles);
 static void freeRole(WebsRole *rp);
 static void freeUser(WebsUser *up);
+static WebsHash roleTable(void);
+static WebsHash userTable(void);
 static void logoutServiceProc(Webs *wp);
 static void loginServiceProc(Webs *wp);
 
@@ -174,29 +178,96 @@ PUBLIC int websOpenAuth(int minimal)
 
 
 PUBLIC void websCloseAuth(void)
+{
+    wfree(masterSecret);
+    websCommitAuth(0, 0, 0);
+    websFreeAuth(users, roles);
+    users = roles = -1;
+}
+
+
+/*
+    Remove all users and roles. The master secret is retained so outstanding digest nonces remain valid.
+ */
+PUBLIC void websResetAuth(void)
+{
+    websFreeAuth(users, roles);
+    users = hashCreate(-1);
+    roles = hashCreate(-1);
+}
+
+
+/*
+    Start a new set of users and roles to be loaded off to the side of the current set (see websReload)
+ */
+PUBLIC int websStageAuth(void)
+{
+    websCommitAuth(0, 0, 0);
+    if ((stageUsers = hashCreate(-1)) < 0) {
+        return -1;
+    }
+    if ((stageRoles = hashCreate(-1)) < 0) {
+        hashFree(stageUsers);
+        stageUsers = -1;
+        return -1;
+    }
+    return 0;
+}
+
+
+/*
+    Make the staged users and roles current and return the prior tables, or discard the staged tables
+ */
+PUBLIC void websCommitAuth(bool commit, WebsHash *priorUsers, WebsHash *priorRoles)
+{
+    if (commit && stageUsers >= 0) {
+        *priorUsers = users;
+        *priorRoles = roles;
+        users = stageUsers;
+        roles = stageRoles;
+    } else {
+        websFreeAuth(stageUsers, stageRoles);
+    }
+    stageUsers = stageRoles = -1;
+}
+
+
+PUBLIC void websFreeAuth(WebsHash userHash, WebsHash roleHash)
 {
     WebsKey     *key, *next;
 
-    wfree(masterSecret);
-    if (users >= 0) {
-        for (key = hashFirst(users); key; key = next) {
-            next = hashNext(users, key);
+    if (userHash >= 0) {
+        for (key = hashFirst(userHash); key; key = next) {
+            next = hashNext(userHash, key);
             freeUser(key->content.value.symbol);
         }
-        hashFree(users);
-        users = -1;
+        hashFree(userHash);
     }
-    if (roles >= 0) {
-        for (key = hashFirst(roles); key; key = next) {
-            next = hashNext(roles, key);
+    if (roleHash >= 0) {
+        for (key = hashFirst(roleHash); key; key = next) {
+            next = hashNext(roleHash, key);
             freeRole(key->content.value.symbol);
         }
-        hashFree(roles);
-        roles = -1;
+        hashFree(roleHash);
     }
 }
 
 
+/*
+    Tables modified by websAddUser and websAddRole. These are the staged tables while websReload is loading.
+ */
+static WebsHash userTable(void)
+{
+    return stageUsers >= 0 ? stageUsers : users;
+}
+
+
+static WebsHash roleTable(void)
+{
+    return stageRoles >= 0 ? stageRoles : roles;
+}
+
+
 #if KEEP
 PUBLIC int websWriteAuthFile(char *path)
 {
@@ -272,7 +343,7 @@ WebsUser *websAddUser(cchar *username, cchar *password, cchar *roles)
         error("User is missing name");
         return 0;
     }
-    if (websLookupUser(username)) {
+    if (hashLookup(userTable(), username)) {
         error("User %s already exists", username);
         /* Already exists */
         return 0;
@@ -280,7 +351,7 @@ WebsUser *websAddUser(cchar *username, cchar *password, cchar *roles)
     if ((user = createUser(username, password, roles)) == 0) {
         return 0;
     }
-    if (hashEnter(users, username, valueSymbol(user), 0) == 0) {
+    if (hashEnter(userTable(), username, valueSymbol(user), 0) == 0) {
         return 0;
     }
     return user;
@@ -351,10 +422,30 @@ WebsUser *websLookupUser(cchar *username)
 }
 
 
+/*
+    Requests use the users of the route set they were routed with, so a reload does not change users mid-request
+ */
+PUBLIC WebsUser *websLookupRequestUser(Webs *wp, cchar *username)
+{
+    WebsKey     *key;
+    WebsHash    table;
+
+    assert(wp);
+    assert(username);
+
+    websGetRouteAuth(wp, &table, 0);
+    if (table < 0 || (key = hashLookup(table, username)) == 0) {
+        return 0;
+    }
+    return (WebsUser*) key->content.value.symbol;
+}
+
+
 static void computeAbilities(WebsHash abilities, cchar *role, int depth)
 {
     WebsRole    *rp;
     WebsKey     *key;
+    WebsHash    table;
 
     assert(abilities >= 0);
     assert(role && *role);
@@ -364,8 +455,8 @@ static void computeAbilities(WebsHash abilities, cchar *role, int depth)
         error("Recursive ability definition for %s", role);
         return;
     }
-    if (roles >= 0) {
-        if ((key = hashLookup(roles, role)) != 0) {
+    if ((table = roleTable()) >= 0) {
+        if ((key = hashLookup(table, role)) != 0) {
             rp = (WebsRole*) key->content.value.symbol;
             for (key = hashFirst(rp->abilities); key; key = hashNext(rp->abilities, key)) {
                 computeAbilities(abilities, key->name.value.string, ++depth);
@@ -408,9 +499,10 @@ PUBLIC void websComputeAllUserAbilities(void)
 {
     WebsUser    *user;
     WebsKey     *sym;
+    WebsHash    table;
 
-    if (users) {
-        for (sym = hashFirst(users); sym; sym = hashNext(users, sym)) {
+    if ((table = userTable()) >= 0) {
+        for (sym = hashFirst(table); sym; sym = hashNext(table, sym)) {
             user = (WebsUser*) sym->content.value.symbol;
             computeUserAbilities(user);
         }
@@ -426,7 +518,7 @@ WebsRole *websAddRole(cchar *name, WebsHash abilities)
         error("Role is missing name");
         return 0;
     }
-    if (hashLookup(roles, name)) {
+    if (hashLookup(roleTable(), name)) {
         error("Role %s already exists", name);
         /* Already exists */
         return 0;
@@ -435,7 +527,7 @@ WebsRole *websAddRole(cchar *name, WebsHash abilities)
         return 0;
     }
     rp->abilities = abilities;
-    if (hashEnter(roles, name, valueSymbol(rp), 0) == 0) {
+    if (hashEnter(roleTable(), name, valueSymbol(rp), 0) == 0) {
         return 0;
     }
     return rp;
@@ -587,7 +679,7 @@ PUBLIC bool websVerifyPasswordFromFile(Webs *wp)
     bool    success;
 
     assert(wp);
-    if (!wp->user && (wp->user = websLookupUser(wp->username)) == 0) {
+    if (!wp->user && (wp->user = websLookupRequestUser(wp, wp->username)) == 0) {
         trace(5, "verifyUser: Unknown user \"%s\"", wp->username);
         return 0;
     }
@@ -648,7 +740,7 @@ PUBLIC bool websVerifyPasswordFromPam(Webs *wp)
     trace(5, "httpPamVerifyUser verified %s", wp->username);
 
     if (!wp->user) {
-        wp->user = websLookupUser(wp->username);
+        wp->user = websLookupRequestUser(wp, wp->username);
     }
     if (!wp->user) {
         Gid     groups[32];
@@ -965,7 +1057,7 @@ static bool parseDigestDetails(Webs *wp)
         return 0;
     }
     if (!wp->user) {
-        if ((wp->user = websLookupUser(wp->username)) == 0) {
+        if ((wp->user = websLookupRequestUser(wp, wp->username)) == 0) {
             trace(2, "Access denied: user is unknown");
             wfree(decoded);
             return 0;
@@ -25,7 +25,7 @@
 #endif
 
 typedef struct Cgi {            /* Struct for CGI tasks which have completed */
-    Webs    *wp;                /* Connection object */
+    WebsHandle wh;              /* Handle of the connection object */
     char    *stdIn;             /* File desc. for task's temp input fd */
     char    *stdOut;            /* File desc. for task's temp output fd */
     char    *cgiPath;           /* Path to executable process file */
@@ -35,8 +35,8 @@ typedef struct Cgi {            /* Struct for CGI tasks which have completed */
     off_t   fplacemark;         /* Seek location for CGI output file */
 } Cgi;
 
-static Cgi      **cgiList;      /* walloc chain list of wp's to be closed */
-static int      cgiMax;         /* Size of walloc list */
+static WEBS_THREAD_LOCAL Cgi **cgiList;     /* walloc chain list of wp's to be closed */
+static WEBS_THREAD_LOCAL int cgiMax;        /* Size of walloc list */
 
 /************************************ Forwards ********************************/
 
@@ -60,6 +60,7 @@ PUBLIC bool cgiHandler(Webs *wp)
     assert(websValid(wp));
 
     websSetEnv(wp);
+    websSetHeaderVars(wp);
 
     /*
         Extract the form name and then build the full path name. The form name will follow the first '/' in path.
@@ -170,7 +171,7 @@ PUBLIC bool cgiHandler(Webs *wp)
      */
     envpsize = 64;
     envp = walloc(envpsize * sizeof(char*));
-    if (wp->vars) {
+    if (wp->vars >= 0) {
         for (n = 0, s = hashFirst(wp->vars); s != NULL; s = hashNext(wp->vars, s)) {
             if (s->content.valid && s->content.type == string) {
                 vp = strim(s->name.value.string, 0, WEBS_TRIM_START);
@@ -236,7 +237,7 @@ PUBLIC bool cgiHandler(Webs *wp)
         cgip->cgiPath = cgiPath;
         cgip->argp = argp;
         cgip->envp = envp;
-        cgip->wp = wp;
+        cgip->wh = websGetHandle(wp);
         cgip->fplacemark = 0;
         wfree(query);
     }
@@ -359,6 +360,10 @@ PUBLIC void websCgiGatherOutput(Cgi *cgip)
     ssize       nbytes, skip;
     int         fdout;
 
+    if ((wp = websLookup(cgip->wh)) == 0) {
+        /* Connection has been closed. Discard the output */
+        return;
+    }
     /*
         OPT - currently polling and doing a stat each poll. Also doing open/close each chunk.
         If the CGI process writes partial headers, this repeatedly reads the data until complete
@@ -370,7 +375,6 @@ PUBLIC void websCgiGatherOutput(Cgi *cgip)
                 Check to see if any data is available in the output file and send its contents to the socket.
                 Write the HTTP header on our first pass. The header must fit into ME_GOAHEAD_LIMIT_BUFFER.
              */
-            wp = cgip->wp;
             lseek(fdout, cgip->fplacemark, SEEK_SET);
             while ((nbytes = read(fdout, buf, sizeof(buf) - 1)) > 0) {
                 buf[nbytes] = 0;
@@ -391,6 +395,10 @@ PUBLIC void websCgiGatherOutput(Cgi *cgip)
                 cgip->fplacemark += (off_t) nbytes;
             }
             close(fdout);
+            if (wp->flags & WEBS_HEADERS_CREATED) {
+                /* This runs from a timer, so push CGI output to the client as it arrives */
+                websFlush(wp, 0);
+            }
         } else {
             trace(5, "cgi: open failed");
         }
@@ -411,7 +419,6 @@ int websCgiPoll(void)
 
     for (cid = 0; cid < cgiMax; cid++) {
         if ((cgip = cgiList[cid]) != NULL) {
-            wp = cgip->wp;
             websCgiGatherOutput(cgip);
             if (checkCgi(cgip->handle) == 0) {
                 /*
@@ -434,7 +441,9 @@ int websCgiPoll(void)
                     }
                 }
 #endif
-                if (cgip->fplacemark == 0) {
+                if ((wp = websLookup(cgip->wh)) == 0) {
+                    trace(5, "cgi: Connection closed before the request completed");
+                } else if (cgip->fplacemark == 0) {
                     websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR, "CGI generated no output");
                 } else {
                     trace(5, "cgi: Request complete - calling websDone");
@@ -458,10 +467,12 @@ int websCgiPoll(void)
                 wfree(cgip->argp);
                 wfree(cgip->envp);
                 wfree(cgip);
-                websPump(wp);
-                if ((wp->flags & WEBS_KEEP_ALIVE) == 0) {
-                    websFree(wp);
-                    /* wp no longer valid */
+                if (wp) {
+                    websPump(wp);
+                    if ((wp->flags & WEBS_KEEP_ALIVE) == 0) {
+                        websFree(wp);
+                        /* wp no longer valid */
+                    }
                 }
             }
         }
@@ -13,9 +13,137 @@
 static char   *websIndex;                   /* Default page name */
 static char   *websDocuments;               /* Default Web page directory */
 
+#define FILE_MAX_RANGES 16                  /* Requests with more ranges are sent the whole document */
+#define FILE_ETAG_SIZE  64                  /* Buffer size for a formatted entity tag */
+
+#if ME_GOAHEAD_LIMIT_STAT_CACHE > 0
+/*
+    Cached document metadata. The cache is direct mapped by filename hash so lookups and updates are constant time
+    and the cache cannot grow beyond its limit.
+ */
+typedef struct StatEntry {
+    char            *filename;              /* Document filename */
+    WebsFileInfo    info;                   /* Document metadata */
+    int64           expires;                /* Time in microseconds after which the entry is revalidated */
+    int             encodings;              /* Precompressed variants available. -1 if not yet probed */
+} StatEntry;
+
+static WEBS_THREAD_LOCAL StatEntry *statCache;  /* Document metadata cache owned by the event loop thread */
+#endif
+
+#if ME_GOAHEAD_PRECOMPRESS
+/*
+    Precompressed document variants in order of preference
+ */
+typedef struct Encoding {
+    cchar           *name;                  /* Content-Encoding name */
+    cchar           *ext;                   /* Filename extension of the precompressed variant */
+    int             mask;                   /* Encoding bit */
+} Encoding;
+
+static Encoding encodings[] = {
+    { "br", ".br", 0x1 },
+    { "gzip", ".gz", 0x2 },
+    { 0, 0, 0 },
+};
+#endif
+
+#define FILE_CACHE      (ME_GOAHEAD_LIMIT_FILE_CACHE > 0 && !ME_ROM)
+#define FILE_CACHE_HASH 509                 /* Hash size for the file and descriptor cache indexes */
+
+#if FILE_CACHE
+
+/*
+    Cached document. The content immediately follows the entry. The entry holds one reference for the cache and one
+    for each response still writing the content, so an evicted document is freed only when no longer being written.
+ */
+typedef struct FileEntry {
+    struct FileEntry    *prev;              /* Previous entry in the LRU list (more recently used) */
+    struct FileEntry    *next;              /* Next entry in the LRU list (less recently used) */
+    char                *filename;          /* Document filename */
+    char                *headers;           /* Prebuilt Last-Modified, ETag and Accept-Ranges headers */
+    ssize               headersLen;         /* Length of headers */
+    ssize               size;               /* Bytes charged to the cache for this entry */
+    WebsFileInfo        info;               /* Metadata of the cached content */
+    int                 refs;               /* References to the entry */
+} FileEntry;
+
+/*
+    Each event loop thread has its own file cache
+ */
+static WEBS_THREAD_LOCAL WebsHash fileIndex = -1;       /* Cached documents by filename */
+static WEBS_THREAD_LOCAL FileEntry *fileHead;           /* Most recently used entry */
+static WEBS_THREAD_LOCAL FileEntry *fileTail;           /* Least recently used entry */
+static WEBS_THREAD_LOCAL WebsFileCacheStats fileStats;  /* File cache statistics */
+#endif
+
+#define FD_CACHE        (ME_GOAHEAD_LIMIT_FD_CACHE > 0 && ME_UNIX_LIKE && !ME_ROM)
+
+#if FD_CACHE
+/*
+    Cached document descriptor. Each request using the descriptor holds a reference and the cache holds one while
+    the entry is indexed, so the descriptor is closed only when it is no longer cached and no longer being sent.
+    Requests share the descriptor, so they read with an explicit offset.
+ */
+typedef struct WebsFdEntry {
+    struct WebsFdEntry  *prev;              /* Previous entry in the LRU list (more recently used) */
+    struct WebsFdEntry  *next;              /* Next entry in the LRU list (less recently used) */
+    char                *filename;          /* Document filename */
+    WebsFileInfo        info;               /* Metadata of the open document */
+    int                 fd;                 /* Open descriptor */
+    int                 refs;               /* References to the entry */
+} FdEntry;
+
+static WEBS_THREAD_LOCAL WebsHash fdIndex = -1;         /* Cached descriptors by filename */
+static WEBS_THREAD_LOCAL FdEntry *fdHead;               /* Most recently used entry */
+static WEBS_THREAD_LOCAL FdEntry *fdTail;               /* Least recently used entry */
+static WEBS_THREAD_LOCAL int fdCount;                   /* Number of cached descriptors */
+static WEBS_THREAD_LOCAL int fdEvent = -1;              /* Revalidation event */
+#endif
+
 /**************************** Forward Declarations ****************************/
 
+static int checkConditions(Webs *wp, WebsFileInfo *info, cchar *etag);
+#if FD_CACHE
+static void freeFd(FdEntry *fp);
+static void removeFd(FdEntry *fp);
+static void revalidateFds(void *data, int id);
+#endif
+#if FILE_CACHE
+static FileEntry *cacheDocument(Webs *wp, WebsFileInfo *info);
+static void freeEntry(FileEntry *fp);
+static FileEntry *loadEntry(Webs *wp, WebsFileInfo *info);
+static void releaseContent(void *data);
+static void removeEntry(FileEntry *fp);
+static void serveEntry(Webs *wp, FileEntry *fp);
+#endif
 static void fileWriteEvent(Webs *wp);
+static char *formatETag(char *buf, ssize size, WebsFileInfo *info);
+static char *formatPart(Webs *wp, WebsRange *rp);
+static void invalidateDocument(cchar *filename);
+static bool matchETag(cchar *header, cchar *etag);
+static bool matchIfRange(Webs *wp, WebsFileInfo *info, cchar *etag);
+static int nextRange(Webs *wp);
+static int openDocument(Webs *wp, WebsFileInfo *info);
+static int parseRanges(Webs *wp, cchar *header, Offset size);
+static ssize readDocument(Webs *wp, char *buf, ssize size);
+static bool sameDocument(WebsFileInfo *a, WebsFileInfo *b);
+#if ME_ROM
+static void serveRom(Webs *wp, WebsRomIndex *wip);
+#endif
+static int statDocument(Webs *wp, WebsFileInfo *info, bool cached);
+#if ME_GOAHEAD_PRECOMPRESS
+static int acceptEncodings(cchar *header);
+static int documentEncodings(Webs *wp, WebsFileInfo *info);
+static void selectEncoding(Webs *wp, WebsFileInfo *info);
+static bool zeroQuality(cchar *params, cchar *end);
+#endif
+#if ME_GOAHEAD_LIMIT_STAT_CACHE > 0
+static StatEntry *statSlot(cchar *filename, bool create);
+#endif
+#if ME_GOAHEAD_SENDFILE
+static void sendFileEvent(Webs *wp);
+#endif
 
 /*********************************** Code *************************************/
 /*
@@ -25,9 +153,17 @@ static void fileWriteEvent(Webs *wp);
 static bool fileHandler(Webs *wp)
 {
     WebsFileInfo    info;
-    char            *tmp, *date;
-    ssize           nchars;
-    int             code;
+    WebsRange       *rp;
+#if FILE_CACHE
+    FileEntry       *fp;
+#endif
+#if ME_ROM
+    WebsRomIndex    *wip;
+#endif
+    cchar           *range, *etag;
+    char            *tmp, *date, tag[FILE_ETAG_SIZE];
+    ssize           nchars, length;
+    int             code, count, rc;
 
     assert(websValid(wp));
     assert(wp->method);
@@ -35,6 +171,7 @@ static bool fileHandler(Webs *wp)
 
 #if !ME_ROM
     if (smatch(wp->method, "DELETE")) {
+        invalidateDocument(wp->filename);
         if (unlink(wp->filename) < 0) {
             websError(wp, HTTP_CODE_NOT_FOUND, "Cannot delete the URI");
         } else {
@@ -42,16 +179,32 @@ static bool fileHandler(Webs *wp)
             websResponse(wp, 204, 0);
         }
     } else if (smatch(wp->method, "PUT")) {
+        invalidateDocument(wp->filename);
         /* Code is already set for us by processContent() */
         websResponse(wp, wp->code, 0);
 
     } else
 #endif /* !ME_ROM */
     {
+        rc = statDocument(wp, &info, 1);
+#if ME_GOAHEAD_PRECOMPRESS
+        if (rc == 0) {
+            selectEncoding(wp, &info);
+        }
+#endif
+        if (rc < 0) {
+#if ME_DEBUG
+            if (wp->referrer) {
+                trace(1, "From %s", wp->referrer);
+            }
+#endif
+            websError(wp, HTTP_CODE_NOT_FOUND, "Cannot open document for: %s", wp->path);
+            return 1;
+        }
         /*
             If the file is a directory, redirect using the nominated default page
          */
-        if (websPageIsDirectory(wp)) {
+        if (info.isDir) {
             nchars = strlen(wp->path);
             if (wp->path[nchars - 1] == '/' || wp->path[nchars - 1] == '\\') {
                 wp->path[--nchars] = '\0';
@@ -61,30 +214,94 @@ static bool fileHandler(Webs *wp)
             wfree(tmp);
             return 1;
         }
-        if (websPageOpen(wp, O_RDONLY | O_BINARY, 0666) < 0) {
-#if ME_DEBUG
-            if (wp->referrer) {
-                trace(1, "From %s", wp->referrer);
-            }
+        /*
+            Conditional requests are answered from the cached metadata without opening the document
+         */
+#if ME_ROM
+        /*
+            Pages compiled by webcomp carry an entity tag of their content and their response headers. Direct requests
+            for a compressed variant are sent with the variant type via the general path.
+         */
+        if ((wip = websLookupRom(wp->filename)) != 0 && wip->etag) {
+            etag = wip->etag;
+        } else
 #endif
-            websError(wp, HTTP_CODE_NOT_FOUND, "Cannot open document for: %s", wp->path);
+        etag = formatETag(tag, sizeof(tag), &info);
+        if ((code = checkConditions(wp, &info, etag)) == HTTP_CODE_PRECOND_FAILED) {
+            websError(wp, HTTP_CODE_PRECOND_FAILED, "Precondition failed");
+            return 1;
+        }
+#if ME_ROM
+        if (code == HTTP_CODE_OK && wip && wip->headers && !websGetKnownHeader(wp, WEBS_HEADER_RANGE) &&
+                (wp->contentEncoding || !wp->ext || (!smatch(wp->ext, ".gz") && !smatch(wp->ext, ".br")))) {
+            serveRom(wp, wip);
             return 1;
         }
-        if (websPageStat(wp, &info) < 0) {
-            websError(wp, HTTP_CODE_NOT_FOUND, "Cannot stat page for URL");
+#endif
+#if FILE_CACHE
+        /*
+            Small documents are served from memory with a single write of the headers and content
+         */
+        if (code == HTTP_CODE_OK && !websGetKnownHeader(wp, WEBS_HEADER_RANGE) &&
+                (fp = cacheDocument(wp, &info)) != 0) {
+            serveEntry(wp, fp);
             return 1;
         }
-        code = 200;
-        if (wp->since && info.mtime <= wp->since) {
-            code = 304;
-            info.size = 0;
+#endif
+        if (code != HTTP_CODE_NOT_MODIFIED) {
+            if (openDocument(wp, &info) < 0) {
+                invalidateDocument(wp->filename);
+                websError(wp, HTTP_CODE_NOT_FOUND, "Cannot open document for: %s", wp->path);
+                return 1;
+            }
+            if (etag == tag) {
+                formatETag(tag, sizeof(tag), &info);
+            }
+        }
+        length = info.size;
+        wp->docSize = info.size;
+        if (code == HTTP_CODE_NOT_MODIFIED) {
+            length = 0;
+
+        } else if (smatch(wp->method, "GET") && (range = websGetKnownHeader(wp, WEBS_HEADER_RANGE)) != 0 &&
+                matchIfRange(wp, &info, etag)) {
+            if ((count = parseRanges(wp, range, info.size)) < 0) {
+                websSetStatus(wp, HTTP_CODE_RANGE_NOT_SATISFIABLE);
+                websWriteHeaders(wp, 0, 0);
+                websWriteHeader(wp, "Content-Range", "bytes */%Ld", (int64) info.size);
+                websWriteEndHeaders(wp);
+                websDone(wp);
+                return 1;
+            }
+            if (count > 0) {
+                code = 206;
+                length = 0;
+                for (rp = wp->ranges; rp < &wp->ranges[count]; rp++) {
+                    length += (ssize) (rp->end - rp->start);
+                    if (wp->rangeBoundary) {
+                        tmp = formatPart(wp, rp);
+                        length += slen(tmp);
+                        wfree(tmp);
+                    }
+                }
+                if (wp->rangeBoundary) {
+                    length += slen(wp->rangeBoundary) + 8;
+                }
+            }
         }
         websSetStatus(wp, code);
-        websWriteHeaders(wp, info.size, 0);
+        websWriteHeaders(wp, length, 0);
         if ((date = websGetDateString(&info)) != NULL) {
             websWriteHeader(wp, "Last-Modified", "%s", date);
             wfree(date);
         }
+        websWriteHeader(wp, "ETag", "%s", etag);
+        websWriteHeader(wp, "Accept-Ranges", "bytes");
+        if (code == 206 && !wp->rangeBoundary) {
+            rp = wp->ranges;
+            websWriteHeader(wp, "Content-Range", "bytes %Ld-%Ld/%Ld", (int64) rp->start, (int64) rp->end - 1,
+                (int64) info.size);
+        }
         websWriteEndHeaders(wp);
 
         /*
@@ -94,8 +311,22 @@ static bool fileHandler(Webs *wp)
             websDone(wp);
             return 1;
         }
-        if (info.size > 0) {
-            wp->txRemaining = info.size;
+        if (length > 0) {
+            if (code == 206) {
+                nextRange(wp);
+            } else {
+                wp->txRemaining = length;
+                wp->docOffset = 0;
+            }
+#if ME_GOAHEAD_SENDFILE
+            /*
+                TLS must encrypt in user space, so only plain connections can send directly from the file
+             */
+            if (!(wp->flags & WEBS_SECURE)) {
+                websSetBackgroundWriter(wp, sendFileEvent);
+                return 1;
+            }
+#endif
             websSetBackgroundWriter(wp, fileWriteEvent);
         } else {
             websDone(wp);
@@ -105,6 +336,241 @@ static bool fileHandler(Webs *wp)
 }
 
 
+/*
+    Evaluate the request preconditions against the document metadata. If-None-Match takes precedence over
+    If-Modified-Since. Returns 200 to send the document, 304 if the client copy is current or 412 if the request
+    must not be applied.
+ */
+static int checkConditions(Webs *wp, WebsFileInfo *info, cchar *etag)
+{
+    cchar   *value;
+
+    if ((value = websGetKnownHeader(wp, WEBS_HEADER_IF_NONE_MATCH)) != 0) {
+        if (!matchETag(value, etag)) {
+            return HTTP_CODE_OK;
+        }
+        if (smatch(wp->method, "GET") || smatch(wp->method, "HEAD")) {
+            return HTTP_CODE_NOT_MODIFIED;
+        }
+        return HTTP_CODE_PRECOND_FAILED;
+    }
+    if (wp->since && info->mtime <= wp->since) {
+        return HTTP_CODE_NOT_MODIFIED;
+    }
+    return HTTP_CODE_OK;
+}
+
+
+/*
+    Test if an If-None-Match list of entity tags matches the document entity tag. This uses the weak comparison, so
+    weak tags match if their opaque tags are equal.
+ */
+static bool matchETag(cchar *header, cchar *etag)
+{
+    cchar   *cp, *end;
+    ssize   len;
+
+    len = slen(etag);
+    for (cp = header; *cp; cp = end + 1) {
+        while (*cp == ' ' || *cp == '\t' || *cp == ',') {
+            cp++;
+        }
+        if (*cp == '*') {
+            return 1;
+        }
+        if (sncmp(cp, "W/", 2) == 0) {
+            cp += 2;
+        }
+        if (*cp != '"' || (end = strchr(&cp[1], '"')) == 0) {
+            break;
+        }
+        if ((end - cp + 1) == len && sncmp(cp, etag, len) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+/*
+    Format a strong entity tag from the document serial number, size and modified time in nanoseconds
+ */
+static char *formatETag(char *buf, ssize size, WebsFileInfo *info)
+{
+    return fmt(buf, size, "\"%Lx-%Lx-%Lx\"", (int64) info->inode, (int64) info->size,
+        (int64) info->mtime * 1000000000 + info->mtimeNsec);
+}
+
+
+/*
+    Test the If-Range header. The range applies only if the document is unchanged. An entity tag must be a strong
+    match and a date must equal the document modified time.
+ */
+static bool matchIfRange(Webs *wp, WebsFileInfo *info, cchar *etag)
+{
+    WebsTime    when;
+    cchar       *value;
+    char        *date;
+    bool        match;
+
+    if ((value = websGetKnownHeader(wp, WEBS_HEADER_IF_RANGE)) == 0) {
+        return 1;
+    }
+    if (*value == '"' || sncmp(value, "W/", 2) == 0) {
+        return smatch(value, etag);
+    }
+    if ((date = websGetDateString(info)) != 0) {
+        match = smatch(value, date);
+        wfree(date);
+        if (match) {
+            return 1;
+        }
+    }
+    when = 0;
+    return websParseDateTime(&when, value, 0) == 0 && when == info->mtime;
+}
+
+
+/*
+    Parse a Range header of the form "bytes=0-99,200-,-50". Returns the number of satisfiable ranges, zero if the
+    header should be ignored and the whole document sent, or -1 if no range can be satisfied.
+ */
+static int parseRanges(Webs *wp, cchar *header, Offset size)
+{
+    WebsRange   ranges[FILE_MAX_RANGES];
+    cchar       *cp;
+    char        *end;
+    int64       start, last;
+    int         count, specs;
+
+    if (sncmp(header, "bytes=", 6) != 0) {
+        return 0;
+    }
+    count = specs = 0;
+    for (cp = &header[6]; *cp; ) {
+        while (*cp == ' ' || *cp == '\t' || *cp == ',') {
+            cp++;
+        }
+        if (*cp == '\0') {
+            break;
+        }
+        if (++specs > FILE_MAX_RANGES) {
+            return 0;
+        }
+        if (*cp == '-') {
+            /* Suffix range of the last bytes */
+            if (!isdigit((uchar) cp[1])) {
+                return 0;
+            }
+            last = strtoll(&cp[1], &end, 10);
+            cp = end;
+            if (last == 0 || size == 0) {
+                continue;
+            }
+            start = (last >= size) ? 0 : size - last;
+            last = size - 1;
+        } else {
+            if (!isdigit((uchar) *cp)) {
+                return 0;
+            }
+            start = strtoll(cp, &end, 10);
+            cp = end;
+            if (*cp++ != '-') {
+                return 0;
+            }
+            if (isdigit((uchar) *cp)) {
+                last = strtoll(cp, &end, 10);
+                cp = end;
+                if (last < start) {
+                    return 0;
+                }
+            } else {
+                last = size - 1;
+            }
+            if (start >= size) {
+                continue;
+            }
+            if (last >= size) {
+                last = size - 1;
+            }
+        }
+        if (*cp && *cp != ',' && *cp != ' ' && *cp != '\t') {
+            return 0;
+        }
+        ranges[count].start = start;
+        ranges[count].end = last + 1;
+        count++;
+    }
+    if (specs == 0) {
+        return 0;
+    }
+    if (count == 0) {
+        return -1;
+    }
+    if ((wp->ranges = websArenaAlloc(wp, count * sizeof(WebsRange))) == 0) {
+        return 0;
+    }
+    memcpy(wp->ranges, ranges, count * sizeof(WebsRange));
+    wp->rangeCount = count;
+    wp->rangeIndex = 0;
+    if (count > 1) {
+        wp->rangeBoundary = websArenaFmt(wp, "%08x%08x", rand(), (int) wp->timestamp);
+    }
+    return count;
+}
+
+
+/*
+    Format the multipart header that precedes a range
+ */
+static char *formatPart(Webs *wp, WebsRange *rp)
+{
+    cchar   *type;
+
+    if ((type = websGetMimeType(wp->ext)) == 0) {
+        type = "application/octet-stream";
+    }
+    return sfmt("\r\n--%s\r\nContent-Type: %s\r\nContent-Range: bytes %Ld-%Ld/%Ld\r\n\r\n", wp->rangeBoundary, type,
+        (int64) rp->start, (int64) rp->end - 1, (int64) wp->docSize);
+}
+
+
+/*
+    Position the document at the next byte range. For multiple ranges, queue the part header and then the closing
+    boundary after the last range. Returns 1 if the range can be written now, 0 if waiting for the part header to
+    be written, or -1 if all ranges are sent.
+ */
+static int nextRange(Webs *wp)
+{
+    WebsRange   *rp;
+    char        *part;
+    ssize       len;
+
+    if (wp->rangeIndex >= wp->rangeCount) {
+        if (wp->rangeBoundary && wp->rangeIndex == wp->rangeCount) {
+            wp->rangeIndex++;
+            part = sfmt("\r\n--%s--\r\n", wp->rangeBoundary);
+            websWriteBlock(wp, part, slen(part));
+            wfree(part);
+        }
+        return -1;
+    }
+    rp = &wp->ranges[wp->rangeIndex++];
+    wp->txRemaining = (ssize) (rp->end - rp->start);
+    wp->docOffset = rp->start;
+    websPageSeek(wp, rp->start, SEEK_SET);
+    if (wp->rangeBoundary) {
+        part = formatPart(wp, rp);
+        len = websWriteBlock(wp, part, slen(part));
+        wfree(part);
+        if (len < 0 || websFlush(wp, 0) != 1) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
 /*
     Do output back to the browser in the background. This is a socket write handler.
     This bypasses the output buffer and writes directly to the socket.
@@ -113,7 +579,7 @@ static void fileWriteEvent(Webs *wp)
 {
     char    *buf;
     ssize   size, len, wrote;
-    int     err;
+    int     err, more;
 
     assert(wp);
     assert(websValid(wp));
@@ -122,35 +588,767 @@ static void fileWriteEvent(Webs *wp)
         websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR, "Cannot get memory");
         return;
     }
-    while (wp->txRemaining > 0) {
-        size = min(wp->txRemaining, ME_GOAHEAD_LIMIT_BUFFER);
-        len = websPageReadData(wp, buf, size);
-        if (len <= 0) {
-            websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR, "Cannot read file content");
-            return;
-        }
-        wp->txRemaining -= len;
-        if ((wrote = websWriteSocket(wp, buf, len)) < 0) {
-            err = socketGetError(wp->sid);
-            if (err == EWOULDBLOCK || err == EAGAIN) {
-                websPageSeek(wp, -len, SEEK_CUR);
-                wp->txRemaining += len;
-            } else {
-                /* Will call websDone below */
-                wp->state = WEBS_COMPLETE;
+    more = -1;
+    do {
+        while (wp->txRemaining > 0) {
+            size = min(wp->txRemaining, ME_GOAHEAD_LIMIT_BUFFER);
+            len = readDocument(wp, buf, size);
+            if (len <= 0) {
+                websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR, "Cannot read file content");
+                wfree(buf);
+                return;
             }
-            break;
+            wp->txRemaining -= len;
+            wp->docOffset += len;
+            if ((wrote = websWriteSocket(wp, buf, len)) < 0) {
+                err = socketGetError(wp->sid);
+                if (err == EWOULDBLOCK || err == EAGAIN) {
+                    websPageSeek(wp, -len, SEEK_CUR);
+                    wp->txRemaining += len;
+                    wp->docOffset -= len;
+                } else {
+                    /* Will call websDone below */
+                    wp->state = WEBS_COMPLETE;
+                }
+                break;
+            }
+            if (wrote != len) {
+                websPageSeek(wp, - (len - wrote), SEEK_CUR);
+                wp->txRemaining += (len - wrote);
+                wp->docOffset -= (len - wrote);
+                break;
+            }
+        }
+    } while (wp->txRemaining <= 0 && (more = nextRange(wp)) > 0);
+    wfree(buf);
+    if (wp->txRemaining <= 0 && more < 0) {
+        websDone(wp);
+    }
+}
+
+
+#if ME_GOAHEAD_SENDFILE
+/*
+    Background writer that sends the document with sendfile(). Each event writes as much as the socket will accept.
+ */
+static void sendFileEvent(Webs *wp)
+{
+    ssize   wrote;
+    int     err, more;
+
+    assert(wp);
+    assert(websValid(wp));
+
+    more = -1;
+    do {
+        while (wp->txRemaining > 0) {
+            if ((wrote = socketSendFile(wp->sid, wp->docfd, &wp->docOffset, wp->txRemaining)) < 0) {
+                err = socketGetError(wp->sid);
+                if (err != EWOULDBLOCK && err != EAGAIN) {
+                    wp->state = WEBS_COMPLETE;
+                }
+                break;
+            }
+            if (wrote == 0) {
+                websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR, "Cannot read file content");
+                return;
+            }
+            wp->txRemaining -= wrote;
+            wp->written += wrote;
+            websNoteRequestActivity(wp);
+        }
+    } while (wp->txRemaining <= 0 && (more = nextRange(wp)) > 0);
+    if (wp->txRemaining <= 0 && more < 0) {
+        websDone(wp);
+    }
+}
+#endif
+
+
+/*
+    Get the document metadata. If cached is true, metadata cached within the last limitStatLife milliseconds is used
+    without touching the file system. Otherwise the document is stat'ed and the cache refreshed.
+ */
+static int statDocument(Webs *wp, WebsFileInfo *info, bool cached)
+{
+#if ME_GOAHEAD_LIMIT_STAT_CACHE > 0
+    StatEntry   *sp;
+    int64       now;
+
+    if ((sp = statSlot(wp->filename, 1)) == 0) {
+        return websPageStat(wp, info);
+    }
+    now = websGetMicroTicks();
+    if (cached && sp->filename && now < sp->expires && smatch(sp->filename, wp->filename)) {
+        *info = sp->info;
+        return 0;
+    }
+    if (websPageStat(wp, info) < 0) {
+        invalidateDocument(wp->filename);
+        return -1;
+    }
+    if (!sp->filename || !smatch(sp->filename, wp->filename)) {
+        wfree(sp->filename);
+        sp->filename = sclone(wp->filename);
+        sp->encodings = -1;
+    } else if (!sameDocument(&sp->info, info)) {
+        sp->encodings = -1;
+    }
+    sp->info = *info;
+    sp->expires = now + (int64) ME_GOAHEAD_LIMIT_STAT_LIFE * 1000;
+    return 0;
+#else
+    return websPageStat(wp, info);
+#endif
+}
+
+
+#if ME_GOAHEAD_PRECOMPRESS
+/*
+    Select a precompressed variant of an existing document that the client accepts. The variant replaces the document
+    filename and metadata. Variants are only considered if documentEncodings found them beside the document.
+ */
+static void selectEncoding(Webs *wp, WebsFileInfo *info)
+{
+    WebsFileInfo    vinfo;
+    Encoding        *ep;
+    cchar           *header;
+    char            *filename;
+    int             accepted;
+
+    if (wp->ext && (smatch(wp->ext, ".br") || smatch(wp->ext, ".gz"))) {
+        return;
+    }
+    if ((accepted = documentEncodings(wp, info)) == 0) {
+        return;
+    }
+    /* Content negotiation makes the response vary with Accept-Encoding */
+    wp->flags |= WEBS_VARY_ENCODING;
+    if ((header = websGetKnownHeader(wp, WEBS_HEADER_ACCEPT_ENCODING)) != 0) {
+        accepted &= acceptEncodings(header);
+        for (ep = encodings; ep->name && accepted; ep++) {
+            if (accepted & ep->mask) {
+                filename = wp->filename;
+                wp->filename = websArenaFmt(wp, "%s%s", filename, ep->ext);
+                if (wp->filename && statDocument(wp, &vinfo, 1) == 0 && !vinfo.isDir) {
+                    *info = vinfo;
+                    wp->contentEncoding = ep->name;
+                    return;
+                }
+                wp->filename = filename;
+                accepted &= ~ep->mask;
+            }
+        }
+    }
+}
+
+
+/*
+    Get the precompressed variants available for the document. The result is cached with the document metadata and
+    probed again only when the document changes.
+ */
+static int documentEncodings(Webs *wp, WebsFileInfo *info)
+{
+    WebsFileInfo    vinfo;
+    Encoding        *ep;
+    char            *path;
+    int             available;
+#if ME_GOAHEAD_LIMIT_STAT_CACHE > 0
+    StatEntry       *sp;
+
+    if ((sp = statSlot(wp->filename, 0)) != 0 && (!sp->filename || !smatch(sp->filename, wp->filename) ||
+            !sameDocument(&sp->info, info))) {
+        sp = 0;
+    }
+    if (sp && sp->encodings >= 0) {
+        return sp->encodings;
+    }
+#endif
+    available = 0;
+    for (ep = encodings; ep->name; ep++) {
+        if ((path = sfmt("%s%s", wp->filename, ep->ext)) != 0) {
+            if (websStatFile(path, &vinfo) == 0 && !vinfo.isDir) {
+                available |= ep->mask;
+            }
+            wfree(path);
+        }
+    }
+#if ME_GOAHEAD_LIMIT_STAT_CACHE > 0
+    if (sp) {
+        sp->encodings = available;
+    }
+#endif
+    return available;
+}
+
+
+/*
+    Parse an Accept-Encoding header and return the precompressed encodings the client accepts. Encodings with a
+    zero quality value are refused and "*" accepts any encoding not otherwise listed.
+ */
+static int acceptEncodings(cchar *header)
+{
+    Encoding    *ep;
+    cchar       *cp, *name, *params;
+    ssize       len;
+    bool        any;
+    int         accepted, listed, mask;
+
+    accepted = listed = 0;
+    any = 0;
+    for (cp = header; *cp; ) {
+        while (*cp == ' ' || *cp == '\t' || *cp == ',') {
+            cp++;
+        }
+        name = cp;
+        while (*cp && *cp != ',' && *cp != ';' && *cp != ' ' && *cp != '\t') {
+            cp++;
+        }
+        len = cp - name;
+        params = cp;
+        while (*cp && *cp != ',') {
+            cp++;
+        }
+        if (len == 0) {
+            continue;
+        }
+        mask = 0;
+        if (len == 1 && *name == '*') {
+            mask = -1;
+        } else if (len == 6 && sncaselesscmp(name, "x-gzip", 6) == 0) {
+            mask = encodings[1].mask;
+        } else {
+            for (ep = encodings; ep->name; ep++) {
+                if (slen(ep->name) == len && sncaselesscmp(name, ep->name, len) == 0) {
+                    mask = ep->mask;
+                    break;
+                }
+            }
+        }
+        if (mask == 0) {
+            continue;
+        }
+        if (mask < 0) {
+            any = !zeroQuality(params, cp);
+        } else {
+            listed |= mask;
+            if (!zeroQuality(params, cp)) {
+                accepted |= mask;
+            }
+        }
+    }
+    if (any) {
+        accepted |= ~listed;
+    }
+    return accepted;
+}
+
+
+/*
+    Test if the parameters of an Accept-Encoding element give a quality value of zero
+ */
+static bool zeroQuality(cchar *params, cchar *end)
+{
+    cchar   *cp;
+
+    for (cp = params; cp < end; cp++) {
+        if (*cp != ';') {
+            continue;
+        }
+        for (cp++; cp < end && (*cp == ' ' || *cp == '\t'); cp++) ;
+        if ((end - cp) > 2 && (*cp == 'q' || *cp == 'Q') && cp[1] == '=') {
+            return strtod(&cp[2], 0) <= 0;
+        }
+    }
+    return 0;
+}
+#endif
+
+
+/*
+    Test if two sets of metadata describe the same version of a document
+ */
+static bool sameDocument(WebsFileInfo *a, WebsFileInfo *b)
+{
+    return a->size == b->size && a->mtime == b->mtime && a->mtimeNsec == b->mtimeNsec && a->inode == b->inode;
+}
+
+
+/*
+    Open the document for sending and get the metadata of the opened document. A cached descriptor is shared if its
+    metadata matches the current document metadata, which is revalidated every limitStatLife milliseconds.
+ */
+static int openDocument(Webs *wp, WebsFileInfo *info)
+{
+#if FD_CACHE
+    FdEntry     *fp;
+    WebsKey     *key;
+
+    if (fdIndex >= 0 && (key = hashLookup(fdIndex, wp->filename)) != 0) {
+        fp = key->content.value.symbol;
+        if (sameDocument(&fp->info, info)) {
+            if (fp != fdHead) {
+                /* Move to the front of the LRU list */
+                fp->prev->next = fp->next;
+                if (fp->next) {
+                    fp->next->prev = fp->prev;
+                } else {
+                    fdTail = fp->prev;
+                }
+                fp->prev = 0;
+                fp->next = fdHead;
+                fdHead->prev = fp;
+                fdHead = fp;
+            }
+            fp->refs++;
+            wp->docfd = fp->fd;
+            wp->docEntry = fp;
+            *info = fp->info;
+            return 0;
+        }
+        removeFd(fp);
+    }
+#endif
+    if (websPageOpen(wp, O_RDONLY | O_BINARY, 0666) < 0) {
+        return -1;
+    }
+    /*
+        The response length must describe the opened document, so refresh the metadata
+     */
+    if (statDocument(wp, info, 0) < 0) {
+        websPageClose(wp);
+        return -1;
+    }
+#if FD_CACHE
+    if (fdIndex < 0 && (fdIndex = hashCreate(FILE_CACHE_HASH)) < 0) {
+        return 0;
+    }
+    if ((fp = walloc(sizeof(FdEntry))) == 0) {
+        return 0;
+    }
+    memset(fp, 0, sizeof(FdEntry));
+    if ((fp->filename = sclone(wp->filename)) == 0 || hashEnter(fdIndex, fp->filename, valueSymbol(fp), 0) == 0) {
+        wfree(fp->filename);
+        wfree(fp);
+        return 0;
+    }
+    /* Cached descriptors outlive the request, so keep them out of CGI programs */
+    fcntl(wp->docfd, F_SETFD, FD_CLOEXEC);
+    fp->fd = wp->docfd;
+    fp->info = *info;
+    fp->refs = 2;
+    while (fdTail && fdCount >= ME_GOAHEAD_LIMIT_FD_CACHE) {
+        removeFd(fdTail);
+    }
+    fp->next = fdHead;
+    if (fdHead) {
+        fdHead->prev = fp;
+    } else {
+        fdTail = fp;
+    }
+    fdHead = fp;
+    fdCount++;
+    wp->docEntry = fp;
+    if (fdEvent < 0) {
+        fdEvent = websStartEvent(ME_GOAHEAD_LIMIT_STAT_LIFE, revalidateFds, 0);
+    }
+#endif
+    return 0;
+}
+
+
+/*
+    Read document content at the document offset. Shared descriptors are read with pread so concurrent requests
+    do not disturb each other's file position.
+ */
+static ssize readDocument(Webs *wp, char *buf, ssize size)
+{
+#if FD_CACHE
+    if (wp->docEntry) {
+        return pread(wp->docfd, buf, size, wp->docOffset);
+    }
+#endif
+    return websPageReadData(wp, buf, size);
+}
+
+
+#if FD_CACHE
+/*
+    Remove a descriptor from the cache. The descriptor is closed once no request is sending it.
+ */
+static void removeFd(FdEntry *fp)
+{
+    if (fp->prev) {
+        fp->prev->next = fp->next;
+    } else {
+        fdHead = fp->next;
+    }
+    if (fp->next) {
+        fp->next->prev = fp->prev;
+    } else {
+        fdTail = fp->prev;
+    }
+    fp->prev = fp->next = 0;
+    hashDelete(fdIndex, fp->filename);
+    fdCount--;
+    if (--fp->refs == 0) {
+        freeFd(fp);
+    }
+}
+
+
+/*
+    Periodically close idle descriptors for documents that have been modified or removed, so the descriptors do not
+    hold stale documents open. Descriptors in use are revalidated by the next request for the document.
+ */
+static void revalidateFds(void *data, int id)
+{
+    FdEntry         *fp, *next;
+    WebsFileInfo    info;
+
+    for (fp = fdHead; fp; fp = next) {
+        next = fp->next;
+        if (fp->refs == 1 && (websStatFile(fp->filename, &info) < 0 || !sameDocument(&fp->info, &info))) {
+            removeFd(fp);
         }
-        if (wrote != len) {
-            websPageSeek(wp, - (len - wrote), SEEK_CUR);
-            wp->txRemaining += (len - wrote);
+    }
+    if (fdHead) {
+        websRestartEvent(id, ME_GOAHEAD_LIMIT_STAT_LIFE);
+    } else {
+        websStopEvent(id);
+        fdEvent = -1;
+    }
+}
+
+
+static void freeFd(FdEntry *fp)
+{
+    close(fp->fd);
+    wfree(fp->filename);
+    wfree(fp);
+}
+#endif
+
+
+PUBLIC void websReleaseDocument(Webs *wp)
+{
+#if FD_CACHE
+    FdEntry     *fp;
+
+    assert(wp);
+
+    if ((fp = wp->docEntry) != 0) {
+        wp->docEntry = 0;
+        wp->docfd = -1;
+        if (--fp->refs == 0) {
+            freeFd(fp);
+        }
+    }
+#endif
+}
+
+
+#if ME_GOAHEAD_LIMIT_STAT_CACHE > 0
+/*
+    Return the cache slot for a filename. The cache is allocated on first use by each event loop thread.
+ */
+static StatEntry *statSlot(cchar *filename, bool create)
+{
+    cchar   *cp;
+    uint    hash;
+
+    if (statCache == 0) {
+        if (!create || (statCache = walloc(ME_GOAHEAD_LIMIT_STAT_CACHE * sizeof(StatEntry))) == 0) {
+            return 0;
+        }
+        memset(statCache, 0, ME_GOAHEAD_LIMIT_STAT_CACHE * sizeof(StatEntry));
+    }
+    /* FNV-1a */
+    hash = 2166136261U;
+    for (cp = filename; *cp; cp++) {
+        hash = (hash ^ (uchar) *cp) * 16777619;
+    }
+    return &statCache[hash % ME_GOAHEAD_LIMIT_STAT_CACHE];
+}
+#endif
+
+
+/*
+    Discard cached metadata, content and descriptors for a document that is modified, removed or cannot be opened
+ */
+static void invalidateDocument(cchar *filename)
+{
+#if ME_GOAHEAD_LIMIT_STAT_CACHE > 0
+    StatEntry   *sp;
+#endif
+#if FILE_CACHE || FD_CACHE
+    WebsKey     *key;
+#endif
+
+#if ME_GOAHEAD_LIMIT_STAT_CACHE > 0
+    if ((sp = statSlot(filename, 0)) != 0 && sp->filename && smatch(sp->filename, filename)) {
+        wfree(sp->filename);
+        sp->filename = 0;
+    }
+#endif
+#if FILE_CACHE
+    if (fileIndex >= 0 && (key = hashLookup(fileIndex, filename)) != 0) {
+        removeEntry(key->content.value.symbol);
+    }
+#endif
+#if FD_CACHE
+    if (fdIndex >= 0 && (key = hashLookup(fdIndex, filename)) != 0) {
+        removeFd(key->content.value.symbol);
+    }
+#endif
+}
+
+
+#if FILE_CACHE
+/*
+    Find a document in the file cache or load it if it is small enough. The cached content is used only if its
+    metadata matches the current document metadata, which is revalidated every limitStatLife milliseconds.
+ */
+static FileEntry *cacheDocument(Webs *wp, WebsFileInfo *info)
+{
+    FileEntry   *fp;
+    WebsKey     *key;
+
+    if (info->size > ME_GOAHEAD_LIMIT_FILE_CACHE_ITEM || info->size > ME_GOAHEAD_LIMIT_FILE_CACHE) {
+        return 0;
+    }
+    if (fileIndex < 0 && (fileIndex = hashCreate(FILE_CACHE_HASH)) < 0) {
+        return 0;
+    }
+    if ((key = hashLookup(fileIndex, wp->filename)) != 0) {
+        fp = key->content.value.symbol;
+        if (sameDocument(&fp->info, info)) {
+            if (fp != fileHead) {
+                /* Move to the front of the LRU list */
+                fp->prev->next = fp->next;
+                if (fp->next) {
+                    fp->next->prev = fp->prev;
+                } else {
+                    fileTail = fp->prev;
+                }
+                fp->prev = 0;
+                fp->next = fileHead;
+                fileHead->prev = fp;
+                fileHead = fp;
+            }
+            fileStats.hits++;
+            return fp;
+        }
+        removeEntry(fp);
+    }
+    fileStats.misses++;
+    return loadEntry(wp, info);
+}
+
+
+/*
+    Read a document into a new cache entry, evicting the least recently used entries to make room
+ */
+static FileEntry *loadEntry(Webs *wp, WebsFileInfo *info)
+{
+    FileEntry   *fp;
+    char        *content, *date, etag[FILE_ETAG_SIZE];
+    ssize       len, nbytes;
+
+    if (websPageOpen(wp, O_RDONLY | O_BINARY, 0666) < 0) {
+        return 0;
+    }
+    /*
+        The cached content must match its metadata, so stat the opened document
+     */
+    if (statDocument(wp, info, 0) < 0 || info->size > ME_GOAHEAD_LIMIT_FILE_CACHE_ITEM ||
+            (fp = walloc(sizeof(FileEntry) + info->size)) == 0) {
+        websPageClose(wp);
+        return 0;
+    }
+    memset(fp, 0, sizeof(FileEntry));
+    content = (char*) &fp[1];
+    for (len = 0; len < (ssize) info->size; len += nbytes) {
+        if ((nbytes = websPageReadData(wp, &content[len], info->size - len)) <= 0) {
             break;
         }
     }
-    wfree(buf);
-    if (wp->txRemaining <= 0) {
-        websDone(wp);
+    websPageClose(wp);
+    if (len != (ssize) info->size) {
+        wfree(fp);
+        return 0;
+    }
+    formatETag(etag, sizeof(etag), info);
+    if ((date = websGetDateString(info)) != 0) {
+        fp->headers = sfmt("Last-Modified: %s\r\nETag: %s\r\nAccept-Ranges: bytes\r\n", date, etag);
+        wfree(date);
+    } else {
+        fp->headers = sfmt("ETag: %s\r\nAccept-Ranges: bytes\r\n", etag);
+    }
+    fp->filename = sclone(wp->filename);
+    fp->info = *info;
+    fp->refs = 1;
+    if (!fp->headers || !fp->filename || hashEnter(fileIndex, fp->filename, valueSymbol(fp), 0) == 0) {
+        freeEntry(fp);
+        return 0;
     }
+    fp->headersLen = slen(fp->headers);
+    fp->size = (ssize) info->size + fp->headersLen;
+    while (fileTail && fileStats.size + fp->size > ME_GOAHEAD_LIMIT_FILE_CACHE) {
+        removeEntry(fileTail);
+        fileStats.evictions++;
+    }
+    fp->next = fileHead;
+    if (fileHead) {
+        fileHead->prev = fp;
+    } else {
+        fileTail = fp;
+    }
+    fileHead = fp;
+    fileStats.size += fp->size;
+    fileStats.entries++;
+    return fp;
+}
+
+
+/*
+    Write a cached document. The headers are copied behind the standard response headers and the content is
+    referenced, so both are written to the socket together without copying the content.
+ */
+static void serveEntry(Webs *wp, FileEntry *fp)
+{
+    wp->docSize = fp->info.size;
+    websSetStatus(wp, HTTP_CODE_OK);
+    websWriteHeaders(wp, (ssize) fp->info.size, 0);
+    trace(3 | WEBS_RAW_MSG, "%s", fp->headers);
+    websWriteBlock(wp, fp->headers, fp->headersLen);
+    websWriteEndHeaders(wp);
+    if (!smatch(wp->method, "HEAD") && fp->info.size > 0) {
+        fp->refs++;
+        websWriteRef(wp, (char*) &fp[1], (ssize) fp->info.size, releaseContent);
+    }
+    websDone(wp);
+}
+
+
+/*
+    Remove an entry from the cache. The entry is freed once no response is writing its content.
+ */
+static void removeEntry(FileEntry *fp)
+{
+    if (fp->prev) {
+        fp->prev->next = fp->next;
+    } else {
+        fileHead = fp->next;
+    }
+    if (fp->next) {
+        fp->next->prev = fp->prev;
+    } else {
+        fileTail = fp->prev;
+    }
+    fp->prev = fp->next = 0;
+    hashDelete(fileIndex, fp->filename);
+    fileStats.size -= fp->size;
+    fileStats.entries--;
+    if (--fp->refs == 0) {
+        freeEntry(fp);
+    }
+}
+
+
+/*
+    Release callback for a response that has finished writing cached content
+ */
+static void releaseContent(void *data)
+{
+    FileEntry   *fp;
+
+    fp = ((FileEntry*) data) - 1;
+    if (--fp->refs == 0) {
+        freeEntry(fp);
+    }
+}
+
+
+static void freeEntry(FileEntry *fp)
+{
+    wfree(fp->filename);
+    wfree(fp->headers);
+    wfree(fp);
+}
+#endif
+
+
+#if ME_ROM
+/*
+    Send a compiled page with the headers prebuilt by webcomp. The content is sent from read-only data without copying.
+    Compiled pages are validated by their entity tag, so Last-Modified is not sent.
+ */
+static void serveRom(Webs *wp, WebsRomIndex *wip)
+{
+    wp->docSize = wip->size;
+    wp->flags |= WEBS_DOC_HEADERS;
+    websSetStatus(wp, HTTP_CODE_OK);
+    websWriteHeaders(wp, wip->size, 0);
+    trace(3 | WEBS_RAW_MSG, "%s", wip->headers);
+    websWriteBlock(wp, wip->headers, slen(wip->headers));
+    websWriteEndHeaders(wp);
+    if (!smatch(wp->method, "HEAD") && wip->size > 0) {
+        websWriteRef(wp, (cchar*) wip->page, wip->size, 0);
+    }
+    websDone(wp);
+}
+#endif
+
+
+PUBLIC void websFreeFileCache(void)
+{
+#if ME_GOAHEAD_LIMIT_STAT_CACHE > 0
+    int     i;
+
+    if (statCache) {
+        for (i = 0; i < ME_GOAHEAD_LIMIT_STAT_CACHE; i++) {
+            wfree(statCache[i].filename);
+        }
+        wfree(statCache);
+        statCache = 0;
+    }
+#endif
+#if FILE_CACHE
+    while (fileHead) {
+        removeEntry(fileHead);
+    }
+    if (fileIndex >= 0) {
+        hashFree(fileIndex);
+        fileIndex = -1;
+    }
+#endif
+#if FD_CACHE
+    while (fdHead) {
+        removeFd(fdHead);
+    }
+    if (fdEvent >= 0) {
+        websStopEvent(fdEvent);
+        fdEvent = -1;
+    }
+    if (fdIndex >= 0) {
+        hashFree(fdIndex);
+        fdIndex = -1;
+    }
+#endif
+}
+
+
+PUBLIC void websGetFileCacheStats(WebsFileCacheStats *stats)
+{
+    assert(stats);
+
+#if FILE_CACHE
+    *stats = fileStats;
+    stats->max = ME_GOAHEAD_LIMIT_FILE_CACHE;
+#else
+    memset(stats, 0, sizeof(WebsFileCacheStats));
+#endif
 }
 
 
@@ -14,8 +14,29 @@
 /*
     Symbol table for web pages and files
  */
-static WebsHash romFs;
+static WebsHash romFs = -1;
+
+/*
+    Number of pages in a perfect hash index generated by webcomp
+ */
+static int romCount;
+
+/*
+    Page index. This is websRomIndex or the index of a mapped page archive.
+ */
+static WebsRomIndex *romIndex = websRomIndex;
+
+#if ME_UNIX_LIKE
+static char *romMap;
+static ssize romMapSize;
+
+static cchar *archiveString(uint offset);
+#endif
+
+static void closeArchive(void);
 static WebsRomIndex *lookup(WebsHash fs, char *path);
+static void openArchive(cchar *path);
+static uint romHash(cchar *path, ssize len, uint seed);
 #endif
 
 /*********************************** Code *************************************/
@@ -27,8 +48,17 @@ PUBLIC int websFsOpen(void)
     char            name[ME_GOAHEAD_LIMIT_FILENAME];
     ssize           len;
 
+    if (*ME_GOAHEAD_ROM_ARCHIVE) {
+        openArchive(ME_GOAHEAD_ROM_ARCHIVE);
+    }
+    for (romCount = 0; romIndex[romCount].path; romCount++) ;
+    if (romCount > 0 && romIndex[0].seed) {
+        /* Webcomp generated a perfect hash over the page paths */
+        return 0;
+    }
+    romCount = 0;
     romFs = hashCreate(WEBS_HASH_INIT);
-    for (wip = websRomIndex; wip->path; wip++) {
+    for (wip = romIndex; wip->path; wip++) {
         strncpy(name, wip->path, ME_GOAHEAD_LIMIT_FILENAME);
         len = strlen(name) - 1;
         if (len > 0 && (name[len] == '/' || name[len] == '\\')) {
@@ -45,6 +75,8 @@ PUBLIC void websFsClose(void)
 {
 #if ME_ROM
     hashFree(romFs);
+    romFs = -1;
+    closeArchive();
 #endif
 }
 
@@ -58,7 +90,7 @@ PUBLIC int websOpenFile(cchar *path, int flags, int mode)
         return -1;
     }
     wip->pos = 0;
-    return (int) (wip - websRomIndex);
+    return (int) (wip - romIndex);
 #else
     return open(path, flags, mode);
 #endif
@@ -120,6 +152,14 @@ PUBLIC int websStatFile(cchar *path, WebsFileInfo *sbuf)
     sbuf->size = (ssize) s.st_size;
     sbuf->mtime = s.st_mtime;
     sbuf->isDir = s.st_mode & S_IFDIR;
+    sbuf->inode = (uint64) s.st_ino;
+#if LINUX
+    sbuf->mtimeNsec = (int) s.st_mtim.tv_nsec;
+#elif MACOSX
+    sbuf->mtimeNsec = (int) s.st_mtimespec.tv_nsec;
+#else
+    sbuf->mtimeNsec = 0;
+#endif
     return 0;
 #endif
 }
@@ -134,7 +174,7 @@ PUBLIC ssize websReadFile(int fd, char *buf, ssize size)
     assert(buf);
     assert(fd >= 0);
 
-    wip = &websRomIndex[fd];
+    wip = &romIndex[fd];
 
     len = min(wip->size - wip->pos, size);
     memcpy(buf, &wip->page[wip->pos], len);
@@ -176,7 +216,7 @@ Offset websSeekFile(int fd, Offset offset, int origin)
     assert(origin == SEEK_SET || origin == SEEK_CUR || origin == SEEK_END);
     assert(fd >= 0);
 
-    wip = &websRomIndex[fd];
+    wip = &romIndex[fd];
 
     if (origin != SEEK_SET && origin != SEEK_CUR && origin != SEEK_END) {
         errno = EINVAL;
@@ -220,11 +260,160 @@ PUBLIC ssize websWriteFile(int fd, cchar *buf, ssize size)
 
 
 #if ME_ROM
-static WebsRomIndex *lookup(WebsHash fs, char *path)
+/*
+    Map a page archive created by "webcomp --archive" and index its pages in place of websRomIndex. The pages are
+    served directly from the mapping. If the archive does not exist or is invalid, the compiled pages are used.
+    The archive must be replaced by renaming a new file over it. Truncating or rewriting a mapped file in place can
+    fault the server with SIGBUS.
+ */
+static void openArchive(cchar *path)
+{
+#if ME_UNIX_LIKE
+    WebsRomHeader   *hp;
+    WebsRomEntry    *ep;
+    WebsRomIndex    *wip;
+    WebsStat        sbuf;
+    uint            i;
+    int             fd;
+
+    if ((fd = open(path, O_RDONLY)) < 0) {
+        if (errno != ENOENT) {
+            error("Cannot open page archive %s, errno %d", path, errno);
+        }
+        return;
+    }
+    if (fstat(fd, &sbuf) < 0 || sbuf.st_size < (Offset) sizeof(WebsRomHeader)) {
+        close(fd);
+        error("Invalid page archive %s", path);
+        return;
+    }
+    romMapSize = (ssize) sbuf.st_size;
+    romMap = mmap(0, romMapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (romMap == MAP_FAILED) {
+        romMap = 0;
+        error("Cannot map page archive %s, errno %d", path, errno);
+        return;
+    }
+    hp = (WebsRomHeader*) romMap;
+    if (memcmp(hp->magic, WEBS_ROM_MAGIC, sizeof(WEBS_ROM_MAGIC)) != 0 || hp->version != WEBS_ROM_VERSION ||
+            hp->size != (uint64) romMapSize ||
+            hp->count > (romMapSize - sizeof(WebsRomHeader)) / sizeof(WebsRomEntry)) {
+        error("Invalid page archive %s", path);
+        closeArchive();
+        return;
+    }
+    if ((romIndex = walloc((hp->count + 1) * sizeof(WebsRomIndex))) == 0) {
+        romIndex = websRomIndex;
+        closeArchive();
+        return;
+    }
+    memset(romIndex, 0, (hp->count + 1) * sizeof(WebsRomIndex));
+    ep = (WebsRomEntry*) &hp[1];
+    for (i = 0, wip = romIndex; i < hp->count; i++, ep++, wip++) {
+        wip->path = (char*) archiveString(ep->path);
+        wip->etag = archiveString(ep->etag);
+        wip->headers = archiveString(ep->headers);
+        if (!wip->path || (ep->etag && !wip->etag) || (ep->headers && !wip->headers) ||
+                ep->data > (uint64) romMapSize || ep->size > (uint64) romMapSize - ep->data || ep->size > MAXINT ||
+                (ep->seed < 0 && (uint) -(ep->seed + 1) >= hp->count)) {
+            error("Invalid page archive %s", path);
+            closeArchive();
+            return;
+        }
+        wip->page = ep->data ? (uchar*) &romMap[ep->data] : 0;
+        wip->size = (int) ep->size;
+        wip->seed = ep->seed;
+    }
+    trace(2, "Serving %d pages from archive %s", hp->count, path);
+#endif
+}
+
+
+#if ME_UNIX_LIKE
+/*
+    Get a string from the mapped archive. Returns null if the offset is zero or the string is not within the archive.
+ */
+static cchar *archiveString(uint offset)
+{
+    if (offset == 0 || offset >= (uint64) romMapSize || !memchr(&romMap[offset], 0, romMapSize - offset)) {
+        return 0;
+    }
+    return &romMap[offset];
+}
+#endif
+
+
+static void closeArchive(void)
 {
-    WebsKey     *sp;
-    ssize       len;
+#if ME_UNIX_LIKE
+    if (romIndex != websRomIndex) {
+        wfree(romIndex);
+        romIndex = websRomIndex;
+    }
+    if (romMap) {
+        munmap(romMap, romMapSize);
+        romMap = 0;
+    }
+#endif
+}
+
+
+PUBLIC WebsRomIndex *websLookupRom(cchar *path)
+{
+    return lookup(romFs, (char*) path);
+}
+
 
+/*
+    Hash a page path as "/path" without a trailing separator. This must match romHash() in src/utils/webcomp.c.
+ */
+static uint romHash(cchar *path, ssize len, uint seed)
+{
+    uint    hash;
+    ssize   i;
+
+    hash = 2166136261U ^ seed;
+    if (*path != '/') {
+        hash = (hash ^ '/') * 16777619U;
+    }
+    for (i = 0; i < len; i++) {
+        hash = (hash ^ (uchar) path[i]) * 16777619U;
+    }
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bU;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35U;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+
+static WebsRomIndex *lookup(WebsHash fs, char *path)
+{
+    WebsRomIndex    *wip;
+    WebsKey         *sp;
+    cchar           *name;
+    ssize           len;
+    int             seed, slot;
+
+    if (romCount > 0) {
+        /*
+            The bucket for the path holds either the seed to rehash the path or, if negative, the slot of its only page
+         */
+        len = slen(path);
+        if (len > 1 && (path[len - 1] == '/' || path[len - 1] == '\\')) {
+            len--;
+        }
+        seed = romIndex[romHash(path, len, 0) % romCount].seed;
+        slot = (seed < 0) ? -seed - 1 : (int) (romHash(path, len, seed) % romCount);
+        wip = &romIndex[slot];
+        name = (*path == '/') ? wip->path : &wip->path[1];
+        if (strncmp(name, path, len) == 0 && name[len] == '\0') {
+            return wip;
+        }
+        return 0;
+    }
     if ((sp = hashLookup(fs, path)) == NULL) {
         if (path[0] != '/') {
             path = sfmt("/%s", path);
@@ -8,8 +8,10 @@
         --home directory       # Change to directory to run
         --log logFile:level    # Log to file file at verbosity level
         --route routeFile      # Route configuration file
+        --threads count        # Number of event loop threads
         --verbose              # Same as --log stdout:2
         --version              # Output version information
+        --workers count        # Number of prefork worker processes
 
     Copyright (c) All Rights Reserved. See details at the end of the file.
  */
@@ -22,6 +24,15 @@
 
 static int finished = 0;
 
+#if ME_UNIX_LIKE
+static int reload = 0;
+static int reopen = 0;
+static int workers = 0;
+static cchar *routeFile;                /* Configuration reloaded on SIGHUP */
+static cchar *authFile;
+static sigset_t workerMask;             /* Signal mask restored in workers */
+#endif
+
 /********************************* Forwards ***********************************/
 
 static void initPlatform(void);
@@ -35,7 +46,12 @@ static LRESULT CALLBACK websWindProc(HWND hwnd, UINT msg, UINT wp, LPARAM lp);
 #endif
 
 #if ME_UNIX_LIKE
+static int checkConfig(cchar *route, cchar *auth);
+static void reloadWorkers(int *pids, WebsTime *started, int count, cchar *route, cchar *auth);
+static void runWorkers(int count, cchar *route, cchar *auth);
 static void sigHandler(int signo);
+static int startWorker(void);
+static void stopWorkers(int *pids, int count);
 #endif
 
 /*********************************** Code *************************************/
@@ -87,10 +103,22 @@ MAIN(goahead, int argc, char **argv, char **envp)
         } else if (smatch(argp, "--route") || smatch(argp, "-r")) {
             route = argv[++argind];
 
+#if ME_GOAHEAD_THREADS
+        } else if (smatch(argp, "--threads")) {
+            if (argind >= argc) usage();
+            websSetThreads(atoi(argv[++argind]));
+#endif
+
         } else if (smatch(argp, "--version") || smatch(argp, "-V")) {
             printf("%s\n", ME_VERSION);
             exit(0);
 
+#if ME_UNIX_LIKE
+        } else if (smatch(argp, "--workers")) {
+            if (argind >= argc) usage();
+            workers = atoi(argv[++argind]);
+#endif
+
         } else if (*argp == '-' && isdigit((uchar) argp[1])) {
             lspec = sfmt("stdout:%s", &argp[1]);
             logSetPath(lspec);
@@ -167,7 +195,17 @@ MAIN(goahead, int argc, char **argv, char **envp)
         }
     }
 #endif
+#if ME_UNIX_LIKE
+    routeFile = route;
+    authFile = auth;
+    if (workers > 0) {
+        runWorkers(workers, route, auth);
+    } else {
+        websServiceEvents(&finished);
+    }
+#else
     websServiceEvents(&finished);
+#endif
     logmsg(1, "Instructed to exit");
     websClose();
 #if WINDOWS
@@ -210,8 +248,15 @@ static void usage(void) {
         "    --home directory       # Change to directory to run\n"
         "    --log logFile:level    # Log to file file at verbosity level\n"
         "    --route routeFile      # Route configuration file\n"
+#if ME_GOAHEAD_THREADS
+        "    --threads count        # Number of event loop threads\n"
+#endif
         "    --verbose              # Same as --log stdout:2\n"
-        "    --version              # Output version information\n\n",
+        "    --version              # Output version information\n"
+#if ME_UNIX_LIKE
+        "    --workers count        # Number of prefork worker processes\n"
+#endif
+        "\n",
         ME_TITLE, ME_NAME);
     exit(-1);
 }
@@ -221,6 +266,10 @@ static void initPlatform(void)
 {
 #if ME_UNIX_LIKE
     signal(SIGTERM, sigHandler);
+    signal(SIGHUP, sigHandler);
+    #if ME_GOAHEAD_ACCESS_LOG
+        signal(SIGUSR1, sigHandler);
+    #endif
     #ifdef SIGPIPE
         signal(SIGPIPE, SIG_IGN);
     #endif
@@ -233,7 +282,234 @@ static void initPlatform(void)
 #if ME_UNIX_LIKE
 static void sigHandler(int signo)
 {
-    finished = 1;
+    if (signo == SIGHUP) {
+        /*
+            The prefork master reloads and replaces its workers. Otherwise reload in the event loop without dropping
+            connections.
+         */
+        if (workers > 0) {
+            reload = 1;
+        } else {
+            websScheduleReload(routeFile, authFile);
+        }
+    } else if (signo == SIGUSR1) {
+        /* Reopen the access log after external rotation. The master forwards this to the workers. */
+        websReopenAccessLog();
+        reopen = 1;
+    } else if (signo == SIGCHLD) {
+        /* Only wakes the prefork master from sigsuspend to reap workers */
+    } else {
+        finished = 1;
+    }
+}
+
+
+/*
+    Prefork process model. The master binds the endpoints and then supervises worker processes that service requests
+    on the inherited listening sockets. Crashed workers are restarted. SIGHUP reloads the route and auth configuration
+    by starting new workers and then gracefully retiring the old ones. Sessions are private to each worker.
+ */
+static void runWorkers(int count, cchar *route, cchar *auth)
+{
+    struct sigaction    act;
+    sigset_t            mask;
+    WebsTime            *started;
+    int                 *pids, pid, status, i;
+
+    memset(&act, 0, sizeof(act));
+    act.sa_handler = sigHandler;
+    sigemptyset(&act.sa_mask);
+    sigaction(SIGHUP, &act, 0);
+    sigaction(SIGINT, &act, 0);
+    sigaction(SIGTERM, &act, 0);
+    sigaction(SIGCHLD, &act, 0);
+#if ME_GOAHEAD_ACCESS_LOG
+    sigaction(SIGUSR1, &act, 0);
+#endif
+    /*
+        Keep these signals blocked except while waiting in sigsuspend. Otherwise a signal arriving after the flags are
+        tested but before the master sleeps would not be acted upon until the next worker exits.
+     */
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGHUP);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGCHLD);
+#if ME_GOAHEAD_ACCESS_LOG
+    sigaddset(&mask, SIGUSR1);
+#endif
+    sigprocmask(SIG_BLOCK, &mask, &workerMask);
+
+    pids = walloc(sizeof(int) * count);
+    started = walloc(sizeof(WebsTime) * count);
+    if (pids == 0 || started == 0) {
+        wfree(pids);
+        wfree(started);
+        sigprocmask(SIG_SETMASK, &workerMask, 0);
+        return;
+    }
+    for (i = 0; i < count; i++) {
+        pids[i] = startWorker();
+        started[i] = time(0);
+    }
+    while (!finished) {
+        if (reload) {
+            reload = 0;
+            reloadWorkers(pids, started, count, route, auth);
+            continue;
+        }
+        if (reopen) {
+            reopen = 0;
+            for (i = 0; i < count; i++) {
+                if (pids[i] > 0) {
+                    kill(pids[i], SIGUSR1);
+                }
+            }
+            continue;
+        }
+        for (i = 0; i < count; i++) {
+            if (pids[i] <= 0) {
+                sleep(1);
+                pids[i] = startWorker();
+                started[i] = time(0);
+            }
+        }
+        if ((pid = waitpid(-1, &status, WNOHANG)) == 0) {
+            sigsuspend(&workerMask);
+            continue;
+        } else if (pid < 0) {
+            continue;
+        }
+        for (i = 0; i < count; i++) {
+            if (pids[i] == pid) {
+                if (WIFSIGNALED(status)) {
+                    error("Worker %d terminated by signal %d", pid, WTERMSIG(status));
+                } else {
+                    logmsg(1, "Worker %d exited with status %d", pid, WEXITSTATUS(status));
+                }
+                /*
+                    Throttle restarts if the worker cannot stay up
+                 */
+                if ((time(0) - started[i]) < 1) {
+                    sleep(1);
+                }
+                pids[i] = finished ? 0 : startWorker();
+                started[i] = time(0);
+                break;
+            }
+        }
+    }
+    sigprocmask(SIG_SETMASK, &workerMask, 0);
+    stopWorkers(pids, count);
+    wfree(pids);
+    wfree(started);
+}
+
+
+static int startWorker(void)
+{
+    int     pid;
+
+    if ((pid = fork()) < 0) {
+        error("Cannot fork worker, errno %d", errno);
+        return -1;
+    }
+    if (pid == 0) {
+        signal(SIGHUP, SIG_IGN);
+        signal(SIGCHLD, SIG_DFL);
+        sigprocmask(SIG_SETMASK, &workerMask, 0);
+        if (socketResetPoller() < 0) {
+            exit(1);
+        }
+        websServiceEvents(&finished);
+        websShutdown(ME_GOAHEAD_LIMIT_TIMEOUT * 1000);
+        websClose();
+        exit(0);
+    }
+    logmsg(2, "Started worker %d", pid);
+    return pid;
+}
+
+
+/*
+    Validate the configuration in a throw-away child so a bad file does not disturb the master. If valid, reload in
+    the master so new workers inherit it, then replace the workers one at a time.
+ */
+static void reloadWorkers(int *pids, WebsTime *started, int count, cchar *route, cchar *auth)
+{
+    int     i, old;
+
+    if (checkConfig(route, auth) < 0) {
+        error("Configuration is invalid, continuing with the current configuration");
+        return;
+    }
+    if (websReload(route, auth) < 0) {
+        error("Cannot reload configuration");
+        return;
+    }
+    logmsg(1, "Reloaded configuration, restarting workers");
+    for (i = 0; i < count; i++) {
+        old = pids[i];
+        pids[i] = startWorker();
+        started[i] = time(0);
+        if (old > 0) {
+            kill(old, SIGTERM);
+        }
+    }
+}
+
+
+static int checkConfig(cchar *route, cchar *auth)
+{
+    int     pid, status;
+
+    if ((pid = fork()) < 0) {
+        return -1;
+    }
+    if (pid == 0) {
+        exit(websReload(route, auth) < 0 ? 1 : 0);
+    }
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+    return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : -1;
+}
+
+
+/*
+    Ask the workers to finish their requests and exit. Workers that do not exit in time are killed.
+ */
+static void stopWorkers(int *pids, int count)
+{
+    WebsTime    deadline;
+    int         i, pid, status;
+
+    for (i = 0; i < count; i++) {
+        if (pids[i] > 0) {
+            kill(pids[i], SIGTERM);
+        }
+    }
+    deadline = time(0) + ME_GOAHEAD_LIMIT_TIMEOUT + 5;
+    while ((pid = waitpid(-1, &status, WNOHANG)) >= 0) {
+        if (pid == 0) {
+            if (time(0) >= deadline) {
+                for (i = 0; i < count; i++) {
+                    if (pids[i] > 0) {
+                        kill(pids[i], SIGKILL);
+                    }
+                }
+            }
+            usleep(100 * 1000);
+            continue;
+        }
+        for (i = 0; i < count; i++) {
+            if (pids[i] == pid) {
+                pids[i] = 0;
+            }
+        }
+    }
 }
 #endif
 
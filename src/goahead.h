@@ -41,6 +41,98 @@ extern "C" {
         #define ME_GOAHEAD_DEBUG 0
     #endif
 #endif
+#ifndef ME_GOAHEAD_EPOLL
+    #if LINUX
+        #define ME_GOAHEAD_EPOLL 1              /**< Use epoll for socket readiness on Linux */
+    #else
+        #define ME_GOAHEAD_EPOLL 0
+    #endif
+#endif
+#ifndef ME_GOAHEAD_SENDFILE
+    #if LINUX && !ME_ROM
+        #define ME_GOAHEAD_SENDFILE 1           /**< Send static files with sendfile() for non-TLS requests */
+    #else
+        #define ME_GOAHEAD_SENDFILE 0
+    #endif
+#endif
+#ifndef ME_GOAHEAD_PRECOMPRESS
+    #define ME_GOAHEAD_PRECOMPRESS 1            /**< Serve precompressed .br and .gz documents to accepting clients */
+#endif
+#ifndef ME_GOAHEAD_ROM_ARCHIVE
+    #define ME_GOAHEAD_ROM_ARCHIVE "web.rom"    /**< Page archive mapped instead of the compiled pages. Empty to disable */
+#endif
+#ifndef ME_GOAHEAD_SIMD
+    #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        #define ME_GOAHEAD_SIMD 1               /**< Use SSE2 (or AVX2 if enabled by the compiler) to scan headers */
+    #else
+        #define ME_GOAHEAD_SIMD 0
+    #endif
+#endif
+#ifndef ME_GOAHEAD_THREADS
+    #define ME_GOAHEAD_THREADS 0                /**< Support multiple event loop threads (multi-reactor mode) */
+#endif
+#if ME_GOAHEAD_THREADS
+    #if !ME_UNIX_LIKE
+        #error "ME_GOAHEAD_THREADS requires a Unix-like platform"
+    #endif
+    #if ME_GOAHEAD_REPLACE_MALLOC
+        #error "ME_GOAHEAD_THREADS cannot be used with ME_GOAHEAD_REPLACE_MALLOC"
+    #endif
+    #define WEBS_THREAD_LOCAL __thread          /**< Storage owned by each event loop thread */
+#else
+    #define WEBS_THREAD_LOCAL
+#endif
+#ifndef ME_GOAHEAD_LIMIT_HASH_TABLES
+    #define ME_GOAHEAD_LIMIT_HASH_TABLES 8192   /**< Maximum hash tables when running multiple event loop threads */
+#endif
+#ifndef ME_GOAHEAD_LIMIT_ARENA
+    #define ME_GOAHEAD_LIMIT_ARENA 4096         /**< Request arena block size */
+#endif
+#ifndef ME_GOAHEAD_ACCESS_LOG_FORMAT
+    #define ME_GOAHEAD_ACCESS_LOG_FORMAT "common"   /**< Access log format: common, combined or json */
+#endif
+#ifndef ME_GOAHEAD_ACCESS_LOG_SIZE
+    #define ME_GOAHEAD_ACCESS_LOG_SIZE 0        /**< Rotate the access log above this size. Zero for no rotation */
+#endif
+#ifndef ME_GOAHEAD_ACCESS_LOG_BACKUPS
+    #define ME_GOAHEAD_ACCESS_LOG_BACKUPS 5     /**< Rotated access logs to keep */
+#endif
+#ifndef ME_GOAHEAD_LIMIT_LOG_BUFFER
+    #define ME_GOAHEAD_LIMIT_LOG_BUFFER 65536   /**< Access log buffer per event loop thread */
+#endif
+#ifndef ME_GOAHEAD_LIMIT_LOG_FLUSH
+    #define ME_GOAHEAD_LIMIT_LOG_FLUSH 1000     /**< Maximum delay in milliseconds before buffered log records are written */
+#endif
+#ifndef ME_GOAHEAD_LIMIT_STAT_CACHE
+    #define ME_GOAHEAD_LIMIT_STAT_CACHE 256     /**< Metadata entries cached per event loop thread. Zero to disable */
+#endif
+#ifndef ME_GOAHEAD_LIMIT_STAT_LIFE
+    #define ME_GOAHEAD_LIMIT_STAT_LIFE 1000     /**< Milliseconds cached document metadata is trusted without a stat */
+#endif
+#ifndef ME_GOAHEAD_LIMIT_FILE_CACHE
+    #define ME_GOAHEAD_LIMIT_FILE_CACHE 1048576 /**< Document content cached per event loop thread. Zero to disable */
+#endif
+#ifndef ME_GOAHEAD_LIMIT_FILE_CACHE_ITEM
+    #define ME_GOAHEAD_LIMIT_FILE_CACHE_ITEM 65536  /**< Largest document held in the file cache */
+#endif
+#ifndef ME_GOAHEAD_LIMIT_FD_CACHE
+    #define ME_GOAHEAD_LIMIT_FD_CACHE 64        /**< Open document descriptors cached per thread. Zero to disable */
+#endif
+#ifndef ME_GOAHEAD_LIMIT_WEBS_POOL
+    #define ME_GOAHEAD_LIMIT_WEBS_POOL 64       /**< Maximum idle request objects retained for reuse per event loop */
+#endif
+#ifndef ME_GOAHEAD_LIMIT_TX_HIGH
+    #define ME_GOAHEAD_LIMIT_TX_HIGH 65536      /**< Queued output above which a request is not writable */
+#endif
+#ifndef ME_GOAHEAD_LIMIT_TX_LOW
+    #define ME_GOAHEAD_LIMIT_TX_LOW 16384       /**< Queued output below which a request is writable again */
+#endif
+#ifndef ME_GOAHEAD_LIMIT_DISPATCH
+    #define ME_GOAHEAD_LIMIT_DISPATCH 128       /**< Maximum socket events dispatched per event loop iteration */
+#endif
+#ifndef ME_GOAHEAD_POLL_EVENTS
+    #define ME_GOAHEAD_POLL_EVENTS 256          /**< Maximum ready events collected per epoll_wait */
+#endif
 #if ECOS
     #if ME_GOAHEAD_CGI
         #error "Ecos does not support CGI. Disable ME_GOAHEAD_CGI"
@@ -531,6 +623,7 @@ typedef struct WebsBuf {
     char    *endp;              /**< Pointer to end of data */
     char    *endbuf;            /**< Pointer to end of buffer */
     ssize   buflen;             /**< Length of ring queue */
+    ssize   initlen;            /**< Initial length of ring queue */
     ssize   maxsize;            /**< Maximum size */
     int     increment;          /**< Growth increment */
 } WebsBuf;
@@ -963,6 +1056,8 @@ PUBLIC WebsKey *hashNext(WebsHash id, WebsKey *last);
 #define SOCKET_BUFFERED_READ    0x200   /**< Message pending on this socket */
 #define SOCKET_BUFFERED_WRITE   0x400   /**< Message pending on this socket */
 #define SOCKET_NODELAY          0x800   /**< Disable Nagle algorithm */
+#define SOCKET_QUEUED           0x1000  /**< Socket is on the ready queue */
+#define SOCKET_REUSE_PORT       0x2000  /**< Permit multiple listeners on the same endpoint (SO_REUSEPORT) */
 
 #define SOCKET_PORT_MAX         0xffff  /**< Max Port size */
 
@@ -1031,13 +1126,15 @@ typedef struct WebsSocket {
     int             flags;              /**< Current state flags */
     Socket          sock;               /**< Actual socket handle */
     int             fileHandle;         /**< ID of the file handler */
-    int             interestEvents;     /**< Mask of events to watch for */
+    int             interestEvents;     /**< Mask of events registered with the poller (epoll) */
     int             currentEvents;      /**< Mask of ready events (FD_xx) */
     int             selectEvents;       /**< Events being selected */
     int             saveMask;           /**< saved Mask for socketFlush */
     int             error;              /**< Last error */
     int             secure;             /**< Socket is using SSL */
     int             handshakes;         /**< Number of renegotiations */
+    struct WebsSocket *readyNext;       /**< Next socket on the ready queue */
+    struct WebsSocket *readyPrev;       /**< Previous socket on the ready queue */
 } WebsSocket;
 
 
@@ -1277,6 +1374,9 @@ PUBLIC int socketParseAddress(cchar *ipAddrPort, char **pip, int *pport, int *se
 
 /**
     Process pending socket I/O events.
+    @description Dispatches sockets on the ready queue filled by socketSelect and socketReservice. At most
+        ME_GOAHEAD_LIMIT_DISPATCH sockets are serviced per call. Sockets that still have buffered read data after
+        their handler runs are requeued for the next call.
     @ingroup WebsSocket
     @stability Stable
     @internal
@@ -1304,6 +1404,16 @@ PUBLIC ssize socketRead(int sid, void *buf, ssize len);
  */
 PUBLIC void socketRegisterInterest(int sid, int mask);
 
+/**
+    Recreate the readiness poller
+    @description This must be called in a child process after fork() so the child does not share the parent's epoll
+        interest list. All open sockets are re-registered with the new poller.
+    @return Zero if successful, otherwise -1.
+    @ingroup WebsSocket
+    @stability Evolving
+ */
+PUBLIC int socketResetPoller(void);
+
 /**
     Request that the socket be reserviced.
     @description This routine is useful when upper layers have unprocessed, buffered data for the socket.
@@ -1320,7 +1430,7 @@ PUBLIC void socketReservice(int sid);
         until a suitable I/O event or timeout occurs.
     @param sid Socket ID handle returned from socketConnect or socketAccept.
     @param timeout Timeout in milliseconds.
-    @return Number of I/O events.
+    @return Number of I/O events. If sid is -1, this is the number of sockets on the ready queue.
     @ingroup WebsSocket
     @stability Stable
  */
@@ -1378,6 +1488,49 @@ PUBLIC int socketWaitForEvent(WebsSocket *sp, int mask);
  */
 PUBLIC ssize socketWrite(int sid, void *buf, ssize len);
 
+/**
+    I/O vector element for socketWritev
+    @ingroup WebsSocket
+    @stability Evolving
+ */
+#if ME_UNIX_LIKE
+    typedef struct iovec WebsIOVec;
+#else
+    typedef struct WebsIOVec {
+        void    *iov_base;              /**< Start of the data */
+        size_t  iov_len;                /**< Length of the data */
+    } WebsIOVec;
+#endif
+
+/**
+    Write a vector of buffers to the socket
+    @description Writes the buffers in order with a single system call where supported.
+    @param sid Socket ID handle returned from socketConnect or socketAccept.
+    @param iov Array of buffer descriptors
+    @param count Number of elements in iov
+    @return Count of bytes written. May be less than the total if the socket is in non-blocking mode.
+        If the transport is saturated, will return a negative error and errno will be set to EAGAIN or EWOULDBLOCK.
+    @ingroup WebsSocket
+    @stability Evolving
+ */
+PUBLIC ssize socketWritev(int sid, WebsIOVec *iov, int count);
+
+#if ME_GOAHEAD_SENDFILE
+/**
+    Write file data to the socket without copying through user space
+    @param sid Socket ID handle returned from socketConnect or socketAccept.
+    @param fd File descriptor to read from
+    @param offset Pointer to the file offset to read from. Updated by the number of bytes written.
+    @param len Number of bytes to write
+    @return Count of bytes written. May be less than len if the socket is in non-blocking mode or the file is shorter
+        than expected. If the transport is saturated, will return a negative error and errno will be set to
+        EAGAIN or EWOULDBLOCK.
+    @ingroup WebsSocket
+    @stability Evolving
+ */
+PUBLIC ssize socketSendFile(int sid, int fd, Offset *offset, ssize len);
+#endif
+
 /**
     Return the socket object for the socket ID.
     @param sid Socket ID handle returned from socketConnect or socketAccept.
@@ -1413,6 +1566,20 @@ PUBLIC WebsSocket *socketPtr(int sid);
  */
 PUBLIC char *fmt(char *buf, ssize maxSize, cchar *format, ...);
 
+/**
+    Format a string into a static buffer using a va_list.
+    @description This call format a string using printf style formatting arguments. A trailing null will
+        always be appended.
+    @param buf Pointer to the buffer.
+    @param maxSize Size of the buffer.
+    @param format Printf style format string
+    @param args Varargs argument obtained from va_start.
+    @return Returns the buffer.
+    @ingroup WebsRuntime
+    @stability Evolving
+ */
+PUBLIC char *fmtv(char *buf, ssize maxSize, cchar *format, va_list args);
+
 /**
     Allocate a handle from a map
     @param map Reference to a location holding the map reference. On the first call, the map is allocated.
@@ -1755,10 +1922,28 @@ PUBLIC void websStopEvent(int id);
  */
 PUBLIC void websRestartEvent(int id, int delay);
 
+/**
+    Get the current monotonic time
+    @description The time is not affected by changes to the system clock and is only useful for measuring intervals.
+    @return Elapsed time in milliseconds from an arbitrary epoch.
+    @ingroup WebsRuntime
+    @stability Evolving
+ */
+PUBLIC Ticks websGetTicks(void);
+
+/**
+    Get the current monotonic time in microseconds
+    @description The time is not affected by changes to the system clock and is only useful for measuring intervals.
+    @return Elapsed time in microseconds from an arbitrary epoch.
+    @ingroup WebsRuntime
+    @stability Evolving
+ */
+PUBLIC int64 websGetMicroTicks(void);
+
 /**
     Run due events
     @ingroup WebsRuntime
-    @return Time delay till the next event
+    @return Time delay in milliseconds till the next event
     @internal
  */
 PUBLIC int websRunEvents(void);
@@ -1845,6 +2030,10 @@ PUBLIC WebsUpload *websLookupUpload(struct Webs *wp, cchar *key);
 #if ME_GOAHEAD_LEGACY
 #define WEBS_LOCAL              0x8000      /**< Request from local system */
 #endif
+#define WEBS_TX_FULL            0x10000     /**< Queued output exceeded the high watermark */
+#define WEBS_HEADER_VARS        0x20000     /**< HTTP_* header variables created */
+#define WEBS_VARY_ENCODING      0x40000     /**< Response varies with the Accept-Encoding header */
+#define WEBS_DOC_HEADERS        0x80000     /**< Content length and type are in precomputed document headers */
 
 /*
     Incoming chunk encoding states. Used for tx and rx chunking.
@@ -1881,19 +2070,148 @@ PUBLIC WebsUpload *websLookupUpload(struct Webs *wp, cchar *key);
  */
 typedef void (*WebsWriteProc)(struct Webs *wp);
 
+/**
+    Generation tagged reference to a Webs object
+    @description A handle encodes the index of the request object and the generation of that index. It may be safely
+        retained by deferred callbacks and mapped back to the request via websLookup. Handles to freed requests
+        do not resolve, even if the index has been reused.
+    @ingroup Webs
+    @stability Evolving
+ */
+typedef int WebsHandle;
+
+/**
+    Callback to release referenced transmit data
+    @param data Data reference passed to websWriteRef
+    @ingroup Webs
+    @stability Evolving
+ */
+typedef void (*WebsReleaseProc)(void *data);
+
+/**
+    Transmit segment
+    @description Response data is queued as a chain of segments that is written to the socket with writev().
+        A segment either owns storage that immediately follows the segment header, or references caller data.
+    @ingroup Webs
+    @stability Evolving
+ */
+typedef struct WebsSeg {
+    struct WebsSeg  *next;              /**< Next segment in the chain */
+    char            *data;              /**< Start of unwritten data */
+    ssize           len;                /**< Length of unwritten data */
+    ssize           room;               /**< Free space after the data in owned storage. Zero if referenced */
+    ssize           size;               /**< Size of owned storage. Zero if referenced */
+    void            *ref;               /**< Referenced data to pass to release */
+    WebsReleaseProc release;            /**< Callback when referenced data has been written */
+} WebsSeg;
+
+/*
+    Known request headers. Indexes into Webs.known for websGetKnownHeader
+ */
+#define WEBS_HEADER_ACCEPT_ENCODING     0
+#define WEBS_HEADER_AUTHORIZATION       1
+#define WEBS_HEADER_CONNECTION          2
+#define WEBS_HEADER_CONTENT_LENGTH      3
+#define WEBS_HEADER_CONTENT_TYPE        4
+#define WEBS_HEADER_COOKIE              5
+#define WEBS_HEADER_HOST                6
+#define WEBS_HEADER_IF_MODIFIED_SINCE   7
+#define WEBS_HEADER_IF_NONE_MATCH       8
+#define WEBS_HEADER_IF_RANGE            9
+#define WEBS_HEADER_RANGE               10
+#define WEBS_HEADER_REFERER             11
+#define WEBS_HEADER_TRANSFER_ENCODING   12
+#define WEBS_HEADER_USER_AGENT          13
+#define WEBS_HEADER_MAX                 14
+
+/**
+    Request header slice
+    @description Locates a null terminated string in the request header block (Webs.rxHeaders).
+    @ingroup Webs
+    @stability Evolving
+ */
+typedef struct WebsSlice {
+    int             offset;             /**< Offset in rxHeaders. Zero if not present */
+    int             len;                /**< String length */
+} WebsSlice;
+
+/**
+    Byte range of a partial response
+    @ingroup Webs
+    @stability Evolving
+ */
+typedef struct WebsRange {
+    Offset          start;              /**< Offset of the first byte */
+    Offset          end;                /**< Offset one past the last byte */
+} WebsRange;
+
+/**
+    Request header
+    @ingroup Webs
+    @stability Evolving
+ */
+typedef struct WebsHeader {
+    WebsSlice       key;                /**< Lower case header key */
+    WebsSlice       value;              /**< Header value */
+} WebsHeader;
+
+/**
+    Request arena block
+    @description Request lifetime memory is allocated from a chain of arena blocks. The usable memory follows the
+        block header.
+    @ingroup Webs
+    @stability Evolving
+ */
+typedef struct WebsArena {
+    struct WebsArena *next;             /**< Next (older) block */
+    ssize           size;               /**< Usable size of the block */
+    ssize           used;               /**< Bytes allocated from the block */
+} WebsArena;
+
+/**
+    Request pool statistics
+    @description Freed Webs objects are retained on a free list with their buffers for reuse by later connections.
+        Statistics are per event loop thread.
+    @ingroup Webs
+    @stability Evolving
+ */
+typedef struct WebsPoolStats {
+    int             max;                /**< Maximum idle objects retained (limitWebsPool) */
+    int             idle;               /**< Idle objects currently in the pool */
+    int             idleHighWater;      /**< Most idle objects held in the pool */
+    int             active;             /**< Request objects currently allocated */
+    int             activeHighWater;    /**< Most request objects allocated at once */
+    int             segments;           /**< Idle transmit segments currently in the pool */
+    ssize           largestBuffer;      /**< Largest receive or input buffer held by an idle object */
+    int64           hits;               /**< Allocations satisfied from the pool */
+    int64           misses;             /**< Allocations that required a new object */
+} WebsPoolStats;
+
 /**
     GoAhead request structure. This is a per-socket connection structure.
     @defgroup Webs Webs
  */
 typedef struct Webs {
+    struct Webs     *nextFree;          /**< Next idle object in the request pool */
     WebsBuf         rxbuf;              /**< Raw receive buffer */
+    ssize           rxScanned;          /**< Bytes of rxbuf already scanned for the end of headers */
+    char            *rxHeaders;         /**< Request line and headers. Keys and values are null terminated in place */
+    WebsArena       *arena;             /**< Request lifetime memory. Reset when the request completes */
+    WebsHeader      headers[ME_GOAHEAD_LIMIT_NUM_HEADERS]; /**< Request headers in rxHeaders */
+    int             headerCount;        /**< Number of request headers */
+    WebsSlice       known[WEBS_HEADER_MAX]; /**< Last value of each known request header */
     WebsBuf         input;              /**< Receive buffer after de-chunking */
-    WebsBuf         output;             /**< Transmit buffer after chunking */
-    WebsBuf         chunkbuf;           /**< Pre-chunking data buffer */
+    WebsSeg         *txHead;            /**< Transmit segment chain after chunking */
+    WebsSeg         *txTail;            /**< Last transmit segment */
+    WebsSeg         *chunkHead;         /**< Body segments awaiting chunk framing */
+    WebsSeg         *chunkTail;         /**< Last body segment awaiting chunk framing */
+    ssize           txQueued;           /**< Bytes queued in the transmit chain */
+    ssize           chunkQueued;        /**< Bytes queued awaiting chunk framing */
     WebsBuf         *txbuf;
     WebsTime        since;              /**< Parsed if-modified-since time */
     WebsTime        timestamp;          /**< Last transaction with browser */
-    WebsHash        vars;               /**< CGI standard variables */
+    int64           started;            /**< Time the request started in microseconds (websGetMicroTicks) */
+    WebsHash        vars;               /**< Request variables. Created on first write, -1 until then */
     int             timeout;            /**< Timeout handle */
     char            ipaddr[ME_MAX_IP];  /**< Connecting ipaddress */
     char            ifaddr[ME_MAX_IP];  /**< Local interface ipaddress */
@@ -1904,33 +2222,27 @@ typedef struct Webs {
     ssize           lastRead;           /**< Number of bytes last read from the socket */
     bool            eof;                /**< If at the end of the request content */
 
-    char            txChunkPrefix[16];  /**< Transmit chunk prefix */
-    char            *txChunkPrefixNext; /**< Current I/O pos in txChunkPrefix */
-    ssize           txChunkPrefixLen;   /**< Length of prefix */
-    ssize           txChunkLen;         /**< Length of the chunk */
-    int             txChunkState;       /**< Transmit chunk state */
-
-    char            *authDetails;       /**< Http header auth details */
+    char            *authDetails;       /**< Http header auth details. Arena */
     char            *authResponse;      /**< Outgoing auth header */
-    char            *authType;          /**< Authorization type (Basic/DAA) */
-    char            *contentType;       /**< Body content type */
-    char            *cookie;            /**< Request cookie string */
-    char            *decodedQuery;      /**< Decoded request query */
+    char            *authType;          /**< Authorization type (Basic/DAA). Arena */
+    char            *contentType;       /**< Body content type. Refers to rxHeaders */
+    char            *cookie;            /**< Request cookie string. Arena */
+    char            *decodedQuery;      /**< Decoded request query. Arena */
     char            *digest;            /**< Password digest */
-    char            *ext;               /**< Path extension */
-    char            *filename;          /**< Document path name */
-    char            *host;              /**< Requested host */
-    char            *method;            /**< HTTP request method */
+    char            *ext;               /**< Path extension. Arena */
+    char            *filename;          /**< Document path name. Arena */
+    char            *host;              /**< Requested host. Arena */
+    char            *method;            /**< HTTP request method. Arena */
     char            *password;          /**< Authorization password */
     char            *path;              /**< Path name without query. This is decoded. */
-    char            *protoVersion;      /**< Protocol version (HTTP/1.1)*/
+    char            *protoVersion;      /**< Protocol version (HTTP/1.1). Arena */
     char            *protocol;          /**< Protocol scheme (normally http|https) */
     char            *putname;           /**< PUT temporary filename */
-    char            *query;             /**< Request query. This is decoded. */
+    char            *query;             /**< Request query. This is decoded. Arena */
     char            *realm;             /**< Realm field supplied in auth header */
-    char            *referrer;          /**< The referring page */
-    char            *url;               /**< Full request url. This is not decoded. */
-    char            *userAgent;         /**< User agent (browser) */
+    char            *referrer;          /**< The referring page. Refers to rxHeaders */
+    char            *url;               /**< Full request url. This is not decoded. Arena */
+    char            *userAgent;         /**< User agent (browser). Refers to rxHeaders */
     char            *username;          /**< Authorization username */
     int             sid;                /**< Socket id (handler) */
     int             listenSid;          /**< Listen Socket id */
@@ -1944,6 +2256,7 @@ typedef struct Webs {
     ssize           txRemaining;        /**< Remaining content to write */
     ssize           txLen;              /**< Tx content length header value */
     int             wid;                /**< Index into webs */
+    WebsHandle      handle;             /**< Generation tagged handle for this request */
 #if ME_GOAHEAD_CGI
     char            *cgiStdin;          /**< Filename for CGI program input */
     int             cgifd;              /**< File handle for CGI program input */
@@ -1952,6 +2265,14 @@ typedef struct Webs {
     int             putfd;              /**< File handle to write PUT data */
 #endif
     int             docfd;              /**< File descriptor for document being served */
+    struct WebsFdEntry *docEntry;       /**< Cached descriptor entry if docfd is shared with other requests */
+    Offset          docOffset;          /**< Offset of the next document byte to send */
+    Offset          docSize;            /**< Size of the document being served */
+    cchar           *contentEncoding;   /**< Content encoding of a precompressed document. Static */
+    WebsRange       *ranges;            /**< Byte ranges of a partial response. Arena */
+    char            *rangeBoundary;     /**< Multipart boundary if sending more than one range. Arena */
+    int             rangeCount;         /**< Number of ranges */
+    int             rangeIndex;         /**< Index of the range being sent */
     ssize           written;            /**< Bytes actually transferred */
     ssize           putLen;             /**< Bytes read by a PUT request */
 
@@ -1962,8 +2283,12 @@ typedef struct Webs {
     WebsHash        responseCookies;    /**< Outgoing cookies */
     struct WebsSession *session;        /**< Session record */
     struct WebsRoute *route;            /**< Request route */
+    struct WebsRouteSet *routeSet;      /**< Route configuration the request was routed with */
     struct WebsUser *user;              /**< User auth record */
     WebsWriteProc   writeData;          /**< Handler write I/O event callback. Used by fileHandler */
+    WebsWriteProc   writable;           /**< Callback when queued output drains below the low watermark */
+    ssize           txHigh;             /**< Queued output high watermark */
+    ssize           txLow;              /**< Queued output low watermark */
     int             encoded;            /**< True if the password is MD5(username:realm:password) */
 #if ME_GOAHEAD_DIGEST
     char            *cnonce;            /**< check nonce */
@@ -2063,6 +2388,8 @@ typedef struct WebsFileInfo {
     ulong           size;                   /**< File length */
     int             isDir;                  /**< Set if directory */
     WebsTime        mtime;                  /**< Modified time */
+    uint64          inode;                  /**< File serial number. Zero if not supported */
+    int             mtimeNsec;              /**< Nanoseconds part of the modified time. Zero if not supported */
 } WebsFileInfo;
 
 /**
@@ -2075,8 +2402,46 @@ typedef struct WebsRomIndex {
     uchar           *page;                  /**< Web page data */
     int             size;                   /**< Size of web page in bytes */
     Offset          pos;                    /**< Current read position */
+    cchar           *etag;                  /**< Entity tag of the page content. Null if not compiled by webcomp */
+    cchar           *headers;               /**< Content-Length, Content-Type, ETag and Accept-Ranges header lines */
+    int             seed;                   /**< Perfect hash seed or slot for the bucket. Zero if not generated */
 } WebsRomIndex;
 
+/*
+    Page archive created by "webcomp --archive". The archive holds a header, the page index in perfect hash order,
+    the strings referenced by the index and the page content. Each page starts on a WEBS_ROM_ALIGN boundary.
+    Offsets are from the start of the archive and values are in the byte order of the target.
+ */
+#define WEBS_ROM_MAGIC      "GOAHROM"           /**< Archive magic string */
+#define WEBS_ROM_VERSION    1                   /**< Archive format version */
+#define WEBS_ROM_ALIGN      16                  /**< Alignment of page content in the archive */
+
+/**
+    Page archive header
+    @ingroup Webs
+    @stability Evolving
+ */
+typedef struct WebsRomHeader {
+    char            magic[8];               /**< WEBS_ROM_MAGIC */
+    uint            version;                /**< WEBS_ROM_VERSION */
+    uint            count;                  /**< Number of index entries that follow the header */
+    uint64          size;                   /**< Total archive size in bytes */
+} WebsRomHeader;
+
+/**
+    Page archive index entry
+    @ingroup Webs
+    @stability Evolving
+ */
+typedef struct WebsRomEntry {
+    uint64          data;                   /**< Offset of the page content. Zero for directories */
+    uint64          size;                   /**< Size of the page content */
+    uint            path;                   /**< Offset of the page path */
+    uint            etag;                   /**< Offset of the entity tag. Zero if none */
+    uint            headers;                /**< Offset of the precomputed header lines. Zero if none */
+    int             seed;                   /**< Perfect hash seed or slot for the bucket */
+} WebsRomEntry;
+
 #if ME_ROM
     /**
         List of documents to service when built with ROM support
@@ -2084,6 +2449,17 @@ typedef struct WebsRomIndex {
         @stability Stable
      */
     PUBLIC_DATA WebsRomIndex websRomIndex[];
+
+    /**
+        Find a ROM page
+        @description Pages compiled by webcomp are found via a perfect hash over their paths without allocating.
+            If the ME_GOAHEAD_ROM_ARCHIVE page archive exists, pages are found in the archive instead of websRomIndex.
+        @param path Page path. A leading "/" is optional and a trailing "/" is ignored.
+        @return The page index entry or null if the page is not in the ROM
+        @ingroup Webs
+        @stability Evolving
+     */
+    PUBLIC WebsRomIndex *websLookupRom(cchar *path);
 #endif
 
 #define WEBS_DECODE_TOKEQ 1                 /**< Decode base 64 blocks up to a NULL or equals */
@@ -2116,6 +2492,48 @@ PUBLIC void websActionOpen(void);
  */
 PUBLIC int websAlloc(int sid);
 
+/**
+    Get request pool statistics
+    @description Return the request object pool statistics for the calling event loop thread.
+    @param stats Structure to receive the statistics
+    @ingroup Webs
+    @stability Evolving
+ */
+PUBLIC void websGetPoolStats(WebsPoolStats *stats);
+
+/**
+    Allocate request lifetime memory
+    @description Memory is allocated from a per-request arena by incrementing a pointer. It must not be freed
+        individually. The arena is reset when the request completes and the connection is reused or closed.
+    @param wp Webs request object
+    @param size Size of the block to allocate
+    @return Pointer to the allocated block or null if memory cannot be allocated.
+    @ingroup Webs
+    @stability Evolving
+ */
+PUBLIC void *websArenaAlloc(Webs *wp, ssize size);
+
+/**
+    Clone a string into the request arena
+    @param wp Webs request object
+    @param str String to clone. If null, an empty string is returned.
+    @return The cloned string. Must not be freed. Returns null if memory cannot be allocated.
+    @ingroup Webs
+    @stability Evolving
+ */
+PUBLIC char *websArenaClone(Webs *wp, cchar *str);
+
+/**
+    Format a string into the request arena
+    @param wp Webs request object
+    @param fmt Printf style format string
+    @param ... Arguments for the format string
+    @return The formatted string. Must not be freed. Returns null if memory cannot be allocated.
+    @ingroup Webs
+    @stability Evolving
+ */
+PUBLIC char *websArenaFmt(Webs *wp, cchar *fmt, ...);
+
 /**
     Cancel the request timeout.
     @description Handlers may choose to manually manage the request timeout. This routine will disable the
@@ -2301,6 +2719,18 @@ PUBLIC void websError(Webs *wp, int code, cchar *fmt, ...);
  */
 PUBLIC cchar *websErrorMsg(int code);
 
+/**
+    Find the end of the HTTP headers
+    @description Scan a block for the blank line ("\r\n\r\n") that terminates the request headers. The scan
+        uses SSE2 or AVX2 vector instructions if ME_GOAHEAD_SIMD is enabled.
+    @param buf Buffer to scan
+    @param len Length of the buffer
+    @return Pointer to the terminating "\r\n\r\n" or null if not found.
+    @ingroup Webs
+    @stability Evolving
+ */
+PUBLIC char *websFindHeaderEnd(cchar *buf, ssize len);
+
 /**
     Open and initialize the file handler
     @ingroup Webs
@@ -2308,6 +2738,52 @@ PUBLIC cchar *websErrorMsg(int code);
  */
 PUBLIC void websFileOpen(void);
 
+/**
+    Free the file handler caches owned by the current event loop thread
+    @description The file handler caches document metadata for limitStatLife milliseconds so conditional requests
+        can be answered without a stat of the document. It also caches the content of small documents and open
+        descriptors for larger documents. Each event loop thread has its own caches which are freed when the thread
+        closes its connections.
+    @ingroup Webs
+    @stability Evolving
+ */
+PUBLIC void websFreeFileCache(void);
+
+/**
+    Release a document descriptor shared from the file descriptor cache
+    @description Called by websPageClose. The descriptor is closed when it is no longer cached and no other request
+        is using it.
+    @param wp Webs request object
+    @ingroup Webs
+    @stability Evolving
+ */
+PUBLIC void websReleaseDocument(Webs *wp);
+
+/**
+    File cache statistics
+    @description Small documents are held in memory with their prebuilt response headers so a request can be served
+        without opening the document. Statistics are per event loop thread.
+    @ingroup Webs
+    @stability Evolving
+ */
+typedef struct WebsFileCacheStats {
+    ssize           max;                /**< Maximum bytes cached (limitFileCache) */
+    ssize           size;               /**< Bytes currently cached */
+    int             entries;            /**< Documents currently cached */
+    int64           hits;               /**< Requests served from the cache */
+    int64           misses;             /**< Requests that loaded or reloaded a document */
+    int64           evictions;          /**< Documents removed to make room for others */
+} WebsFileCacheStats;
+
+/**
+    Get file cache statistics
+    @description Return the file cache statistics for the calling event loop thread.
+    @param stats Structure to receive the statistics
+    @ingroup Webs
+    @stability Evolving
+ */
+PUBLIC void websGetFileCacheStats(WebsFileCacheStats *stats);
+
 /**
     Flush buffered transmit data and compact the transmit buffer to make room for more data
     @description This call initiates sending buffered data. If blocking mode is selected via the block parameter,
@@ -2315,7 +2791,7 @@ PUBLIC void websFileOpen(void);
         If block is false, the flush will be initiated and the call will return immediately without blocking.
     @param wp Webs request object
     @param block Set to true to wait for all data to be written to the socket. Set to false to
-        write whatever the socket can absorb without blocking.
+        write whatever the socket can absorb without blocking. The remainder is then written on writable events.
     @return -1 for I/O errors. Return zero if there is more data remaining in the buffer. Return 1 if the
         contents of the transmit buffer are fully written and the buffer is now empty.
     @ingroup Webs
@@ -2325,7 +2801,9 @@ PUBLIC int websFlush(Webs *wp, bool block);
 
 /**
     Free the webs request object.
-    @description Callers should call websDone to complete requests prior to invoking websFree.
+    @description Callers should call websDone to complete requests prior to invoking websFree. The connection is
+        closed and the object is returned to the request pool with its buffers for reuse by a later connection.
+        If the pool already holds limitWebsPool objects, the object is freed.
     @param wp Webs request object
     @ingroup Webs
     @stability Stable
@@ -2427,6 +2905,17 @@ PUBLIC cchar *websGetExt(Webs *wp);
  */
 PUBLIC cchar *websGetFilename(Webs *wp);
 
+/**
+    Get a request header value
+    @description Header keys are matched caselessly. If the header is repeated, the first value is returned.
+    @param wp Webs request object
+    @param key Header key
+    @return Header value or null if not present. Caller should not free.
+    @ingroup Webs
+    @stability Evolving
+ */
+PUBLIC cchar *websGetHeader(Webs *wp, cchar *key);
+
 /**
     Get the request host
     @description The request host is set to the Host HTTP header value if it is present. Otherwise it is set to
@@ -2456,6 +2945,30 @@ PUBLIC cchar *websGetIfaddr(Webs *wp);
  */
 PUBLIC cchar *websGetIndex(void);
 
+/**
+    Get a known request header value
+    @description Known headers are recognized while parsing and are retrieved without searching.
+    @param wp Webs request object
+    @param id Header identifier. Set to WEBS_HEADER_ACCEPT_ENCODING, WEBS_HEADER_AUTHORIZATION, WEBS_HEADER_CONNECTION,
+        WEBS_HEADER_CONTENT_LENGTH, WEBS_HEADER_CONTENT_TYPE, WEBS_HEADER_COOKIE, WEBS_HEADER_HOST,
+        WEBS_HEADER_IF_MODIFIED_SINCE, WEBS_HEADER_IF_NONE_MATCH, WEBS_HEADER_IF_RANGE, WEBS_HEADER_RANGE,
+        WEBS_HEADER_REFERER, WEBS_HEADER_TRANSFER_ENCODING or WEBS_HEADER_USER_AGENT.
+    @return Header value or null if not present. If the header is repeated, the last value is returned.
+        Caller should not free.
+    @ingroup Webs
+    @stability Evolving
+ */
+PUBLIC cchar *websGetKnownHeader(Webs *wp, int id);
+
+/**
+    Get the mime type for a file extension
+    @param ext File extension including the leading period. For example: ".html".
+    @return Mime type string or null if the extension is unknown. Caller should not free.
+    @ingroup Webs
+    @stability Evolving
+ */
+PUBLIC cchar *websGetMimeType(cchar *ext);
+
 /**
     Get the request method
     @param wp Webs request object
@@ -2707,6 +3220,8 @@ PUBLIC int websOptionsOpen(void);
 
 /**
     Close the document page
+    @description If the document descriptor is shared from the file descriptor cache, the request reference is
+        released and the descriptor is left open for other requests.
     @param wp Webs request object
     @ingroup Webs
     @stability Stable
@@ -2910,9 +3425,22 @@ PUBLIC int websStatFile(cchar *path, WebsFileInfo *sbuf);
  */
 PUBLIC int websServer(cchar *endpoint, cchar *documents);
 
+/**
+    Gracefully stop servicing requests
+    @description Closes the listening endpoints and idle connections, disables keep-alive on active connections and
+        then continues to service events until all requests have completed or the timeout expires.
+    @param timeout Maximum time to wait in milliseconds.
+    @return Number of connections still open when the call returned.
+    @ingroup Webs
+    @stability Evolving
+ */
+PUBLIC int websShutdown(int timeout);
+
 /**
     Service I/O events until finished
-    @description This will wait for socket events and service those until *finished is set to true
+    @description This will wait for socket events and service those until *finished is set to true.
+        If websSetThreads has requested multiple event loop threads, they are started by this call and joined
+        before it returns.
     @param finished Integer location to test. If set to true, then exit. Note: setting finished will not
         automatically wake up the service routine.
     @ingroup Webs
@@ -2920,6 +3448,39 @@ PUBLIC int websServer(cchar *endpoint, cchar *documents);
  */
 PUBLIC void websServiceEvents(int *finished);
 
+/**
+    Configure the access log
+    @description Requests are formatted into a buffer per event loop thread. The buffer is written when it is half
+        full and at least every limitLogFlush milliseconds. May be called before or after websOpen. Only effective if
+        built with ME_GOAHEAD_ACCESS_LOG.
+    @param path Log filename. Set to null for the default "access.log".
+    @param format Set to "common" for the NCSA common log format, "combined" to add the referrer, user agent and
+        request latency in microseconds, or "json" for one JSON object per line.
+    @param size Rotate the log when it exceeds this size in bytes. Set to zero for no rotation.
+    @param backups Number of rotated logs to keep. These are named path.1 (newest) to path.backups.
+    @return Zero if successful, otherwise -1 if the format is unknown or the log cannot be opened.
+    @ingroup Webs
+    @stability Evolving
+ */
+PUBLIC int websSetAccessLog(cchar *path, cchar *format, ssize size, int backups);
+
+/**
+    Write buffered access log records
+    @description Writes the records buffered by the calling event loop thread.
+    @ingroup Webs
+    @stability Evolving
+ */
+PUBLIC void websFlushAccessLog(void);
+
+/**
+    Reopen the access log
+    @description Request the access log be closed and reopened before the next write, such as after the log has been
+        renamed by an external log rotation utility. This only sets a flag and is safe to call from a signal handler.
+    @ingroup Webs
+    @stability Evolving
+ */
+PUBLIC void websReopenAccessLog(void);
+
 /**
     Set the background processing flag
     @param on Value to set the background flag to.
@@ -2935,6 +3496,18 @@ PUBLIC void websSetBackground(int on);
  */
 PUBLIC void websSetBackgroundWriter(Webs *wp, WebsWriteProc proc);
 
+/**
+    Define a callback for when the response is writable again
+    @description Output written via websWriteBlock is queued and never blocks. When the queued output exceeds the
+        high watermark, websWritable returns false and the handler should stop generating output. The callback is
+        invoked once the queued output drains below the low watermark so the handler can resume.
+    @param wp Webs request object
+    @param proc Writable callback
+    @ingroup Webs
+    @stability Evolving
+ */
+PUBLIC void websSetWritableHandler(Webs *wp, WebsWriteProc proc);
+
 /*
     Flags for websSetCookie
  */
@@ -2979,12 +3552,24 @@ PUBLIC void websSetDocuments(cchar *dir);
 
 /**
     Create the CGI environment variables for the current request.
+    @description The CGI variables (REQUEST_METHOD, QUERY_STRING, SERVER_PORT etc.) are resolved on demand by
+        websGetVar. This enters them into wp->vars and is only required before iterating over wp->vars directly.
     @param wp Webs request object
     @ingroup Webs
     @stability Stable
  */
 PUBLIC void websSetEnv(Webs *wp);
 
+/**
+    Create the HTTP_* request header variables
+    @description Header variables are created on demand. This is invoked by websGetVar and websTestVar for HTTP_*
+        names and by the CGI and JST handlers. Call this before iterating over wp->vars directly.
+    @param wp Webs request object
+    @ingroup Webs
+    @stability Evolving
+ */
+PUBLIC void websSetHeaderVars(Webs *wp);
+
 /**
     Create request variables for query and POST body data
     @description This creates request variables if the request is a POST form (has a Content-Type of
@@ -3038,6 +3623,29 @@ PUBLIC void websSetQueryVars(Webs *wp);
  */
 PUBLIC void websSetStatus(Webs *wp, int status);
 
+/**
+    Set the number of event loop threads
+    @description When built with ME_GOAHEAD_THREADS, websServiceEvents will run this many event loops (reactors).
+        Each thread owns its socket list, connection list, timers and poller, and opens its own SO_REUSEPORT listener
+        for every endpoint given to websListen. Must be called before websListen. Routes, users, handlers, actions
+        and mime types are shared and must not be modified once the threads have started.
+    @param count Number of event loop threads including the caller. Values less than 2 select single threaded mode.
+    @return Zero if successful. Returns -1 if multiple threads are not supported by this build.
+    @ingroup Webs
+    @stability Evolving
+ */
+PUBLIC int websSetThreads(int count);
+
+/**
+    Set the output queue watermarks for a request
+    @param wp Webs request object
+    @param low Queued output level at which output is written and below which the writable callback is invoked
+    @param high Queued output level above which the request is not writable
+    @ingroup Webs
+    @stability Evolving
+ */
+PUBLIC void websSetTxWatermarks(Webs *wp, ssize low, ssize high);
+
 /**
     Set the response body content length
     @param wp Webs request object
@@ -3074,6 +3682,19 @@ PUBLIC WebsKey *websSetVarFmt(Webs *wp, cchar *name, cchar *fmt, ...);
  */
 PUBLIC WebsKey *websSetVar(Webs *wp, cchar *name, cchar *value);
 
+/**
+    Set a request variable with the value stored in the request arena
+    @description This is the same as websSetVar except the value is copied into the request arena rather than
+        being separately allocated.
+    @param wp Webs request object
+    @param name Variable name to set
+    @param value Value to set
+    @return the WebsKey
+    @ingroup Webs
+    @stability Evolving
+ */
+PUBLIC WebsKey *websSetArenaVar(Webs *wp, cchar *name, cchar *value);
+
 /**
     Test if  a request variable is defined
     @param wp Webs request object
@@ -3167,6 +3788,33 @@ PUBLIC int websUrlParse(cchar *url, char **buf, char **protocol, char **host, ch
  */
 PUBLIC bool websValid(Webs *wp);
 
+/**
+    Test if the response can accept more output without exceeding the high watermark
+    @param wp Webs request object
+    @return True if queued output is below the high watermark.
+    @ingroup Webs
+    @stability Evolving
+ */
+PUBLIC bool websWritable(Webs *wp);
+
+/**
+    Get the handle for a webs object
+    @param wp Webs request object
+    @return Handle that may be passed to websLookup.
+    @ingroup Webs
+    @stability Evolving
+ */
+PUBLIC WebsHandle websGetHandle(Webs *wp);
+
+/**
+    Map a handle to a webs object
+    @param handle Handle returned by websGetHandle
+    @return Webs request object or null if the object has since been freed.
+    @ingroup Webs
+    @stability Evolving
+ */
+PUBLIC Webs *websLookup(WebsHandle handle);
+
 /**
     Validate a URI path as expected in a HTTP request line
     @description This expects a URI beginning with "/" and containing only valid URI characters.
@@ -3253,8 +3901,10 @@ PUBLIC ssize websWriteFile(int fd, cchar *buf, ssize size);
 
 /**
     Write a block of data to the response
-    @description The data is buffered and will be sent to the client when the buffer is full or websFlush is
-        called. This routine will never return "short", it will always write all the data unless there are errors.
+    @description The data is queued and never blocks. It is written once the queued output reaches the low
+        watermark, when the handler returns to the event loop from a socket event, or when websFlush is called.
+        Code that writes from a timer or another event should call websFlush(wp, 0) so small writes are not delayed.
+        This routine will never return "short", it will always write all the data unless there are errors.
     @param wp Webs request object
     @param buf Buffer of data to write
     @param size Length of buf
@@ -3264,6 +3914,21 @@ PUBLIC ssize websWriteFile(int fd, cchar *buf, ssize size);
  */
 PUBLIC ssize websWriteBlock(Webs *wp, cchar *buf, ssize size);
 
+/**
+    Write a block of data to the response without copying
+    @description The data is referenced by the transmit chain and written with the other response data using
+        writev(). The caller must not modify or free the data until the release callback is invoked.
+    @param wp Webs request object
+    @param buf Buffer of data to write
+    @param size Length of buf
+    @param release Callback invoked with buf when the data has been written or the request is freed.
+        Set to null for static data.
+    @return Count of bytes queued or -1. This will always equal size if there are no errors.
+    @ingroup Webs
+    @stability Evolving
+ */
+PUBLIC ssize websWriteRef(Webs *wp, cchar *buf, ssize size, WebsReleaseProc release);
+
 /**
     Write a block of data to the network
     @description This bypassed output buffering and is the lowest level write.
@@ -3565,8 +4230,23 @@ typedef struct WebsRoute {
     WebsParseAuth   parseAuth;              /**< Parse authentication details callback*/
     WebsVerify      verify;                 /**< Verify password callback */
     int             flags;                  /**< Route control flags */
+    uint            methodMask;             /**< Methods as a bitmask. Computed by the route index */
+    uint64          extensionMask;          /**< Extensions as a bitmask. Computed by the route index */
+    bool            methodHash;             /**< Methods include names without a bit. Test the methods hash */
+    bool            extensionHash;          /**< Extensions include names without a bit. Test the extensions hash */
 } WebsRoute;
 
+/**
+    Enable or disable the route index
+    @description Routes are compiled into a prefix trie when added or loaded, so only routes whose prefix matches the
+        request path are examined. Routes are still tested in configuration order. When disabled, every route is
+        tested in turn. This is used to benchmark the index.
+    @param on Set to true to use the index
+    @ingroup WebsRoute
+    @stability Evolving
+ */
+PUBLIC void websSetRouteIndex(bool on);
+
 /**
     Add a route to the routing tables
     @param uri Matching URI prefix
@@ -3602,6 +4282,43 @@ PUBLIC int websLoad(cchar *path);
  */
 PUBLIC int websOpenRoute(void);
 
+/**
+    Reload the route and authentication configuration
+    @description Loads the given configuration files into a new set of routes, users and roles and then replaces
+        the current configuration in one step. Handlers and actions remain defined. Requests in progress continue
+        with the routes, users and roles they were routed with, and these are freed when the last such request
+        completes.
+        If either file cannot be loaded, the current configuration is retained. This must be called from the
+        event loop, not a signal handler. See websScheduleReload.
+    @param routeFile Route configuration filename. May be null.
+    @param authFile Authentication configuration filename. May be null.
+    @return Zero if successful, otherwise -1.
+    @ingroup WebsRoute
+    @stability Evolving
+ */
+PUBLIC int websReload(cchar *routeFile, cchar *authFile);
+
+/**
+    Release the request's reference to its route configuration
+    @description Called when a request completes. The routes, users and roles of a replaced configuration are freed
+        when the last request using them is released.
+    @param wp Webs request object
+    @ingroup WebsRoute
+    @stability Evolving
+ */
+PUBLIC void websReleaseRoutes(Webs *wp);
+
+/**
+    Schedule a reload of the route and authentication configuration
+    @description The event loop calls websReload between requests. This only sets a flag and is safe to call from a
+        signal handler. The filenames are not copied and must remain valid.
+    @param routeFile Route configuration filename. May be null.
+    @param authFile Authentication configuration filename. May be null.
+    @ingroup WebsRoute
+    @stability Evolving
+ */
+PUBLIC void websScheduleReload(cchar *routeFile, cchar *authFile);
+
 /**
     Remove a route from the routing tables
     @param uri Matching URI prefix
@@ -3801,6 +4518,30 @@ PUBLIC bool websLogoutUser(Webs *wp);
  */
 PUBLIC WebsUser *websLookupUser(cchar *username);
 
+/**
+    Lookup a user for a request
+    @description Searches the users of the route configuration the request was routed with. If the configuration
+        has since been replaced by websReload, the request continues to see the users it started with.
+    @param wp Webs request object
+    @param username User name to search for
+    @return User object or null if the user cannot be found
+    @ingroup WebsAuth
+    @stability Evolving
+ */
+PUBLIC WebsUser *websLookupRequestUser(Webs *wp, cchar *username);
+
+/**
+    Get the user and role tables for a request
+    @description Returns the tables of the route configuration the request was routed with. These remain valid
+        until the request completes.
+    @param wp Webs request object
+    @param users Set to the user table
+    @param roles Set to the role table. May be null.
+    @ingroup WebsAuth
+    @stability Evolving
+ */
+PUBLIC void websGetRouteAuth(Webs *wp, WebsHash *users, WebsHash *roles);
+
 /**
     Remove a role from the system
     @param role Role name
@@ -3819,6 +4560,46 @@ PUBLIC int websRemoveRole(cchar *role);
  */
 PUBLIC int websRemoveUser(cchar *name);
 
+/**
+    Remove all users and roles
+    @description The master secret and the authentication actions are preserved.
+    @ingroup WebsAuth
+    @stability Evolving
+ */
+PUBLIC void websResetAuth(void);
+
+/**
+    Begin loading a new set of users and roles
+    @description Creates empty user and role tables. Users and roles added by websAddUser and websAddRole, including
+        those defined by websLoad, go to the new tables until websCommitAuth is called. Requests continue to use
+        the current users and roles. Used by websReload.
+    @return Zero if successful, otherwise -1.
+    @ingroup WebsAuth
+    @stability Evolving
+ */
+PUBLIC int websStageAuth(void);
+
+/**
+    Complete loading a set of users and roles
+    @param commit Set to true to make the loaded users and roles current. Otherwise they are discarded.
+    @param users Set to the replaced user table if committing. The caller must keep it for requests routed before
+        the commit and free it via websFreeAuth once no request refers to it. Used by websReload which keeps the
+        replaced tables with the retired route set.
+    @param roles Set to the replaced role table if committing.
+    @ingroup WebsAuth
+    @stability Evolving
+ */
+PUBLIC void websCommitAuth(bool commit, WebsHash *users, WebsHash *roles);
+
+/**
+    Free a user and role table replaced by websCommitAuth
+    @param users User table. May be -1.
+    @param roles Role table. May be -1.
+    @ingroup WebsAuth
+    @stability Evolving
+ */
+PUBLIC void websFreeAuth(WebsHash users, WebsHash roles);
+
 /**
     Open the authentication module
     @param minimal Reserved. Set to zero.
@@ -3897,6 +4678,7 @@ typedef struct WebsSession {
     int             lifespan;               /**< Session inactivity timeout (secs) */
     WebsTime        expires;                /**< When the session expires */
     WebsHash        cache;                  /**< Cache of session variables */
+    int             refs;                   /**< References by the session table and requests using the session */
 } WebsSession;
 
 /**
@@ -3941,7 +4723,8 @@ PUBLIC char *websGetSessionID(Webs *wp);
     Get the session state object for the current request
     @param wp Webs request object
     @param create Set to true to create a new session if one does not already exist.
-    @return Session object
+    @return Session object. The request holds a reference to the session until it completes, so the session is not
+        freed while in use even if it expires or is destroyed by another request.
     @ingroup WebsSession
     @stability Stable
  */
@@ -3952,7 +4735,8 @@ PUBLIC WebsSession *websGetSession(Webs *wp, int create);
     @param wp Webs request object
     @param name Session variable name
     @param defaultValue Default value to return if the variable does not exist
-    @return Session variable value or default value if it does not exist
+    @return Session variable value or default value if it does not exist. The value is a copy in the request arena
+        and is valid until the request completes.
     @ingroup WebsSession
     @stability Stable
  */
@@ -11,11 +11,28 @@
 
 #include    "goahead.h"
 
+#if ME_GOAHEAD_SIMD
+    #if defined(__AVX2__)
+        #include    <immintrin.h>
+    #else
+        #include    <emmintrin.h>
+    #endif
+    #if defined(_MSC_VER)
+        #include    <intrin.h>
+    #endif
+#endif
+
 /********************************* Defines ************************************/
 
 #define WEBS_TIMEOUT (ME_GOAHEAD_LIMIT_TIMEOUT * 1000)
 #define PARSE_TIMEOUT (ME_GOAHEAD_LIMIT_PARSE_TIMEOUT * 1000)
-#define CHUNK_LOW               128     /* Low water mark for chunking */
+#define TX_SEG_SIZE             (ME_GOAHEAD_LIMIT_BUFFER * 4)   /* Size of owned transmit segments */
+#define TX_IOVEC                32      /* Maximum segments per writev */
+#define ARENA_ALIGN(n)          (((n) + 7) & ~(ssize) 7)
+
+#define WEBS_HANDLE_BITS        20      /* Handle bits for the webs index. The rest hold the generation */
+#define WEBS_HANDLE_MASK        ((1 << WEBS_HANDLE_BITS) - 1)
+#define WEBS_GEN_MASK           0x7FF
 
 #define TOKEN_HEADER_KEY        0x1     /* Validate token as a header key */
 #define TOKEN_HEADER_VALUE      0x2     /* Validate token as a header value */
@@ -30,11 +47,16 @@ static int          websBackground;             /* Run as a daemon */
 static int          websDebug;                  /* Run in debug mode and defeat timeouts */
 static int          defaultHttpPort;            /* Default port number for http */
 static int          defaultSslPort;             /* Default port number for https */
-static int          listens[WEBS_MAX_LISTEN];   /* Listen endpoints */;
-static int          listenMax;                  /* Max entry in listens */
-static Webs         **webs;                     /* Open connection list head */
+static WEBS_THREAD_LOCAL int listens[WEBS_MAX_LISTEN];  /* Listen endpoints */;
+static WEBS_THREAD_LOCAL int listenMax;                 /* Max entry in listens */
+static WEBS_THREAD_LOCAL Webs **webs;                   /* Open connection list head */
 static WebsHash     websMime;                   /* Set of mime types */
-static int          websMax;                    /* List size */
+static WEBS_THREAD_LOCAL int websMax;                   /* List size */
+static WEBS_THREAD_LOCAL int *websGens;                 /* Generation of each webs slot */
+static WEBS_THREAD_LOCAL int websGenMax;                /* Size of websGens */
+static WEBS_THREAD_LOCAL Webs *websPool;                /* Idle request objects for reuse */
+static WEBS_THREAD_LOCAL WebsSeg *segPool;              /* Idle standard size transmit segments */
+static WEBS_THREAD_LOCAL WebsPoolStats poolStats;       /* Request pool statistics */
 static char         websHost[ME_MAX_IP];        /* Host name for the server */
 static char         websIpAddr[ME_MAX_IP];      /* IP address for the server */
 static char         *websHostUrl = NULL;        /* URL to access server */
@@ -183,45 +205,166 @@ static WebsError websErrors[] = {
     { 405, "Access Denied" },
     { 406, "Not Acceptable" },
     { 408, "Request Timeout" },
+    { 412, "Precondition Failed" },
     { 413, "Request too large" },
+    { 416, "Range Not Satisfiable" },
     { 500, "Internal Server Error" },
     { 501, "Not Implemented" },
     { 503, "Service Unavailable" },
     { 0, NULL }
 };
 
+/*
+    Status line suffixes for each websErrors[] entry (" 200 OK\r\n"). Built by websOpen.
+ */
+#define WEBS_NUM_ERRORS (sizeof(websErrors) / sizeof(WebsError))
+static char     *statusLines[WEBS_NUM_ERRORS];
+static ssize    statusLengths[WEBS_NUM_ERRORS];
+
+/*
+    Response header block under construction. Constant header lines are appended as byte slices and only dynamic
+    values are formatted.
+ */
+typedef struct HeaderBlock {
+    Webs        *wp;
+    ssize       len;
+    char        buf[ME_GOAHEAD_LIMIT_BUFFER * 2 + 1];
+} HeaderBlock;
+
+#define HEADER(s)       s, sizeof(s) - 1    /* Constant header slice */
+
+static WEBS_THREAD_LOCAL WebsTime dateTime;         /* Time of the cached date string */
+static WEBS_THREAD_LOCAL char dateString[32];       /* Cached date string for the Date header */
+
 #if ME_GOAHEAD_ACCESS_LOG && !ME_ROM
-static char     accessLog[64] = "access.log";       /* Log filename */
-static int      accessFd;                           /* Log file handle */
+#define LOG_COMMON      0                           /* NCSA common log format */
+#define LOG_COMBINED    1                           /* Common log format with referrer, user agent and latency */
+#define LOG_JSON        2                           /* One JSON object per request */
+
+#define LOG_BUFFER_SIZE max(ME_GOAHEAD_LIMIT_LOG_BUFFER, ME_GOAHEAD_LIMIT_HEADERS * 2)
+
+/*
+    Access log record under construction. Records are bounded so each is written whole.
+ */
+typedef struct LogRecord {
+    char        *buf;
+    ssize       len;
+    ssize       size;
+} LogRecord;
+
+static char     *accessLog;                         /* Log filename */
+static int      accessFd = -1;                      /* Log file handle */
+static int      accessFormat;                       /* Log format */
+static ssize    accessSize;                         /* Current log size */
+static ssize    accessMaxSize;                      /* Rotate above this size */
+static int      accessBackups;                      /* Rotated logs to keep */
+static int      accessConfigured;                   /* websSetAccessLog has been called */
+static volatile int accessReopen;                   /* Reopen requested (by a signal) */
+static WEBS_THREAD_LOCAL char *logBuf;              /* Buffered records of this event loop thread */
+static WEBS_THREAD_LOCAL ssize logLen;              /* Length of buffered records */
+static WEBS_THREAD_LOCAL int logEvent = -1;         /* Flush event */
+static WEBS_THREAD_LOCAL WebsTime logTime;          /* Time of the cached log dates */
+static WEBS_THREAD_LOCAL char logDate[40];          /* Cached common log format date */
+static WEBS_THREAD_LOCAL char logIsoDate[40];       /* Cached ISO 8601 date */
 #endif
 
 static WebsHash sessions = -1;
 static int      sessionCount = 0;
 static int      pruneId;                            /* Callback ID */
 
+static volatile int reloadPending;                  /* Reload requested (by a signal) */
+static cchar    *reloadRoute;                       /* Route file to reload */
+static cchar    *reloadAuth;                        /* Auth file to reload */
+
+#if ME_GOAHEAD_THREADS
+static int      websThreads = 1;                    /* Number of event loop threads */
+static pthread_t *reactors;                         /* Additional event loop threads */
+static char     *endpoints[WEBS_MAX_LISTEN];        /* Endpoints to listen on in every event loop thread */
+static int      endpointMax;
+static WEBS_THREAD_LOCAL int reactorThread;         /* Running in an additional event loop thread */
+static pthread_mutex_t sessionLock;                 /* Sessions are shared by all event loop threads */
+static pthread_mutex_t accessLock;                  /* Access log file shared by all event loop threads */
+#define lockSessions() pthread_mutex_lock(&sessionLock)
+#define unlockSessions() pthread_mutex_unlock(&sessionLock)
+#define lockAccessLog() pthread_mutex_lock(&accessLock)
+#define unlockAccessLog() pthread_mutex_unlock(&accessLock)
+#else
+#define lockSessions()
+#define unlockSessions()
+#define lockAccessLog()
+#define unlockAccessLog()
+#endif
+
 /**************************** Forward Declarations ****************************/
 
+static WebsSeg  *allocSeg(ssize size);
+static void     appendSeg(WebsSeg **head, WebsSeg **tail, WebsSeg *seg);
+static void     checkReload(void);
 static void     checkTimeout(void *arg, int id);
+static void     closeConnections(void);
+static void     consumeSegs(Webs *wp, ssize len);
 static bool     filterChunkData(Webs *wp);
+static int      frameChunk(Webs *wp);
+static void     flushHeaderBlock(HeaderBlock *hb);
+static char     *formatDate(char *buf, ssize size, WebsTime when);
+static void     freeSeg(WebsSeg *seg);
+static void     freeSegs(WebsSeg **head, WebsSeg **tail);
+static void     freePool(void);
+static void     freeWebs(Webs *wp);
+static cchar    *getDate(void);
 static int      getTimeSinceMark(Webs *wp);
 static char     *getToken(Webs *wp, char *delim, int validation);
 static void     parseFirstLine(Webs *wp);
-static void     parseHeaders(Webs *wp);
+static void     parseHeaders(Webs *wp, char *base, ssize len);
+static int      lookupHeader(cchar *key, ssize len);
+static int      lookupEnv(cchar *var);
+static cchar    *getEnvValue(Webs *wp, int index, char *buf, ssize bufsize);
+static cchar    *getEnvVar(Webs *wp, cchar *var);
+static WebsHash getVars(Webs *wp);
+static void     resetArena(Webs *wp, bool keep);
+static void     resetBuf(WebsBuf *bp);
+static WebsKey  *setVarRef(Webs *wp, cchar *var, cchar *value);
 static bool     processContent(Webs *wp);
 static bool     parseIncoming(Webs *wp);
+static void     putBytes(HeaderBlock *hb, cchar *data, ssize len);
+static void     putHeader(HeaderBlock *hb, cchar *key, ssize keyLen, cchar *value);
 static void     pruneSessions(void);
 static void     freeSession(WebsSession *sp);
 static void     freeSessions(void);
+static WebsSession *getSession(Webs *wp, int create);
+static void     releaseSession(WebsSession *sp);
+static void     removeSession(WebsSession *sp);
 static void     readEvent(Webs *wp);
 static void     reuseConn(Webs *wp);
+static void     serviceEvents(int *finished);
 static void     setFileLimits(void);
+static void     setWritable(Webs *wp, bool on);
+static int      drainQueue(Webs *wp, bool yield);
+static int      queueBlock(WebsSeg **head, WebsSeg **tail, cchar *buf, ssize size);
 static int      setLocalHost(void);
 static void     socketEvent(int sid, int mask, void *data);
 static void     writeEvent(Webs *wp);
+static ssize    writeSegs(Webs *wp);
 static char     *validateToken(char *token, char *endToken, int validation);
 
-#if ME_GOAHEAD_ACCESS_LOG
+#if ME_GOAHEAD_ACCESS_LOG && !ME_ROM
+static bool     checkAccessLog(void);
+static void     closeAccessLog(void);
+static void     flushLogEvent(void *data, int id);
+static void     freeLogBuffer(void);
+static cchar    *getLogTime(int format);
+static void     logPut(LogRecord *rp, cchar *str, ssize len);
+static void     logPutJson(LogRecord *rp, cchar *str);
+static void     logPutNum(LogRecord *rp, int64 value);
+static void     logPutStr(LogRecord *rp, cchar *str);
 static void     logRequest(Webs *wp, int code);
+static int      openAccessLog(bool truncate);
+static void     rotateAccessLog(void);
+#endif
+#if ME_GOAHEAD_THREADS
+static void     *reactorMain(void *arg);
+static int      startReactors(int *finished);
+static void     stopReactors(void);
 #endif
 
 /*********************************** Code *************************************/
@@ -229,6 +372,7 @@ static void     logRequest(Webs *wp, int code);
 PUBLIC int websOpen(cchar *documents, cchar *routeFile)
 {
     WebsMime    *mt;
+    int         i;
 
     webs = NULL;
     websMax = 0;
@@ -236,8 +380,8 @@ PUBLIC int websOpen(cchar *documents, cchar *routeFile)
     websOsOpen();
     websRuntimeOpen();
     websTimeOpen();
-    websFsOpen();
     logOpen();
+    websFsOpen();
     setFileLimits();
     socketOpen();
     if (setLocalHost() < 0) {
@@ -247,6 +391,16 @@ PUBLIC int websOpen(cchar *documents, cchar *routeFile)
     if (sslOpen() < 0) {
         return -1;
     }
+#endif
+#if ME_GOAHEAD_THREADS
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&sessionLock, &attr);
+    pthread_mutex_init(&accessLock, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
 #endif
     if ((sessions = hashCreate(-1)) < 0) {
         return -1;
@@ -288,14 +442,19 @@ PUBLIC int websOpen(cchar *documents, cchar *routeFile)
     for (mt = websMimeList; mt->type; mt++) {
         hashEnter(websMime, mt->ext, valueString(mt->type, 0), 0);
     }
+    for (i = 0; websErrors[i].code; i++) {
+        statusLines[i] = sfmt(" %d %s\r\n", websErrors[i].code, websErrors[i].msg);
+        statusLengths[i] = slen(statusLines[i]);
+    }
 
 #if ME_GOAHEAD_ACCESS_LOG && !ME_ROM
-    if ((accessFd = open(accessLog, O_CREAT | O_TRUNC | O_APPEND | O_WRONLY, 0666)) < 0) {
-        error("Cannot open access log %s", accessLog);
+    if (!accessConfigured && websSetAccessLog(0, ME_GOAHEAD_ACCESS_LOG_FORMAT, ME_GOAHEAD_ACCESS_LOG_SIZE,
+            ME_GOAHEAD_ACCESS_LOG_BACKUPS) < 0) {
+        return -1;
+    }
+    if (openAccessLog(1) < 0) {
         return -1;
     }
-    /* Some platforms don't implement O_APPEND (VXWORKS) */
-    lseek(accessFd, 0, SEEK_END);
 #endif
     return 0;
 }
@@ -303,7 +462,6 @@ PUBLIC int websOpen(cchar *documents, cchar *routeFile)
 
 PUBLIC void websClose(void)
 {
-    Webs    *wp;
     int     i;
 
     websCloseRoute();
@@ -317,6 +475,48 @@ PUBLIC void websClose(void)
     if (sessions >= 0) {
         freeSessions();
     }
+    closeConnections();
+#if ME_GOAHEAD_THREADS
+    for (i = 0; i < endpointMax; i++) {
+        wfree(endpoints[i]);
+        endpoints[i] = 0;
+    }
+    endpointMax = 0;
+#endif
+    wfree(websHostUrl);
+    wfree(websIpAddrUrl);
+    websIpAddrUrl = websHostUrl = NULL;
+    for (i = 0; websErrors[i].code; i++) {
+        wfree(statusLines[i]);
+        statusLines[i] = 0;
+    }
+
+#if ME_COM_SSL
+    sslClose();
+#endif
+#if ME_GOAHEAD_ACCESS_LOG && !ME_ROM
+    closeAccessLog();
+    wfree(accessLog);
+    accessLog = 0;
+#endif
+    websFsClose();
+    hashFree(websMime);
+    socketClose();
+    logClose();
+    websTimeClose();
+    websRuntimeClose();
+    websOsClose();
+}
+
+
+/*
+    Close the listeners and connections owned by the current event loop thread
+ */
+static void closeConnections(void)
+{
+    Webs    *wp;
+    int     i;
+
     for (i = 0; i < listenMax; i++) {
         if (listens[i] >= 0) {
             socketCloseConnection(listens[i]);
@@ -334,42 +534,38 @@ PUBLIC void websClose(void)
         }
         websFree(wp);
     }
-    wfree(websHostUrl);
-    wfree(websIpAddrUrl);
-    websIpAddrUrl = websHostUrl = NULL;
-
-#if ME_COM_SSL
-    sslClose();
-#endif
-#if ME_GOAHEAD_ACCESS_LOG
-    if (accessFd >= 0) {
-        close(accessFd);
-        accessFd = -1;
-    }
+    freePool();
+    websFreeFileCache();
+#if ME_GOAHEAD_ACCESS_LOG && !ME_ROM
+    freeLogBuffer();
 #endif
-    websFsClose();
-    hashFree(websMime);
-    socketClose();
-    logClose();
-    websTimeClose();
-    websRuntimeClose();
-    websOsClose();
+    wfree(websGens);
+    websGens = 0;
+    websGenMax = 0;
 }
 
 
+/*
+    Initialize a request. The receive and input buffers and the arena are retained from the prior use of the object,
+    if any. If reuse is set, the connection is also retained for the next keep-alive request.
+ */
 static void initWebs(Webs *wp, int flags, int reuse)
 {
-    WebsBuf     rxbuf;
+    WebsBuf     rxbuf, input;
+    WebsArena   *arena;
     WebsTime    timestamp;
     void        *ssl;
     char        ipaddr[ME_MAX_IP], ifaddr[ME_MAX_IP];
-    int         wid, sid, timeout, listenSid;
+    int         wid, sid, timeout, listenSid, handle;
 
     assert(wp);
 
+    rxbuf = wp->rxbuf;
+    input = wp->input;
+    arena = wp->arena;
     if (reuse) {
-        rxbuf = wp->rxbuf;
         wid = wp->wid;
+        handle = wp->handle;
         sid = wp->sid;
         timeout = wp->timeout;
         ssl = wp->ssl;
@@ -378,7 +574,7 @@ static void initWebs(Webs *wp, int flags, int reuse)
         scopy(ifaddr, sizeof(ifaddr), wp->ifaddr);
         timestamp = wp->timestamp;
     } else {
-        wid = sid = -1;
+        wid = sid = handle = -1;
         timeout = -1;
         ssl = 0;
         listenSid = -1;
@@ -387,13 +583,17 @@ static void initWebs(Webs *wp, int flags, int reuse)
     memset(wp, 0, sizeof(Webs));
     wp->flags = flags;
     wp->state = WEBS_BEGIN;
+    wp->arena = arena;
     wp->wid = wid;
+    wp->handle = handle;
     wp->sid = sid;
     wp->timeout = timeout;
     wp->docfd = -1;
     wp->txLen = -1;
+    wp->txHigh = ME_GOAHEAD_LIMIT_TX_HIGH;
+    wp->txLow = ME_GOAHEAD_LIMIT_TX_LOW;
     wp->rxLen = -1;
-    wp->responseCookies = hashCreate(7);
+    wp->responseCookies = -1;
     wp->code = HTTP_CODE_OK;
     wp->ssl = ssl;
     wp->listenSid = listenSid;
@@ -414,23 +614,27 @@ static void initWebs(Webs *wp, int flags, int reuse)
     } else {
         wp->timeout = -1;
     }
-    wp->vars = hashCreate(WEBS_HASH_INIT);
+    wp->vars = -1;
     /*
         Ring queues can never be totally full and are short one byte. Better to do even I/O and allocate
-        a little more memory than required. The chunkbuf has extra room to fit chunk headers and trailers.
+        a little more memory than required.
      */
     assert(ME_GOAHEAD_LIMIT_BUFFER >= 1024);
-    bufCreate(&wp->output, ME_GOAHEAD_LIMIT_BUFFER + 1, ME_GOAHEAD_LIMIT_BUFFER + 1);
-    bufCreate(&wp->chunkbuf, ME_GOAHEAD_LIMIT_BUFFER + 1, ME_GOAHEAD_LIMIT_BUFFER * 2);
-    bufCreate(&wp->input, ME_GOAHEAD_LIMIT_BUFFER + 1, ME_GOAHEAD_LIMIT_PUT + 1);
-    if (reuse) {
-        wp->rxbuf = rxbuf;
-    } else {
+    wp->input = input;
+    if (!wp->input.buf) {
+        bufCreate(&wp->input, ME_GOAHEAD_LIMIT_BUFFER + 1, ME_GOAHEAD_LIMIT_PUT + 1);
+    }
+    wp->rxbuf = rxbuf;
+    if (!wp->rxbuf.buf) {
         bufCreate(&wp->rxbuf, ME_GOAHEAD_LIMIT_HEADERS, ME_GOAHEAD_LIMIT_HEADERS + ME_GOAHEAD_LIMIT_PUT);
     }
 }
 
 
+/*
+    Release the request state. The buffers and one arena block are retained for the next request (see freeWebs).
+    If reuse is not set, the connection is closed and any pipelined input is discarded.
+ */
 static void termWebs(Webs *wp, int reuse)
 {
     assert(wp);
@@ -438,11 +642,18 @@ static void termWebs(Webs *wp, int reuse)
     /*
         Some of this is done elsewhere, but keep this here for when a shutdown is done and there are open connections.
      */
-    bufFree(&wp->input);
-    bufFree(&wp->output);
-    bufFree(&wp->chunkbuf);
+    if (wp->session) {
+        lockSessions();
+        releaseSession(wp->session);
+        unlockSessions();
+        wp->session = 0;
+    }
+    resetBuf(&wp->input);
+    freeSegs(&wp->txHead, &wp->txTail);
+    freeSegs(&wp->chunkHead, &wp->chunkTail);
+    wp->txQueued = wp->chunkQueued = 0;
     if (!reuse) {
-        bufFree(&wp->rxbuf);
+        resetBuf(&wp->rxbuf);
         if (wp->sid >= 0) {
 #if ME_COM_SSL
             sslFree(wp);
@@ -476,26 +687,13 @@ static void termWebs(Webs *wp, int reuse)
     if (wp->timeout >= 0 && !reuse) {
         websCancelTimeout(wp);
     }
-    wfree(wp->authDetails);
     wfree(wp->authResponse);
-    wfree(wp->authType);
-    wfree(wp->contentType);
-    wfree(wp->cookie);
-    wfree(wp->decodedQuery);
+    wfree(wp->rxHeaders);
     wfree(wp->digest);
-    wfree(wp->ext);
-    wfree(wp->filename);
-    wfree(wp->host);
-    wfree(wp->method);
     wfree(wp->password);
     wfree(wp->path);
-    wfree(wp->protoVersion);
     wfree(wp->putname);
-    wfree(wp->query);
     wfree(wp->realm);
-    wfree(wp->referrer);
-    wfree(wp->url);
-    wfree(wp->userAgent);
     wfree(wp->username);
 #if ME_GOAHEAD_UPLOAD
     wfree(wp->boundary);
@@ -518,21 +716,231 @@ static void termWebs(Webs *wp, int reuse)
         websFreeUpload(wp);
     }
 #endif
+    websReleaseRoutes(wp);
+    resetArena(wp, 1);
+}
+
+
+/*
+    Free a request object and the buffers retained by termWebs
+ */
+static void freeWebs(Webs *wp)
+{
+    if (wp->input.buf) {
+        bufFree(&wp->input);
+    }
+    if (wp->rxbuf.buf) {
+        bufFree(&wp->rxbuf);
+    }
+    resetArena(wp, 0);
+    wfree(wp);
+}
+
+
+/*
+    Empty a buffer for the next request. A buffer that has grown beyond its initial size is freed so idle objects
+    do not pin large buffers. It is recreated by initWebs.
+ */
+static void resetBuf(WebsBuf *bp)
+{
+    if (!bp->buf) {
+        return;
+    }
+    if (bp->buflen > bp->initlen) {
+        bufFree(bp);
+    } else {
+        bufFlush(bp);
+    }
+}
+
+
+/*
+    Free the idle request objects and transmit segments owned by the current event loop thread
+ */
+static void freePool(void)
+{
+    Webs        *wp;
+    WebsSeg     *seg;
+
+    while ((wp = websPool) != 0) {
+        websPool = wp->nextFree;
+        freeWebs(wp);
+    }
+    while ((seg = segPool) != 0) {
+        segPool = seg->next;
+        wfree(seg);
+    }
+    poolStats.idle = poolStats.segments = 0;
+}
+
+
+PUBLIC void websGetPoolStats(WebsPoolStats *stats)
+{
+    Webs    *wp;
+
+    assert(stats);
+
+    *stats = poolStats;
+    stats->max = ME_GOAHEAD_LIMIT_WEBS_POOL;
+    stats->largestBuffer = 0;
+    for (wp = websPool; wp; wp = wp->nextFree) {
+        if (wp->rxbuf.buf && wp->rxbuf.buflen > stats->largestBuffer) {
+            stats->largestBuffer = wp->rxbuf.buflen;
+        }
+        if (wp->input.buf && wp->input.buflen > stats->largestBuffer) {
+            stats->largestBuffer = wp->input.buflen;
+        }
+    }
+}
+
+
+/*
+    Free the arena blocks. If keep is set, one standard block is retained and rewound for the next request.
+ */
+static void resetArena(Webs *wp, bool keep)
+{
+    WebsArena   *ap, *next, *kept;
+
+    kept = 0;
+    for (ap = wp->arena; ap; ap = next) {
+        next = ap->next;
+        if (keep && !kept && ap->size == ME_GOAHEAD_LIMIT_ARENA) {
+            kept = ap;
+        } else {
+            wfree(ap);
+        }
+    }
+    if (kept) {
+        kept->next = 0;
+        kept->used = 0;
+    }
+    wp->arena = kept;
+}
+
+
+PUBLIC void *websArenaAlloc(Webs *wp, ssize size)
+{
+    WebsArena   *ap;
+    ssize       blockSize;
+    char        *ptr;
+
+    assert(wp);
+    assert(size >= 0);
+
+    size = ARENA_ALIGN(max(size, 1));
+    ap = wp->arena;
+    if (ap == 0 || (ap->size - ap->used) < size) {
+        if (size > ME_GOAHEAD_LIMIT_ARENA / 4 && ap) {
+            /*
+                Large request. Give it a dedicated block behind the current block so the current block remains in use.
+             */
+            if ((ap = walloc(sizeof(WebsArena) + size)) == 0) {
+                return 0;
+            }
+            ap->size = ap->used = size;
+            ap->next = wp->arena->next;
+            wp->arena->next = ap;
+            return (char*) ap + sizeof(WebsArena);
+        }
+        blockSize = max(size, ME_GOAHEAD_LIMIT_ARENA);
+        if ((ap = walloc(sizeof(WebsArena) + blockSize)) == 0) {
+            return 0;
+        }
+        ap->size = blockSize;
+        ap->used = 0;
+        ap->next = wp->arena;
+        wp->arena = ap;
+    }
+    ptr = (char*) ap + sizeof(WebsArena) + ap->used;
+    ap->used += size;
+    return ptr;
+}
+
+
+PUBLIC char *websArenaClone(Webs *wp, cchar *str)
+{
+    char    *ptr;
+    ssize   len;
+
+    if (str == 0) {
+        str = "";
+    }
+    len = slen(str);
+    if ((ptr = websArenaAlloc(wp, len + 1)) == 0) {
+        return 0;
+    }
+    memcpy(ptr, str, len + 1);
+    return ptr;
+}
+
+
+/*
+    Format into a stack buffer and copy into the arena. Larger results fall back to a temporary allocation.
+ */
+PUBLIC char *websArenaFmt(Webs *wp, cchar *format, ...)
+{
+    va_list     args, copy;
+    char        buf[ME_GOAHEAD_LIMIT_STRING], *result, *str;
+
+    assert(format);
+
+    va_start(args, format);
+    va_copy(copy, args);
+    fmtv(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (slen(buf) < (ssize) sizeof(buf) - 1) {
+        result = websArenaClone(wp, buf);
+    } else {
+        str = sfmtv(format, copy);
+        result = websArenaClone(wp, str);
+        wfree(str);
+    }
+    va_end(copy);
+    return result;
 }
 
 
 PUBLIC int websAlloc(int sid)
 {
     Webs    *wp;
-    int     wid;
+    int     wid, *gens, count;
 
-    if ((wid = wallocObject(&webs, &websMax, sizeof(Webs))) < 0) {
+    if ((wid = wallocHandle(&webs)) < 0) {
         return -1;
     }
-    wp = webs[wid];
-    assert(wp);
+    if (wid >= websGenMax) {
+        count = max(wid + 1, max(websGenMax * 2, 16));
+        if (wid > WEBS_HANDLE_MASK || (gens = wrealloc(websGens, count * sizeof(int))) == 0) {
+            websMax = wfreeHandle(&webs, wid);
+            return -1;
+        }
+        memset(&gens[websGenMax], 0, (count - websGenMax) * sizeof(int));
+        websGens = gens;
+        websGenMax = count;
+    }
+    if ((wp = websPool) != 0) {
+        websPool = wp->nextFree;
+        poolStats.idle--;
+        poolStats.hits++;
+    } else {
+        if ((wp = walloc(sizeof(Webs))) == 0) {
+            websMax = wfreeHandle(&webs, wid);
+            return -1;
+        }
+        memset(wp, 0, sizeof(Webs));
+        poolStats.misses++;
+    }
+    webs[wid] = wp;
+    if (wid >= websMax) {
+        websMax = wid + 1;
+    }
+    if (++poolStats.active > poolStats.activeHighWater) {
+        poolStats.activeHighWater = poolStats.active;
+    }
     initWebs(wp, 0, 0);
+    websGens[wid] = (websGens[wid] + 1) & WEBS_GEN_MASK;
     wp->wid = wid;
+    wp->handle = (websGens[wid] << WEBS_HANDLE_BITS) | wid;
     wp->sid = sid;
     wp->timestamp = time(0);
     return wid;
@@ -560,8 +968,18 @@ PUBLIC void websFree(Webs *wp)
 
     termWebs(wp, 0);
     websMax = wfreeHandle(&webs, wp->wid);
-    wfree(wp);
     assert(websMax >= 0);
+    wp->wid = -1;
+    poolStats.active--;
+    if (poolStats.idle < ME_GOAHEAD_LIMIT_WEBS_POOL) {
+        wp->nextFree = websPool;
+        websPool = wp;
+        if (++poolStats.idle > poolStats.idleHighWater) {
+            poolStats.idleHighWater = poolStats.idle;
+        }
+    } else {
+        freeWebs(wp);
+    }
 }
 
 
@@ -599,7 +1017,7 @@ PUBLIC void websDone(Webs *wp)
             socketCreateHandler(wp->sid, sp->handlerMask | SOCKET_WRITABLE, socketEvent, wp);
         }
     }
-#if ME_GOAHEAD_ACCESS_LOG
+#if ME_GOAHEAD_ACCESS_LOG && !ME_ROM
     logRequest(wp, wp->code);
 #endif
     if (!(wp->flags & WEBS_RESPONSE_TRACED)) {
@@ -631,7 +1049,7 @@ PUBLIC int websListen(cchar *endpoint)
 {
     WebsSocket  *sp;
     char        *ip, *ipaddr;
-    int         port, secure, sid;
+    int         flags, port, secure, sid;
 
     assert(endpoint && *endpoint);
 
@@ -640,8 +1058,15 @@ PUBLIC int websListen(cchar *endpoint)
         return -1;
     }
     socketParseAddress(endpoint, &ip, &port, &secure, 80);
-    if ((sid = socketListen(ip, port, websAccept, 0)) < 0) {
+    flags = 0;
+#if ME_GOAHEAD_THREADS
+    if (websThreads > 1) {
+        flags |= SOCKET_REUSE_PORT;
+    }
+#endif
+    if ((sid = socketListen(ip, port, websAccept, flags)) < 0) {
         error("Unable to open socket on port %d.", port);
+        wfree(ip);
         return -1;
     }
     sp = socketPtr(sid);
@@ -654,6 +1079,15 @@ PUBLIC int websListen(cchar *endpoint)
         defaultHttpPort = port;
     }
     listens[listenMax++] = sid;
+#if ME_GOAHEAD_THREADS
+    if (reactorThread) {
+        wfree(ip);
+        return sid;
+    }
+    if (endpointMax < WEBS_MAX_LISTEN) {
+        endpoints[endpointMax++] = sclone(endpoint);
+    }
+#endif
     if (ip) {
         ipaddr = smatch(ip, "::") ? "[::]" : ip;
     } else {
@@ -746,7 +1180,7 @@ PUBLIC int websAccept(int sid, cchar *ipaddr, int port, int listenSid)
     }
 #endif
     assert(wp->timeout == -1);
-    wp->timeout = websStartEvent(PARSE_TIMEOUT, checkTimeout, (void*) wp);
+    wp->timeout = websStartEvent(PARSE_TIMEOUT, checkTimeout, (void*) (ssize) wp->handle);
     socketEvent(sid, SOCKET_READABLE, wp);
     return 0;
 }
@@ -759,6 +1193,8 @@ PUBLIC int websAccept(int sid, cchar *ipaddr, int port, int listenSid)
 static void socketEvent(int sid, int mask, void *wptr)
 {
     Webs    *wp;
+    char    *servp;
+    ssize   len;
 
     wp = (Webs*) wptr;
     assert(wp);
@@ -767,15 +1203,32 @@ static void socketEvent(int sid, int mask, void *wptr)
     if (! websValid(wp)) {
         return;
     }
+    servp = wp->rxbuf.servp;
+    len = bufLen(&wp->rxbuf);
     if (mask & SOCKET_READABLE) {
         readEvent(wp);
     }
     if (mask & SOCKET_WRITABLE) {
         writeEvent(wp);
     }
+    /*
+        The handler is yielding to the event loop. Write output queued below the low watermark so small streamed
+        writes are not delayed until more output is generated.
+     */
+    if (wp->state == WEBS_RUNNING && (wp->txQueued > 0 || wp->chunkQueued > 0)) {
+        drainQueue(wp, 1);
+    }
     if (wp->flags & WEBS_CLOSED) {
         websFree(wp);
         /* WARNING: wp not valid here */
+        return;
+    }
+    /*
+        A pipelined request already in the rx buffer will not trigger a poll event, so requeue the socket. This is only
+        done if input was consumed or added, so a partial request waits for more data rather than spinning.
+     */
+    if (wp->state == WEBS_BEGIN && bufLen(&wp->rxbuf) > 0 && (wp->rxbuf.servp != servp || bufLen(&wp->rxbuf) != len)) {
+        socketReservice(sid);
     }
 }
 
@@ -889,21 +1342,38 @@ PUBLIC void websPump(Webs *wp)
 static bool parseIncoming(Webs *wp)
 {
     WebsBuf     *rxbuf;
-    char        *end, c;
+    char        *base, *end, c;
+    ssize       len, start;
 
     rxbuf = &wp->rxbuf;
-    while (*rxbuf->servp == '\r' || *rxbuf->servp == '\n') {
-        if (bufGetc(rxbuf) < 0) {
-            break;
+    if (wp->started == 0) {
+        wp->started = websGetMicroTicks();
+    }
+    if (wp->rxScanned == 0) {
+        while (*rxbuf->servp == '\r' || *rxbuf->servp == '\n') {
+            if (bufGetc(rxbuf) < 0) {
+                break;
+            }
         }
     }
-    if ((end = strstr((char*) wp->rxbuf.servp, "\r\n\r\n")) == 0) {
-        if (bufLen(&wp->rxbuf) >= ME_GOAHEAD_LIMIT_HEADER) {
+    /*
+        Resume scanning where the last read left off. Back up three bytes in case the terminator straddles reads.
+     */
+    len = bufLen(rxbuf);
+    start = max(wp->rxScanned - 3, 0);
+    if ((end = websFindHeaderEnd(&rxbuf->servp[start], len - start)) == 0) {
+        wp->rxScanned = len;
+        if (len >= ME_GOAHEAD_LIMIT_HEADER) {
             websError(wp, HTTP_CODE_REQUEST_TOO_LARGE | WEBS_CLOSE, "Header too large");
             return 1;
         }
         return 0;
     }
+    wp->rxScanned = 0;
+    if (memchr(rxbuf->servp, '\0', end - (char*) rxbuf->servp) != 0) {
+        websError(wp, HTTP_CODE_BAD_REQUEST | WEBS_CLOSE, "Bad header");
+        return 1;
+    }
     trace(3 | WEBS_RAW_MSG, "\n<<< Request\n");
     c = *end;
     *end = '\0';
@@ -913,11 +1383,12 @@ static bool parseIncoming(Webs *wp)
     /*
         Parse the first line of the Http header
      */
+    base = (char*) rxbuf->servp;
     parseFirstLine(wp);
     if (wp->state == WEBS_COMPLETE) {
         return 1;
     }
-    parseHeaders(wp);
+    parseHeaders(wp, base, end + 4 - base);
     if (wp->state == WEBS_COMPLETE) {
         return 1;
     }
@@ -957,6 +1428,99 @@ static bool parseIncoming(Webs *wp)
 }
 
 
+#if ME_GOAHEAD_SIMD
+/*
+    Return a 64-bit mask of the positions in the 64 byte block at cp that hold '\r' with a '\n' three bytes later
+ */
+static uint64 scanBlock(cchar *cp)
+{
+#if defined(__AVX2__)
+    __m256i     cr, lf, m0, m1;
+
+    cr = _mm256_set1_epi8('\r');
+    lf = _mm256_set1_epi8('\n');
+    m0 = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*) cp), cr),
+        _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*) (cp + 3)), lf));
+    m1 = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*) (cp + 32)), cr),
+        _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*) (cp + 35)), lf));
+    return (uint64) (uint) _mm256_movemask_epi8(m0) | ((uint64) (uint) _mm256_movemask_epi8(m1) << 32);
+#else
+    __m128i     cr, lf, m0, m1, m2, m3;
+
+    cr = _mm_set1_epi8('\r');
+    lf = _mm_set1_epi8('\n');
+    m0 = _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) cp), cr),
+        _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (cp + 3)), lf));
+    m1 = _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (cp + 16)), cr),
+        _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (cp + 19)), lf));
+    m2 = _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (cp + 32)), cr),
+        _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (cp + 35)), lf));
+    m3 = _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (cp + 48)), cr),
+        _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (cp + 51)), lf));
+    if (!_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(m0, m1), _mm_or_si128(m2, m3)))) {
+        return 0;
+    }
+    return (uint64) _mm_movemask_epi8(m0) | ((uint64) _mm_movemask_epi8(m1) << 16) |
+        ((uint64) _mm_movemask_epi8(m2) << 32) | ((uint64) _mm_movemask_epi8(m3) << 48);
+#endif
+}
+
+
+static int firstBit(uint64 mask)
+{
+#if defined(_MSC_VER)
+    unsigned long   index;
+
+    _BitScanForward64(&index, mask);
+    return (int) index;
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+#endif
+
+
+/*
+    Scan for CRLFCRLF. The vector scan compares 64 byte blocks against '\r' and the same block offset by three bytes
+    against '\n'. Only positions matching both are candidates and are confirmed with a scalar compare. Blocks without
+    candidates are skipped without touching individual bytes.
+ */
+PUBLIC char *websFindHeaderEnd(cchar *buf, ssize len)
+{
+    cchar   *cp, *end;
+
+    if (buf == 0 || len < 4) {
+        return 0;
+    }
+    cp = buf;
+    end = &buf[len - 3];
+
+#if ME_GOAHEAD_SIMD
+    for (; cp + 64 <= end; cp += 64) {
+        uint64  mask;
+        cchar   *p;
+
+        for (mask = scanBlock(cp); mask; mask &= mask - 1) {
+            p = &cp[firstBit(mask)];
+            if (p[1] == '\n' && p[2] == '\r') {
+                return (char*) p;
+            }
+        }
+    }
+#endif
+    /*
+        Scalar fallback and tail. memchr is itself vectorized by most C libraries.
+     */
+    while (cp < end && (cp = memchr(cp, '\r', end - cp)) != 0) {
+        if (cp[1] == '\n' && cp[2] == '\r' && cp[3] == '\n') {
+            return (char*) cp;
+        }
+        cp++;
+    }
+    return 0;
+}
+
+
 /*
     Parse the first line of a HTTP request
  */
@@ -976,7 +1540,7 @@ static void parseFirstLine(Webs *wp)
         websError(wp, HTTP_CODE_NOT_FOUND | WEBS_CLOSE, "Bad HTTP request");
         return;
     }
-    wp->method = supper(sclone(op));
+    wp->method = supper(websArenaClone(wp, op));
 
     url = getToken(wp, NULL, TOKEN_URI_VALUE);
     if (url == NULL || *url == '\0') {
@@ -1014,13 +1578,13 @@ static void parseFirstLine(Webs *wp)
         wfree(buf);
         return;
     }
-    wp->url = sclone(url);
+    wp->url = websArenaClone(wp, url);
     if ((ext = strrchr(wp->path, '.')) != NULL) {
-        wp->ext = sclone(slower(ext));
+        wp->ext = websArenaClone(wp, slower(ext));
     }
-    wp->filename = sfmt("%s%s", websGetDocuments(), wp->path);
-    wp->query = sclone(query);
-    wp->host = sclone(host);
+    wp->filename = websArenaFmt(wp, "%s%s", websGetDocuments(), wp->path);
+    wp->query = websArenaClone(wp, query);
+    wp->host = websArenaClone(wp, host);
     wp->protocol = wp->flags & WEBS_SECURE ? "https" : "http";
     if (smatch(protoVer, "HTTP/1.1")) {
         wp->flags |= WEBS_KEEP_ALIVE | WEBS_HTTP11;
@@ -1030,7 +1594,7 @@ static void parseFirstLine(Webs *wp)
         protoVer = "HTTP/1.1";
         websError(wp, WEBS_CLOSE | HTTP_CODE_NOT_ACCEPTABLE, "Unsupported HTTP protocol");
     }
-    wp->protoVersion = sclone(protoVer);
+    wp->protoVersion = websArenaClone(wp, protoVer);
     if ((listenPort = socketGetPort(wp->listenSid)) >= 0) {
         wp->port = listenPort;
     } else {
@@ -1043,19 +1607,63 @@ static void parseFirstLine(Webs *wp)
 /*
     Parse a full request
  */
-static void parseHeaders(Webs *wp)
+/*
+    Map a lower case header key to a known header index. Returns -1 if not a known header.
+ */
+static int lookupHeader(cchar *key, ssize len)
 {
-    cchar   *prior;
-    char    *combined, *upperKey, *cp, *key, *value, *tok;
-    int     count;
+    switch (len) {
+    case 4:
+        return memcmp(key, "host", 4) == 0 ? WEBS_HEADER_HOST : -1;
+    case 5:
+        return memcmp(key, "range", 5) == 0 ? WEBS_HEADER_RANGE : -1;
+    case 6:
+        return memcmp(key, "cookie", 6) == 0 ? WEBS_HEADER_COOKIE : -1;
+    case 7:
+        return memcmp(key, "referer", 7) == 0 ? WEBS_HEADER_REFERER : -1;
+    case 8:
+        return memcmp(key, "if-range", 8) == 0 ? WEBS_HEADER_IF_RANGE : -1;
+    case 10:
+        if (key[0] == 'c') {
+            return memcmp(key, "connection", 10) == 0 ? WEBS_HEADER_CONNECTION : -1;
+        }
+        return memcmp(key, "user-agent", 10) == 0 ? WEBS_HEADER_USER_AGENT : -1;
+    case 12:
+        return memcmp(key, "content-type", 12) == 0 ? WEBS_HEADER_CONTENT_TYPE : -1;
+    case 13:
+        if (key[0] == 'a') {
+            return memcmp(key, "authorization", 13) == 0 ? WEBS_HEADER_AUTHORIZATION : -1;
+        }
+        return memcmp(key, "if-none-match", 13) == 0 ? WEBS_HEADER_IF_NONE_MATCH : -1;
+    case 14:
+        return memcmp(key, "content-length", 14) == 0 ? WEBS_HEADER_CONTENT_LENGTH : -1;
+    case 15:
+        return memcmp(key, "accept-encoding", 15) == 0 ? WEBS_HEADER_ACCEPT_ENCODING : -1;
+    case 17:
+        if (key[0] == 'i') {
+            return memcmp(key, "if-modified-since", 17) == 0 ? WEBS_HEADER_IF_MODIFIED_SINCE : -1;
+        }
+        return memcmp(key, "transfer-encoding", 17) == 0 ? WEBS_HEADER_TRANSFER_ENCODING : -1;
+    }
+    return -1;
+}
+
+
+/*
+    Parse the request headers. Headers are tokenized in place and recorded as slices relative to base.
+    Known headers are recognized without string compares. Once parsed, the header block is copied to wp->rxHeaders
+    so the slices remain valid after rxbuf is reused for body data. HTTP_* variables are created on demand by
+    websSetHeaderVars.
+ */
+static void parseHeaders(Webs *wp, char *base, ssize len)
+{
+    WebsHeader  *hp;
+    char        *cp, *key, *value, *tok, date[64];
+    ssize       keyLen;
+    int         count, id;
 
     assert(websValid(wp));
 
-    /*
-        Parse the header and create the Http header keyword variables
-        We rewrite the header as we go for non-local requests.  NOTE: this
-        modifies the header string directly and tokenizes each line with '\0'.
-    */
     for (count = 0; wp->rxbuf.servp[0] != '\r'; count++) {
         if (count >= ME_GOAHEAD_LIMIT_NUM_HEADERS) {
             websError(wp, HTTP_CODE_REQUEST_TOO_LARGE | WEBS_CLOSE, "Too many headers");
@@ -1072,50 +1680,37 @@ static void parseHeaders(Webs *wp)
             return;
         }
         slower(key);
+        keyLen = slen(key);
 
-        /*
-            Create a header variable for each line in the header
-         */
-        upperKey = sfmt("HTTP_%s", key);
-        for (cp = upperKey; *cp; cp++) {
-            if (*cp == '-') {
-                *cp = '_';
-            }
-        }
-        supper(upperKey);
-        if ((prior = websGetVar(wp, upperKey, 0)) != 0) {
-            combined = sfmt("%s, %s", prior, value);
-            websSetVar(wp, upperKey, combined);
-            wfree(combined);
-        } else {
-            websSetVar(wp, upperKey, value);
-        }
-        wfree(upperKey);
+        hp = &wp->headers[count];
+        hp->key.offset = (int) (key - base);
+        hp->key.len = (int) keyLen;
+        hp->value.offset = (int) (value - base);
+        hp->value.len = (int) slen(value);
+        wp->headerCount = count + 1;
 
-        /*
-            Track the requesting agent (browser) type
-         */
-        if (strcmp(key, "user-agent") == 0) {
-            wfree(wp->userAgent);
-            wp->userAgent = sclone(value);
+        if ((id = lookupHeader(key, keyLen)) < 0) {
+            continue;
+        }
+        wp->known[id] = hp->value;
 
-        } else if (scaselesscmp(key, "authorization") == 0) {
-            wfree(wp->authType);
-            wp->authType = sclone(value);
+        switch (id) {
+        case WEBS_HEADER_AUTHORIZATION:
+            wp->authType = websArenaClone(wp, value);
             ssplit(wp->authType, " \t", &tok);
-            wfree(wp->authDetails);
-            wp->authDetails = sclone(tok);
+            wp->authDetails = websArenaClone(wp, tok);
             slower(wp->authType);
+            break;
 
-        } else if (strcmp(key, "connection") == 0) {
-            slower(value);
-            if (strcmp(value, "keep-alive") == 0) {
+        case WEBS_HEADER_CONNECTION:
+            if (scaselessmatch(value, "keep-alive")) {
                 wp->flags |= WEBS_KEEP_ALIVE;
-            } else if (strcmp(value, "close") == 0) {
+            } else if (scaselessmatch(value, "close")) {
                 wp->flags &= ~WEBS_KEEP_ALIVE;
             }
+            break;
 
-        } else if (strcmp(key, "content-length") == 0) {
+        case WEBS_HEADER_CONTENT_LENGTH:
             if ((wp->rxLen = atoi(value)) < 0) {
                 websError(wp, HTTP_CODE_REQUEST_TOO_LARGE | WEBS_CLOSE, "Invalid content length");
                 return;
@@ -1134,10 +1729,9 @@ static void parseHeaders(Webs *wp)
             if (!smatch(wp->method, "HEAD")) {
                 wp->rxRemaining = wp->rxLen;
             }
+            break;
 
-        } else if (strcmp(key, "content-type") == 0) {
-            wfree(wp->contentType);
-            wp->contentType = sclone(value);
+        case WEBS_HEADER_CONTENT_TYPE:
             if (strstr(value, "application/x-www-form-urlencoded")) {
                 wp->flags |= WEBS_FORM;
             } else if (strstr(value, "application/json")) {
@@ -1145,45 +1739,41 @@ static void parseHeaders(Webs *wp)
             } else if (strstr(value, "multipart/form-data")) {
                 wp->flags |= WEBS_UPLOAD;
             }
+            break;
 
-        } else if (strcmp(key, "cookie") == 0) {
+        case WEBS_HEADER_COOKIE:
             /* Should be only one cookie header really with semicolon delimmited key/value pairs */
             wp->flags |= WEBS_COOKIE;
             if (wp->cookie) {
-                char *prior = wp->cookie;
-                wp->cookie = sfmt("%s; %s", prior, value);
-                wfree(prior);
+                wp->cookie = websArenaFmt(wp, "%s; %s", wp->cookie, value);
             } else {
-                wp->cookie = sclone(value);
+                wp->cookie = websArenaClone(wp, value);
             }
+            break;
 
-        } else if (strcmp(key, "host") == 0) {
+        case WEBS_HEADER_HOST:
             if ((int) strspn(value, "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789_-.[]:")
                     < (int) slen(value)) {
                 websError(wp, WEBS_CLOSE | HTTP_CODE_BAD_REQUEST, "Bad host header");
                 return;
             }
-            wfree(wp->host);
-            wp->host = sclone(value);
+            wp->host = websArenaClone(wp, value);
+            break;
 
-        } else if (strcmp(key, "if-modified-since") == 0) {
-            if ((cp = strchr(value, ';')) != NULL) {
+        case WEBS_HEADER_IF_MODIFIED_SINCE:
+            scopy(date, sizeof(date), value);
+            if ((cp = strchr(date, ';')) != NULL) {
                 *cp = '\0';
             }
-            websParseDateTime(&wp->since, value, 0);
-
-        /*
-            Yes Veronica, the HTTP spec does misspell Referrer
-         */
-        } else if (strcmp(key, "referer") == 0) {
-            wfree(wp->referrer);
-            wp->referrer = sclone(value);
+            websParseDateTime(&wp->since, date, 0);
+            break;
 
-        } else if (strcmp(key, "transfer-encoding") == 0) {
+        case WEBS_HEADER_TRANSFER_ENCODING:
             if (scaselesscmp(value, "chunked") == 0) {
                 wp->rxChunkState = WEBS_CHUNK_START;
                 wp->rxRemaining = MAXINT;
             }
+            break;
         }
     }
     if (!wp->rxChunkState) {
@@ -1198,6 +1788,100 @@ static void parseHeaders(Webs *wp)
         wp->rxbuf.servp += 2;
     }
     wp->eof = (wp->rxRemaining == 0);
+
+    if ((wp->rxHeaders = walloc(len + 1)) == 0) {
+        websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR | WEBS_CLOSE, "Cannot allocate headers");
+        return;
+    }
+    memcpy(wp->rxHeaders, base, len);
+    wp->rxHeaders[len] = '\0';
+    wp->contentType = (char*) websGetKnownHeader(wp, WEBS_HEADER_CONTENT_TYPE);
+    wp->referrer = (char*) websGetKnownHeader(wp, WEBS_HEADER_REFERER);
+    wp->userAgent = (char*) websGetKnownHeader(wp, WEBS_HEADER_USER_AGENT);
+}
+
+
+PUBLIC cchar *websGetKnownHeader(Webs *wp, int id)
+{
+    assert(wp);
+
+    if (id < 0 || id >= WEBS_HEADER_MAX || wp->known[id].offset == 0 || !wp->rxHeaders) {
+        return 0;
+    }
+    return &wp->rxHeaders[wp->known[id].offset];
+}
+
+
+PUBLIC cchar *websGetMimeType(cchar *ext)
+{
+    WebsKey     *key;
+
+    if (ext && (key = hashLookup(websMime, ext)) != 0) {
+        return key->content.value.string;
+    }
+    return 0;
+}
+
+
+PUBLIC cchar *websGetHeader(Webs *wp, cchar *key)
+{
+    WebsHeader  *hp;
+    ssize       len;
+    int         i;
+
+    assert(wp);
+    assert(key);
+
+    if (!wp->rxHeaders || !key) {
+        return 0;
+    }
+    len = slen(key);
+    for (i = 0; i < wp->headerCount; i++) {
+        hp = &wp->headers[i];
+        if (hp->key.len == len && sncaselesscmp(&wp->rxHeaders[hp->key.offset], key, len) == 0) {
+            return &wp->rxHeaders[hp->value.offset];
+        }
+    }
+    return 0;
+}
+
+
+/*
+    Create a HTTP_* variable for each request header. Repeated headers are combined into a comma separated list.
+ */
+PUBLIC void websSetHeaderVars(Webs *wp)
+{
+    WebsHeader  *hp;
+    WebsKey     *sp;
+    char        *upperKey, *cp, *value;
+    int         i;
+
+    assert(wp);
+
+    if ((wp->flags & WEBS_HEADER_VARS) || !wp->rxHeaders) {
+        return;
+    }
+    wp->flags |= WEBS_HEADER_VARS;
+    getVars(wp);
+    for (i = 0; i < wp->headerCount; i++) {
+        hp = &wp->headers[i];
+        value = &wp->rxHeaders[hp->value.offset];
+        if ((upperKey = websArenaFmt(wp, "HTTP_%s", &wp->rxHeaders[hp->key.offset])) == 0) {
+            return;
+        }
+        for (cp = upperKey; *cp; cp++) {
+            if (*cp == '-') {
+                *cp = '_';
+            }
+        }
+        supper(upperKey);
+        if (wp->vars >= 0 && (sp = hashLookup(wp->vars, upperKey)) != 0 && sp->content.value.string) {
+            setVarRef(wp, upperKey, websArenaFmt(wp, "%s, %s", sp->content.value.string, value));
+        } else {
+            /* Header values live as long as the request */
+            setVarRef(wp, upperKey, value);
+        }
+    }
 }
 
 
@@ -1336,8 +2020,7 @@ static bool filterChunkData(Webs *wp)
             wp->rxRemaining = chunkSize;
             if (chunkSize == 0) {
 #if ME_GOAHEAD_LEGACY
-                wfree(wp->query);
-                wp->query = sclone(bufStart(&wp->input));
+                wp->query = websArenaClone(wp, bufStart(&wp->input));
 #endif
                 wp->eof = 1;
                 return 1;
@@ -1373,11 +2056,25 @@ static bool filterChunkData(Webs *wp)
  */
 PUBLIC void websServiceEvents(int *finished)
 {
-    int     delay, nextEvent;
-
     if (finished) {
         *finished = 0;
     }
+#if ME_GOAHEAD_THREADS
+    if (websThreads > 1 && !reactorThread) {
+        startReactors(finished);
+        serviceEvents(finished);
+        stopReactors();
+        return;
+    }
+#endif
+    serviceEvents(finished);
+}
+
+
+static void serviceEvents(int *finished)
+{
+    int     delay, nextEvent;
+
     delay = 0;
     while (!finished || !*finished) {
         if (socketSelect(-1, delay)) {
@@ -1390,7 +2087,180 @@ PUBLIC void websServiceEvents(int *finished)
 #endif
         nextEvent = websRunEvents();
         delay = min(delay, nextEvent);
+        if (reloadPending) {
+            checkReload();
+        }
+#if ME_GOAHEAD_THREADS
+        if (websThreads > 1) {
+            /* Wake periodically so every thread notices *finished */
+            delay = min(delay, 1000);
+        }
+#endif
+    }
+}
+
+
+PUBLIC void websScheduleReload(cchar *routeFile, cchar *authFile)
+{
+    reloadRoute = routeFile;
+    reloadAuth = authFile;
+    reloadPending = 1;
+}
+
+
+/*
+    Reload the configuration between requests. Only the main event loop thread does this. Other threads continue to
+    service requests and pick up the new routes when it is swapped in.
+ */
+static void checkReload(void)
+{
+#if ME_GOAHEAD_THREADS
+    if (reactorThread) {
+        return;
+    }
+#endif
+    reloadPending = 0;
+    if (websReload(reloadRoute, reloadAuth) < 0) {
+        error("Cannot reload configuration, continuing with the current configuration");
+    } else {
+        logmsg(1, "Reloaded configuration");
+    }
+}
+
+
+/*
+    Stop accepting new connections and let in-progress requests complete. Used when a server process is retiring.
+ */
+PUBLIC int websShutdown(int timeout)
+{
+    Webs        *wp;
+    WebsTime    deadline;
+    int         i, count, delay, nextEvent;
+
+    for (i = 0; i < listenMax; i++) {
+        if (listens[i] >= 0) {
+            socketCloseConnection(listens[i]);
+            listens[i] = -1;
+        }
+    }
+    listenMax = 0;
+    deadline = time(0) + (timeout + 999) / 1000;
+    delay = 0;
+    do {
+        count = 0;
+        for (i = websMax - 1; webs && i >= 0; i--) {
+            if ((wp = webs[i]) == NULL) {
+                continue;
+            }
+            if (wp->state == WEBS_BEGIN && bufLen(&wp->rxbuf) == 0) {
+                if (wp->sid >= 0) {
+                    socketCloseConnection(wp->sid);
+                    wp->sid = -1;
+                }
+                websFree(wp);
+                continue;
+            }
+            wp->flags &= ~WEBS_KEEP_ALIVE;
+            count++;
+        }
+        if (count == 0 || time(0) >= deadline) {
+            break;
+        }
+        if (socketSelect(-1, delay)) {
+            socketProcess();
+        }
+#if ME_GOAHEAD_CGI
+        delay = websCgiPoll();
+#else
+        delay = MAXINT;
+#endif
+        nextEvent = websRunEvents();
+        delay = min(delay, nextEvent);
+        delay = min(delay, 100);
+    } while (1);
+    if (count) {
+        trace(2, "Shutdown with %d connections still open", count);
+    }
+    return count;
+}
+
+
+#if ME_GOAHEAD_THREADS
+/*
+    Start the additional event loop threads. The calling thread services events as the first event loop.
+ */
+static int startReactors(int *finished)
+{
+    int     i;
+
+    if ((reactors = walloc(sizeof(pthread_t) * (websThreads - 1))) == 0) {
+        websThreads = 1;
+        return -1;
+    }
+    for (i = 0; i < websThreads - 1; i++) {
+        if (pthread_create(&reactors[i], NULL, reactorMain, finished) != 0) {
+            error("Cannot create event loop thread, errno %d", errno);
+            websThreads = i + 1;
+            break;
+        }
+    }
+    logmsg(2, "Running %d event loop threads", websThreads);
+    return 0;
+}
+
+
+static void stopReactors(void)
+{
+    int     i;
+
+    for (i = 0; i < websThreads - 1; i++) {
+        pthread_join(reactors[i], NULL);
     }
+    wfree(reactors);
+    reactors = 0;
+}
+
+
+/*
+    Event loop thread. Each thread has its own socket list, poller, connections and timers, and its own
+    SO_REUSEPORT listeners so the kernel distributes new connections across threads.
+ */
+static void *reactorMain(void *arg)
+{
+    int     *finished, i;
+
+    finished = (int*) arg;
+    reactorThread = 1;
+    if (socketOpen() < 0) {
+        return NULL;
+    }
+    for (i = 0; i < endpointMax; i++) {
+        if (websListen(endpoints[i]) < 0) {
+            break;
+        }
+    }
+    if (i == endpointMax) {
+        serviceEvents(finished);
+    }
+    closeConnections();
+    socketClose();
+    return NULL;
+}
+#endif
+
+
+PUBLIC int websSetThreads(int count)
+{
+#if ME_GOAHEAD_THREADS
+    websThreads = max(count, 1);
+    return 0;
+#else
+    if (count > 1) {
+        error("Multiple event loop threads require ME_GOAHEAD_THREADS");
+        return -1;
+    }
+    return 0;
+#endif
 }
 
 
@@ -1419,13 +2289,15 @@ static void addFormVars(Webs *wp, char *vars)
             /*
                 If keyword has already been set, append the new value to what has been stored.
              */
-            if ((prior = websGetVar(wp, keyword, NULL)) != 0) {
-                sp = websSetVarFmt(wp, keyword, "%s %s", prior, value);
+            if (wp->vars >= 0 && (sp = hashLookup(wp->vars, keyword)) != 0 && (prior = sp->content.value.string) != 0) {
+                sp = setVarRef(wp, keyword, websArenaFmt(wp, "%s %s", prior, value));
             } else {
-                sp = websSetVar(wp, keyword, value);
+                sp = setVarRef(wp, keyword, value);
             }
             /* Flag as untrusted keyword by setting arg to 1. This is used by CGI to prefix this keyword */
-            sp->arg = 1;
+            if (sp) {
+                sp->arg = 1;
+            }
         }
         keyword = stok(NULL, "&", &tok);
     }
@@ -1433,37 +2305,200 @@ static void addFormVars(Webs *wp, char *vars)
 
 
 /*
-    Set the variable (CGI) environment for this request. Create variables for all standard CGI variables. Also decode
-    the query string and create a variable for each name=value pair.
+    Built-in CGI variables. These resolve on lookup from the request fields and are only entered into wp->vars
+    by websSetEnv. Sorted for binary search.
+ */
+static cchar *envVars[] = {
+    "AUTH_TYPE",
+    "CONTENT_LENGTH",
+    "CONTENT_TYPE",
+    "DOCUMENT_ROOT",
+    "GATEWAY_INTERFACE",
+    "PATH_INFO",
+    "PATH_TRANSLATED",
+    "QUERY_STRING",
+    "REMOTE_ADDR",
+    "REMOTE_HOST",
+    "REMOTE_USER",
+    "REQUEST_METHOD",
+    "REQUEST_TRANSPORT",
+    "REQUEST_URI",
+    "SERVER_ADDR",
+    "SERVER_HOST",
+    "SERVER_NAME",
+    "SERVER_PORT",
+    "SERVER_PROTOCOL",
+    "SERVER_SOFTWARE",
+    "SERVER_URL",
+};
+
+#define ENV_AUTH_TYPE           0
+#define ENV_CONTENT_LENGTH      1
+#define ENV_CONTENT_TYPE        2
+#define ENV_DOCUMENT_ROOT       3
+#define ENV_GATEWAY_INTERFACE   4
+#define ENV_PATH_INFO           5
+#define ENV_PATH_TRANSLATED     6
+#define ENV_QUERY_STRING        7
+#define ENV_REMOTE_ADDR         8
+#define ENV_REMOTE_HOST         9
+#define ENV_REMOTE_USER         10
+#define ENV_REQUEST_METHOD      11
+#define ENV_REQUEST_TRANSPORT   12
+#define ENV_REQUEST_URI         13
+#define ENV_SERVER_ADDR         14
+#define ENV_SERVER_HOST         15
+#define ENV_SERVER_NAME         16
+#define ENV_SERVER_PORT         17
+#define ENV_SERVER_PROTOCOL     18
+#define ENV_SERVER_SOFTWARE     19
+#define ENV_SERVER_URL          20
+#define ENV_MAX                 21
+
+
+static int lookupEnv(cchar *var)
+{
+    int     low, high, mid, rc;
+
+    if (var[0] < 'A' || var[0] > 'S') {
+        return -1;
+    }
+    for (low = 0, high = ENV_MAX - 1; low <= high; ) {
+        mid = (low + high) / 2;
+        if ((rc = strcmp(var, envVars[mid])) == 0) {
+            return mid;
+        } else if (rc < 0) {
+            high = mid - 1;
+        } else {
+            low = mid + 1;
+        }
+    }
+    return -1;
+}
+
+
+/*
+    Get the value of a built-in variable. Formatted values are written to buf.
+    Returns null if the variable does not apply to this request.
+ */
+static cchar *getEnvValue(Webs *wp, int index, char *buf, ssize bufsize)
+{
+    cchar   *value;
+
+    switch (index) {
+    case ENV_AUTH_TYPE:
+        value = wp->authType;
+        break;
+    case ENV_CONTENT_LENGTH:
+        fmt(buf, bufsize, "%d", wp->rxLen);
+        return buf;
+    case ENV_CONTENT_TYPE:
+        value = wp->contentType;
+        break;
+    case ENV_DOCUMENT_ROOT:
+        return (wp->route && wp->route->dir) ? wp->route->dir : 0;
+    case ENV_GATEWAY_INTERFACE:
+        return "CGI/1.1";
+    case ENV_PATH_INFO:
+    case ENV_REQUEST_URI:
+        value = wp->path;
+        break;
+    case ENV_PATH_TRANSLATED:
+        value = wp->filename;
+        break;
+    case ENV_QUERY_STRING:
+        value = wp->query;
+        break;
+    case ENV_REMOTE_ADDR:
+    case ENV_REMOTE_HOST:
+        return wp->ipaddr;
+    case ENV_REMOTE_USER:
+        value = wp->username;
+        break;
+    case ENV_REQUEST_METHOD:
+        value = wp->method;
+        break;
+    case ENV_REQUEST_TRANSPORT:
+        value = wp->protocol;
+        break;
+    case ENV_SERVER_ADDR:
+        return wp->ifaddr;
+    case ENV_SERVER_HOST:
+    case ENV_SERVER_NAME:
+        return websHost;
+    case ENV_SERVER_PORT:
+        fmt(buf, bufsize, "%d", wp->port);
+        return buf;
+    case ENV_SERVER_PROTOCOL:
+        value = wp->protoVersion;
+        break;
+    case ENV_SERVER_SOFTWARE:
+        fmt(buf, bufsize, "GoAhead/%s", ME_VERSION);
+        return buf;
+    case ENV_SERVER_URL:
+        value = websHostUrl;
+        break;
+    default:
+        return 0;
+    }
+    return value ? value : "";
+}
+
+
+/*
+    Resolve a built-in variable that has not been entered into wp->vars. Formatted values are cached in wp->vars so
+    the returned reference remains valid for the request.
+ */
+static cchar *getEnvVar(Webs *wp, cchar *var)
+{
+    WebsKey     *sp;
+    cchar       *value;
+    char        buf[64];
+    int         index;
+
+    if ((index = lookupEnv(var)) < 0 || (value = getEnvValue(wp, index, buf, sizeof(buf))) == 0) {
+        return 0;
+    }
+    if (value == buf) {
+        if ((sp = websSetVar(wp, var, buf)) == 0) {
+            return 0;
+        }
+        return sp->content.value.string;
+    }
+    return value;
+}
+
+
+/*
+    Get the request variable hash. This is created on the first write.
+ */
+static WebsHash getVars(Webs *wp)
+{
+    if (wp->vars < 0) {
+        wp->vars = hashCreate(WEBS_HASH_INIT);
+    }
+    return wp->vars;
+}
+
+
+/*
+    Enter the built-in CGI variables into wp->vars. This is only required when wp->vars is used directly, such as when
+    creating a CGI environment. websGetVar resolves these variables without this.
  */
 PUBLIC void websSetEnv(Webs *wp)
 {
+    cchar   *value;
+    char    buf[64];
+    int     i;
+
     assert(wp);
     assert(websValid(wp));
 
-    websSetVar(wp, "AUTH_TYPE", wp->authType);
-    websSetVarFmt(wp, "CONTENT_LENGTH", "%d", wp->rxLen);
-    websSetVar(wp, "CONTENT_TYPE", wp->contentType);
-    if (wp->route && wp->route->dir) {
-        websSetVar(wp, "DOCUMENT_ROOT", wp->route->dir);
+    for (i = 0; i < ENV_MAX; i++) {
+        if ((value = getEnvValue(wp, i, buf, sizeof(buf))) != 0) {
+            websSetVar(wp, envVars[i], value);
+        }
     }
-    websSetVar(wp, "GATEWAY_INTERFACE", "CGI/1.1");
-    websSetVar(wp, "PATH_INFO", wp->path);
-    websSetVar(wp, "PATH_TRANSLATED", wp->filename);
-    websSetVar(wp, "QUERY_STRING", wp->query);
-    websSetVar(wp, "REMOTE_ADDR", wp->ipaddr);
-    websSetVar(wp, "REMOTE_USER", wp->username);
-    websSetVar(wp, "REMOTE_HOST", wp->ipaddr);
-    websSetVar(wp, "REQUEST_METHOD", wp->method);
-    websSetVar(wp, "REQUEST_TRANSPORT", wp->protocol);
-    websSetVar(wp, "REQUEST_URI", wp->path);
-    websSetVar(wp, "SERVER_ADDR", wp->ifaddr);
-    websSetVar(wp, "SERVER_HOST", websHost);
-    websSetVar(wp, "SERVER_NAME", websHost);
-    websSetVarFmt(wp, "SERVER_PORT", "%d", wp->port);
-    websSetVar(wp, "SERVER_PROTOCOL", wp->protoVersion);
-    websSetVar(wp, "SERVER_URL", websHostUrl);
-    websSetVarFmt(wp, "SERVER_SOFTWARE", "GoAhead/%s", ME_VERSION);
 }
 
 
@@ -1473,9 +2508,9 @@ PUBLIC void websSetFormVars(Webs *wp)
 
     if (wp->rxLen > 0 && bufLen(&wp->input) > 0) {
         if (wp->flags & WEBS_FORM) {
-            data = sclone(wp->input.servp);
-            addFormVars(wp, data);
-            wfree(data);
+            if ((data = websArenaClone(wp, wp->input.servp)) != 0) {
+                addFormVars(wp, data);
+            }
         }
     }
 }
@@ -1488,9 +2523,9 @@ PUBLIC void websSetQueryVars(Webs *wp)
         split pairs at the '='.  Note: we rely on wp->decodedQuery preserving the decoded values in the symbol table.
      */
     if (wp->query && *wp->query) {
-        wfree(wp->decodedQuery);
-        wp->decodedQuery = sclone(wp->query);
-        addFormVars(wp, wp->decodedQuery);
+        if ((wp->decodedQuery = websArenaClone(wp, wp->query)) != 0) {
+            addFormVars(wp, wp->decodedQuery);
+        }
     }
 }
 
@@ -1515,6 +2550,10 @@ PUBLIC WebsKey *websSetVarFmt(Webs *wp, cchar *var, cchar *fmt, ...)
     } else {
         v = valueString("", 0);
     }
+    if (getVars(wp) < 0) {
+        valueFree(&v);
+        return 0;
+    }
     return hashEnter(wp->vars, var, v, 0);
 }
 
@@ -1526,6 +2565,9 @@ PUBLIC WebsKey *websSetVar(Webs *wp, cchar *var, cchar *value)
     assert(websValid(wp));
     assert(var && *var);
 
+    if (getVars(wp) < 0) {
+        return 0;
+    }
     if (value) {
         v = valueString(value, VALUE_ALLOCATE);
     } else {
@@ -1535,6 +2577,27 @@ PUBLIC WebsKey *websSetVar(Webs *wp, cchar *var, cchar *value)
 }
 
 
+PUBLIC WebsKey *websSetArenaVar(Webs *wp, cchar *var, cchar *value)
+{
+    assert(websValid(wp));
+    assert(var && *var);
+
+    return setVarRef(wp, var, websArenaClone(wp, value));
+}
+
+
+/*
+    Define a variable referencing a value that lives as long as the request. The value is not copied or freed.
+ */
+static WebsKey *setVarRef(Webs *wp, cchar *var, cchar *value)
+{
+    if (getVars(wp) < 0) {
+        return 0;
+    }
+    return hashEnter(wp->vars, var, valueString(value ? value : "", 0), 0);
+}
+
+
 /*
     Return TRUE if a webs variable exists for this connection.
  */
@@ -1548,10 +2611,13 @@ PUBLIC bool websTestVar(Webs *wp, cchar *var)
     if (var == NULL || *var == '\0') {
         return 0;
     }
-    if ((sp = hashLookup(wp->vars, var)) == NULL) {
-        return 0;
+    if (var[0] == 'H' && !(wp->flags & WEBS_HEADER_VARS) && sstarts(var, "HTTP_")) {
+        websSetHeaderVars(wp);
     }
-    return 1;
+    if (wp->vars >= 0 && (sp = hashLookup(wp->vars, var)) != NULL) {
+        return 1;
+    }
+    return getEnvVar(wp, var) != 0;
 }
 
 
@@ -1562,11 +2628,15 @@ PUBLIC bool websTestVar(Webs *wp, cchar *var)
 PUBLIC cchar *websGetVar(Webs *wp, cchar *var, cchar *defaultGetValue)
 {
     WebsKey   *sp;
+    cchar     *value;
 
     assert(websValid(wp));
     assert(var && *var);
 
-    if ((sp = hashLookup(wp->vars, var)) != NULL) {
+    if (var[0] == 'H' && !(wp->flags & WEBS_HEADER_VARS) && sstarts(var, "HTTP_")) {
+        websSetHeaderVars(wp);
+    }
+    if (wp->vars >= 0 && (sp = hashLookup(wp->vars, var)) != NULL) {
         assert(sp->content.type == string);
         if (sp->content.value.string) {
             return sp->content.value.string;
@@ -1574,6 +2644,9 @@ PUBLIC cchar *websGetVar(Webs *wp, cchar *var, cchar *defaultGetValue)
             return "";
         }
     }
+    if ((value = getEnvVar(wp, var)) != 0) {
+        return value;
+    }
     return defaultGetValue;
 }
 
@@ -1804,6 +2877,7 @@ PUBLIC char *websEscapeHtml(cchar *html)
 PUBLIC int websWriteHeader(Webs *wp, cchar *key, cchar *fmt, ...)
 {
     va_list     vargs;
+    cchar       *value;
     char        *buf;
 
     assert(websValid(wp));
@@ -1823,13 +2897,22 @@ PUBLIC int websWriteHeader(Webs *wp, cchar *key, cchar *fmt, ...)
     }
     if (fmt) {
         va_start(vargs, fmt);
-        if ((buf = sfmtv(fmt, vargs)) == 0) {
+        if (fmt[0] == '%' && fmt[1] == 's' && fmt[2] == '\0') {
+            /* Plain string values do not need the formatter */
+            value = va_arg(vargs, cchar*);
+            buf = 0;
+        } else if ((value = buf = sfmtv(fmt, vargs)) == 0) {
+            va_end(vargs);
             error("websWrite lost data, buffer overflow");
             return -1;
         }
         va_end(vargs);
-        trace(3 | WEBS_RAW_MSG, "%s", buf);
-        if (websWriteBlock(wp, buf, strlen(buf)) < 0) {
+        if (value == 0) {
+            value = "null";
+        }
+        trace(3 | WEBS_RAW_MSG, "%s", value);
+        if (websWriteBlock(wp, value, strlen(value)) < 0) {
+            wfree(buf);
             return -1;
         }
         wfree(buf);
@@ -1857,69 +2940,134 @@ PUBLIC void websSetStatus(Webs *wp, int code)
  */
 PUBLIC void websWriteHeaders(Webs *wp, ssize length, cchar *location)
 {
+    HeaderBlock hb;
     WebsKey     *cookie, *key, *next;
-    char        *date, *protoVersion;
+    char        *protoVersion, *line, num[32];
+    int         code, i;
 
     assert(websValid(wp));
 
     if (!(wp->flags & WEBS_HEADERS_CREATED)) {
+        if (!(wp->flags & WEBS_RESPONSE_TRACED)) {
+            wp->flags |= WEBS_RESPONSE_TRACED;
+            trace(3 | WEBS_RAW_MSG, "\n>>> Response\n");
+        }
+        hb.wp = wp;
+        hb.len = 0;
         protoVersion = wp->protoVersion;
         if (!protoVersion) {
             protoVersion = "HTTP/1.0";
             wp->flags &= ~WEBS_KEEP_ALIVE;
         }
-        websWriteHeader(wp, NULL, "%s %d %s", protoVersion, wp->code, websErrorMsg(wp->code));
+        putBytes(&hb, protoVersion, slen(protoVersion));
+        code = wp->code;
+        for (i = 0; websErrors[i].code && websErrors[i].code != code; i++) ;
+        if (websErrors[i].code && statusLines[i]) {
+            putBytes(&hb, statusLines[i], statusLengths[i]);
+        } else {
+            line = sfmt(" %d %s\r\n", code, websErrorMsg(code));
+            putBytes(&hb, line, slen(line));
+            wfree(line);
+        }
 #if !ME_GOAHEAD_STEALTH
-        websWriteHeader(wp, "Server", "GoAhead-http");
+        putBytes(&hb, HEADER("Server: GoAhead-http\r\n"));
 #endif
-        if ((date = websGetDateString(NULL)) != NULL) {
-            websWriteHeader(wp, "Date", "%s", date);
-            wfree(date);
-        }
+        putHeader(&hb, HEADER("Date: "), getDate());
         if (wp->authResponse) {
-            websWriteHeader(wp, "WWW-Authenticate", "%s", wp->authResponse);
+            putHeader(&hb, HEADER("WWW-Authenticate: "), wp->authResponse);
         }
-        if (length >= 0) {
+        if (length >= 0 && !(wp->flags & WEBS_DOC_HEADERS)) {
             if (smatch(wp->method, "HEAD")) {
-                websWriteHeader(wp, "Content-Length", "%d", (int) length);
-            } else if (!((100 <= wp->code && wp->code <= 199) || wp->code == 204 || wp->code == 304)) {
+                putHeader(&hb, HEADER("Content-Length: "), itosbuf(num, sizeof(num), (int) length, 10));
+            } else if (!((100 <= code && code <= 199) || code == 204 || code == 304)) {
                 /* Server must not emit a content length header for 1XX, 204 and 304 status */
-                websWriteHeader(wp, "Content-Length", "%d", (int) length);
+                putHeader(&hb, HEADER("Content-Length: "), itosbuf(num, sizeof(num), (int) length, 10));
             }
         }
         wp->txLen = length;
         if (wp->txLen < 0) {
-            websWriteHeader(wp, "Transfer-Encoding", "chunked");
+            putBytes(&hb, HEADER("Transfer-Encoding: chunked\r\n"));
         }
         if (wp->flags & WEBS_KEEP_ALIVE) {
-            websWriteHeader(wp, "Connection", "keep-alive");
+            putBytes(&hb, HEADER("Connection: keep-alive\r\n"));
         } else {
-            websWriteHeader(wp, "Connection", "close");
+            putBytes(&hb, HEADER("Connection: close\r\n"));
         }
         if (location) {
-            websWriteHeader(wp, "Location", "%s", location);
-        } else if ((key = hashLookup(websMime, wp->ext)) != 0) {
-            websWriteHeader(wp, "Content-Type", "%s", key->content.value.string);
+            putHeader(&hb, HEADER("Location: "), location);
+        } else if (wp->rangeBoundary) {
+            putHeader(&hb, HEADER("Content-Type: multipart/byteranges; boundary="), wp->rangeBoundary);
+        } else if (!(wp->flags & WEBS_DOC_HEADERS) && (key = hashLookup(websMime, wp->ext)) != 0) {
+            putHeader(&hb, HEADER("Content-Type: "), key->content.value.string);
         }
-        for (cookie = hashFirst(wp->responseCookies); cookie; cookie = next) {
-            websWriteHeader(wp, "Set-Cookie", "%s", cookie->content.value.string);
-            websWriteHeader(wp, "Cache-Control", "%s", "no-cache=\"set-cookie\"");
+        if (wp->contentEncoding) {
+            putHeader(&hb, HEADER("Content-Encoding: "), wp->contentEncoding);
+        }
+        if (wp->flags & WEBS_VARY_ENCODING) {
+            putBytes(&hb, HEADER("Vary: Accept-Encoding\r\n"));
+        }
+        for (cookie = wp->responseCookies >= 0 ? hashFirst(wp->responseCookies) : 0; cookie; cookie = next) {
+            putHeader(&hb, HEADER("Set-Cookie: "), cookie->content.value.string);
+            putBytes(&hb, HEADER("Cache-Control: no-cache=\"set-cookie\"\r\n"));
             next = hashNext(wp->responseCookies, cookie);
         }
 #if defined(ME_GOAHEAD_CLIENT_CACHE)
         if (wp->ext) {
             char *etok = sfmt("%s,", &wp->ext[1]);
             if (strstr(ME_GOAHEAD_CLIENT_CACHE ",", etok)) {
-                websWriteHeader(wp, "Cache-Control", "public, max-age=%d", ME_GOAHEAD_CLIENT_CACHE_LIFESPAN);
+                putHeader(&hb, HEADER("Cache-Control: public, max-age="),
+                    itosbuf(num, sizeof(num), ME_GOAHEAD_CLIENT_CACHE_LIFESPAN, 10));
             }
             wfree(etok);
         }
 #endif
 #ifdef ME_GOAHEAD_XFRAME_HEADER
         if (*ME_GOAHEAD_XFRAME_HEADER) {
-            websWriteHeader(wp, "X-Frame-Options", "%s", ME_GOAHEAD_XFRAME_HEADER);
+            putBytes(&hb, HEADER("X-Frame-Options: " ME_GOAHEAD_XFRAME_HEADER "\r\n"));
         }
 #endif
+        flushHeaderBlock(&hb);
+    }
+}
+
+
+/*
+    Append bytes to the header block. Data too large for the block is written directly after flushing the block.
+ */
+static void putBytes(HeaderBlock *hb, cchar *data, ssize len)
+{
+    if (hb->len + len >= (ssize) sizeof(hb->buf)) {
+        flushHeaderBlock(hb);
+        if (len >= (ssize) sizeof(hb->buf)) {
+            websWriteBlock(hb->wp, data, len);
+            return;
+        }
+    }
+    memcpy(&hb->buf[hb->len], data, len);
+    hb->len += len;
+}
+
+
+/*
+    Append a header line. The key slice includes the ": " separator.
+ */
+static void putHeader(HeaderBlock *hb, cchar *key, ssize keyLen, cchar *value)
+{
+    putBytes(hb, key, keyLen);
+    if (value) {
+        putBytes(hb, value, slen(value));
+    }
+    putBytes(hb, "\r\n", 2);
+}
+
+
+static void flushHeaderBlock(HeaderBlock *hb)
+{
+    if (hb->len > 0) {
+        hb->buf[hb->len] = '\0';
+        trace(3 | WEBS_RAW_MSG, "%s", hb->buf);
+        websWriteBlock(hb->wp, hb->buf, hb->len);
+        hb->len = 0;
     }
 }
 
@@ -2008,69 +3156,198 @@ PUBLIC ssize websWriteSocket(Webs *wp, cchar *buf, ssize size)
 
 
 /*
-    Write some output using transfer chunk encoding if required.
-    Returns true if all the data was written. Otherwise return zero.
+    Allocate a segment with size bytes of owned storage. Standard size segments are taken from the segment pool.
  */
-static bool flushChunkData(Webs *wp)
+static WebsSeg *allocSeg(ssize size)
 {
-    ssize   len, written, room;
+    WebsSeg     *seg;
 
-    assert(wp);
+    if (size == TX_SEG_SIZE && segPool) {
+        seg = segPool;
+        segPool = seg->next;
+        poolStats.segments--;
+    } else if ((seg = walloc(sizeof(WebsSeg) + size)) == 0) {
+        return 0;
+    }
+    memset(seg, 0, sizeof(WebsSeg));
+    seg->data = (char*) &seg[1];
+    seg->room = size;
+    seg->size = size;
+    return seg;
+}
 
-    while (bufLen(&wp->chunkbuf) > 0) {
-        /*
-            Stop if there is not room for a reasonable size chunk.
-            Subtract 16 to allow for the final trailer.
-         */
-        if ((room = bufRoom(&wp->output) - 16) <= CHUNK_LOW) {
-            bufGrow(&wp->output, CHUNK_LOW - room + 1);
-            if ((room = bufRoom(&wp->output) - 16) <= CHUNK_LOW) {
-                return 0;
-            }
+
+/*
+    Release a segment's referenced data and free the segment. Standard size segments are returned to the pool.
+ */
+static void freeSeg(WebsSeg *seg)
+{
+    if (seg->release) {
+        (seg->release)(seg->ref);
+    }
+    if (seg->size == TX_SEG_SIZE && poolStats.segments < ME_GOAHEAD_LIMIT_WEBS_POOL) {
+        seg->next = segPool;
+        segPool = seg;
+        poolStats.segments++;
+    } else {
+        wfree(seg);
+    }
+}
+
+
+static void appendSeg(WebsSeg **head, WebsSeg **tail, WebsSeg *seg)
+{
+    seg->next = 0;
+    if (*tail) {
+        (*tail)->next = seg;
+    } else {
+        *head = seg;
+    }
+    *tail = seg;
+}
+
+
+static void freeSegs(WebsSeg **head, WebsSeg **tail)
+{
+    WebsSeg     *seg, *next;
+
+    for (seg = *head; seg; seg = next) {
+        next = seg->next;
+        freeSeg(seg);
+    }
+    *head = *tail = 0;
+}
+
+
+/*
+    Copy data to the end of a segment chain. Small writes are coalesced into the last owned segment.
+ */
+static int queueBlock(WebsSeg **head, WebsSeg **tail, cchar *buf, ssize size)
+{
+    WebsSeg     *seg;
+    ssize       len;
+
+    if ((seg = *tail) != 0 && seg->room > 0) {
+        len = min(seg->room, size);
+        memcpy(&seg->data[seg->len], buf, len);
+        seg->len += len;
+        seg->room -= len;
+        buf += len;
+        size -= len;
+    }
+    if (size > 0) {
+        if ((seg = allocSeg(max(size, TX_SEG_SIZE))) == 0) {
+            return -1;
         }
-        switch (wp->txChunkState) {
-        default:
-        case WEBS_CHUNK_START:
-            /* Select the chunk size so that both the prefix and data will fit */
-            wp->txChunkLen = min(bufLen(&wp->chunkbuf), room - 16);
-            fmt(wp->txChunkPrefix, sizeof(wp->txChunkPrefix), "\r\n%x\r\n", wp->txChunkLen);
-            wp->txChunkPrefixLen = slen(wp->txChunkPrefix);
-            wp->txChunkPrefixNext = wp->txChunkPrefix;
-            wp->txChunkState = WEBS_CHUNK_HEADER;
-            break;
+        memcpy(seg->data, buf, size);
+        seg->len = size;
+        seg->room -= size;
+        appendSeg(head, tail, seg);
+    }
+    return 0;
+}
 
-        case WEBS_CHUNK_HEADER:
-            if ((written = bufPutBlk(&wp->output, wp->txChunkPrefixNext, wp->txChunkPrefixLen)) < 0) {
-                return 0;
-            } else {
-                wp->txChunkPrefixNext += written;
-                wp->txChunkPrefixLen -= written;
-                if (wp->txChunkPrefixLen <= 0) {
-                    wp->txChunkState = WEBS_CHUNK_DATA;
-                } else {
-                    return 0;
-                }
-            }
-            break;
 
-        case WEBS_CHUNK_DATA:
-            if (wp->txChunkLen > 0) {
-                len = min(room, wp->txChunkLen);
-                if ((written = bufPutBlk(&wp->output, wp->chunkbuf.servp, len)) != len) {
-                    assert(0);
-                    return -1;
-                }
-                bufAdjustStart(&wp->chunkbuf, written);
-                wp->txChunkLen -= written;
-                if (wp->txChunkLen <= 0) {
-                    wp->txChunkState = WEBS_CHUNK_START;
-                    bufCompact(&wp->chunkbuf);
-                }
-                bufAddNull(&wp->output);
-            }
+/*
+    Frame the pending body data as a single chunk and move it to the transmit chain
+ */
+static int frameChunk(Webs *wp)
+{
+    char    prefix[24];
+    ssize   len;
+
+    if (wp->chunkQueued > 0) {
+        fmt(prefix, sizeof(prefix), "\r\n%Lx\r\n", (int64) wp->chunkQueued);
+        len = slen(prefix);
+        if (queueBlock(&wp->txHead, &wp->txTail, prefix, len) < 0) {
+            return -1;
+        }
+        wp->txQueued += len;
+        if (wp->txTail) {
+            wp->txTail->next = wp->chunkHead;
+        } else {
+            wp->txHead = wp->chunkHead;
+        }
+        wp->txTail = wp->chunkTail;
+        wp->txQueued += wp->chunkQueued;
+        wp->chunkHead = wp->chunkTail = 0;
+        wp->chunkQueued = 0;
+    }
+    return 0;
+}
+
+
+/*
+    Write as much of the transmit chain as possible with a single writev. TLS must encrypt each segment separately.
+    Returns the number of bytes written or a negative error.
+ */
+static ssize writeSegs(Webs *wp)
+{
+    WebsIOVec   iov[TX_IOVEC];
+    WebsSeg     *seg;
+    ssize       written;
+    int         count;
+
+    if (wp->flags & WEBS_CLOSED) {
+        return -1;
+    }
+    for (seg = wp->txHead; seg && seg->len == 0; seg = seg->next) ;
+    if (seg == 0) {
+        return 0;
+    }
+#if ME_COM_SSL
+    if (wp->flags & WEBS_SECURE) {
+        return websWriteSocket(wp, seg->data, seg->len);
+    }
+#endif
+    for (count = 0; seg && count < TX_IOVEC; seg = seg->next) {
+        if (seg->len > 0) {
+            iov[count].iov_base = seg->data;
+            iov[count].iov_len = seg->len;
+            count++;
+        }
+    }
+    if ((written = socketWritev(wp->sid, iov, count)) < 0) {
+        return written;
+    }
+    wp->written += written;
+    websNoteRequestActivity(wp);
+    return written;
+}
+
+
+/*
+    Remove written data from the transmit chain. The last owned segment is kept for reuse.
+ */
+static void consumeSegs(Webs *wp, ssize len)
+{
+    WebsSeg     *seg;
+    char        *base;
+    ssize       n;
+
+    wp->txQueued -= len;
+    while ((seg = wp->txHead) != 0) {
+        n = min(len, seg->len);
+        seg->data += n;
+        seg->len -= n;
+        len -= n;
+        if (seg->len > 0) {
+            break;
+        }
+        if (seg == wp->txTail && seg->release == 0 && seg->ref == 0) {
+            base = (char*) &seg[1];
+            seg->room += seg->data - base;
+            seg->data = base;
+            break;
+        }
+        if ((wp->txHead = seg->next) == 0) {
+            wp->txTail = 0;
+        }
+        freeSeg(seg);
+        if (len <= 0) {
+            break;
         }
     }
-    return bufLen(&wp->chunkbuf) == 0;
 }
 
 
@@ -2082,27 +3359,26 @@ static bool flushChunkData(Webs *wp)
  */
 PUBLIC int websFlush(Webs *wp, bool block)
 {
-    WebsBuf     *op;
-    ssize       nbytes, written;
+    ssize       written;
     int         errCode, wasBlocking;
 
     if (block) {
         wasBlocking = socketSetBlock(wp->sid, 1);
     }
-    op = &wp->output;
     if (wp->flags & WEBS_CHUNKING) {
         trace(6, "websFlush chunking finalized %d", wp->finalized);
-        if (flushChunkData(wp) && wp->finalized) {
+        if (frameChunk(wp) == 0 && wp->finalized) {
             trace(6, "websFlush: write chunk trailer");
-            bufPutStr(op, "\r\n0\r\n\r\n");
-            bufAddNull(op);
-            wp->flags &= ~WEBS_CHUNKING;
+            if (queueBlock(&wp->txHead, &wp->txTail, "\r\n0\r\n\r\n", 7) == 0) {
+                wp->txQueued += 7;
+                wp->flags &= ~WEBS_CHUNKING;
+            }
         }
     }
-    trace(6, "websFlush: buflen %d", bufLen(op));
+    trace(6, "websFlush: queued %d", wp->txQueued);
     written = 0;
-    while ((nbytes = bufLen(op)) > 0) {
-        if ((written = websWriteSocket(wp, op->servp, nbytes)) < 0) {
+    while (wp->txQueued > 0) {
+        if ((written = writeSegs(wp)) < 0) {
             errCode = socketGetError(wp->sid);
             if (errCode == EWOULDBLOCK || errCode == EAGAIN) {
                 /* Not an error */
@@ -2113,30 +3389,32 @@ PUBLIC int websFlush(Webs *wp, bool block)
                 Connection Error
              */
             wp->flags &= ~WEBS_KEEP_ALIVE;
-            bufFlush(op);
+            freeSegs(&wp->txHead, &wp->txTail);
+            wp->txQueued = 0;
             wp->state = WEBS_COMPLETE;
             break;
         } else if (written == 0) {
             break;
         }
         trace(6, "websFlush: wrote %d to socket", written);
-        bufAdjustStart(op, written);
-        bufCompact(op);
-        nbytes = bufLen(op);
+        consumeSegs(wp, written);
     }
     assert(websValid(wp));
 
-    if (bufLen(op) == 0 && wp->finalized) {
+    if (wp->txQueued == 0 && wp->finalized) {
         wp->state = WEBS_COMPLETE;
     }
     if (block) {
         socketSetBlock(wp->sid, wasBlocking);
+    } else if (wp->txQueued > 0 && wp->state == WEBS_RUNNING) {
+        /* Write the remainder in the background */
+        setWritable(wp, 1);
     }
     if (written < 0) {
         /* I/O Error */
         return -1;
     }
-    return bufLen(op) == 0;
+    return wp->txQueued == 0;
 }
 
 
@@ -2147,14 +3425,21 @@ PUBLIC int websFlush(Webs *wp, bool block)
  */
 static void writeEvent(Webs *wp)
 {
-    WebsBuf     *op;
-
-    op = &wp->output;
-    if (bufLen(op) > 0) {
+    if (wp->txQueued > 0 || wp->chunkQueued > 0) {
         websFlush(wp, 0);
     }
-    if (bufLen(op) == 0 && wp->writeData) {
+    if ((wp->flags & WEBS_TX_FULL) && (wp->txQueued + wp->chunkQueued) <= wp->txLow) {
+        wp->flags &= ~WEBS_TX_FULL;
+        if (wp->writable) {
+            (wp->writable)(wp);
+        }
+    }
+    if (wp->txQueued == 0 && wp->writeData) {
         (wp->writeData)(wp);
+
+    } else if (wp->state == WEBS_RUNNING && wp->txQueued == 0 && wp->chunkQueued == 0 && !(wp->flags & WEBS_TX_FULL)) {
+        /* Nothing more to write until the handler produces more output */
+        setWritable(wp, 0);
     }
     if (wp->state != WEBS_RUNNING) {
         websPump(wp);
@@ -2162,20 +3447,58 @@ static void writeEvent(Webs *wp)
 }
 
 
+/*
+    Enable or disable writable socket events for a request
+ */
+static void setWritable(Webs *wp, bool on)
+{
+    WebsSocket  *sp;
+    int         mask;
+
+    if (wp->sid < 0 || (sp = socketPtr(wp->sid)) == NULL) {
+        return;
+    }
+    mask = on ? (sp->handlerMask | SOCKET_WRITABLE) : (sp->handlerMask & ~SOCKET_WRITABLE);
+    if (mask != sp->handlerMask) {
+        socketCreateHandler(wp->sid, mask, socketEvent, wp);
+    }
+}
+
+
+PUBLIC void websSetWritableHandler(Webs *wp, WebsWriteProc proc)
+{
+    assert(wp);
+    wp->writable = proc;
+}
+
+
+PUBLIC void websSetTxWatermarks(Webs *wp, ssize low, ssize high)
+{
+    assert(wp);
+    assert(0 <= low && low <= high);
+    wp->txLow = low;
+    wp->txHigh = high;
+}
+
+
+PUBLIC bool websWritable(Webs *wp)
+{
+    assert(wp);
+    return (wp->txQueued + wp->chunkQueued) < wp->txHigh;
+}
+
+
 PUBLIC void websSetBackgroundWriter(Webs *wp, WebsWriteProc proc)
 {
     WebsSocket  *sp;
-    WebsBuf     *op;
 
     assert(proc);
 
     wp->writeData = proc;
-    op = &wp->output;
-
-    if (bufLen(op) > 0) {
+    if (wp->txQueued > 0 || wp->chunkQueued > 0) {
         websFlush(wp, 0);
     }
-    if (bufLen(op) == 0) {
+    if (wp->txQueued == 0) {
         (wp->writeData)(wp);
     }
     if (wp->sid >= 0 && wp->state < WEBS_COMPLETE) {
@@ -2186,15 +3509,13 @@ PUBLIC void websSetBackgroundWriter(Webs *wp, WebsWriteProc proc)
 
 
 /*
-    Write a block of data of length to the user's browser. Output is buffered and flushed via websFlush.
+    Write a block of data of length to the user's browser. Output is queued and flushed via websFlush.
     This routine will never return "short". i.e. it will return the requested size to write or -1.
-    Buffer data. Will flush as required. May return -1 on write errors.
+    It never blocks. Output that cannot be written immediately stays queued and is written as the socket becomes
+    writable. Handlers should check websWritable and pause when the high watermark is exceeded.
  */
 PUBLIC ssize websWriteBlock(Webs *wp, cchar *buf, ssize size)
 {
-    WebsBuf     *op;
-    ssize       written, thisWrite, len, room;
-
     assert(wp);
     assert(websValid(wp));
     assert(buf);
@@ -2203,32 +3524,77 @@ PUBLIC ssize websWriteBlock(Webs *wp, cchar *buf, ssize size)
     if (wp->state >= WEBS_COMPLETE) {
         return -1;
     }
-    op = (wp->flags & WEBS_CHUNKING) ? &wp->chunkbuf : &wp->output;
-    written = len = 0;
-
-    while (size > 0 && wp->state < WEBS_COMPLETE) {
-        if (bufRoom(op) < size) {
-            /*
-                This will do a blocking I/O write. Will only ever fail for I/O errors.
-             */
-            if (websFlush(wp, 1) < 0) {
-                return -1;
-            }
+    if (wp->flags & WEBS_CHUNKING) {
+        if (queueBlock(&wp->chunkHead, &wp->chunkTail, buf, size) < 0) {
+            return -1;
         }
-        if ((room = bufRoom(op)) == 0) {
-            break;
+        wp->chunkQueued += size;
+    } else {
+        if (queueBlock(&wp->txHead, &wp->txTail, buf, size) < 0) {
+            return -1;
         }
-        thisWrite = min(room, size);
-        bufPutBlk(op, buf, thisWrite);
-        size -= thisWrite;
-        buf += thisWrite;
-        written += thisWrite;
+        wp->txQueued += size;
+    }
+    if (drainQueue(wp, 0) < 0) {
+        return -1;
+    }
+    return size;
+}
+
+
+/*
+    Once queued output passes the low watermark, or when the handler yields to the event loop, do an opportunistic
+    non-blocking write. Anything left is written in the background on writable events. Mark the request full when
+    the high watermark is reached.
+ */
+static int drainQueue(Webs *wp, bool yield)
+{
+    ssize   pending;
+
+    if ((!yield && (wp->txQueued + wp->chunkQueued) < wp->txLow) || !(wp->flags & WEBS_HEADERS_CREATED)) {
+        return 0;
+    }
+    if (websFlush(wp, 0) < 0) {
+        return -1;
+    }
+    pending = wp->txQueued + wp->chunkQueued;
+    if (pending >= wp->txHigh) {
+        wp->flags |= WEBS_TX_FULL;
+    }
+    if (pending > 0 && wp->state < WEBS_COMPLETE) {
+        setWritable(wp, 1);
+    }
+    return 0;
+}
+
+
+PUBLIC ssize websWriteRef(Webs *wp, cchar *buf, ssize size, WebsReleaseProc release)
+{
+    WebsSeg     *seg;
+
+    assert(wp);
+    assert(websValid(wp));
+    assert(buf);
+    assert(size >= 0);
+
+    if (wp->state >= WEBS_COMPLETE || (seg = allocSeg(0)) == 0) {
+        return -1;
     }
-    bufAddNull(op);
-    if (wp->state >= WEBS_COMPLETE && written == 0) {
+    seg->data = (char*) buf;
+    seg->len = size;
+    seg->ref = (void*) buf;
+    seg->release = release;
+    if (wp->flags & WEBS_CHUNKING) {
+        appendSeg(&wp->chunkHead, &wp->chunkTail, seg);
+        wp->chunkQueued += size;
+    } else {
+        appendSeg(&wp->txHead, &wp->txTail, seg);
+        wp->txQueued += size;
+    }
+    if (drainQueue(wp, 0) < 0) {
         return -1;
     }
-    return written;
+    return size;
 }
 
 
@@ -2285,52 +3651,407 @@ PUBLIC void websDecodeUrl(char *decoded, char *input, ssize len)
 
 #if ME_GOAHEAD_ACCESS_LOG && !ME_ROM
 /*
-    Output a log message in Common Log Format: See http://httpd.apache.org/docs/1.3/logs.html#common
+    Open the access log. The log is truncated when first opened by websOpen.
  */
-static void logRequest(Webs *wp, int code)
+static int openAccessLog(bool truncate)
 {
-    char        *buf, timeStr[28], zoneStr[6], dataStr[16];
-    ssize       len;
-    WebsTime    timer;
-    struct tm   localt;
-#if WINDOWS
-    DWORD       dwRet;
-    TIME_ZONE_INFORMATION tzi;
+    cchar   *path;
+    int     flags;
+
+    path = accessLog ? accessLog : "access.log";
+    flags = O_CREAT | O_APPEND | O_WRONLY | (truncate ? O_TRUNC : 0);
+    if ((accessFd = open(path, flags, 0666)) < 0) {
+        error("Cannot open access log %s", path);
+        return -1;
+    }
+    /* Some platforms don't implement O_APPEND (VXWORKS) */
+    accessSize = lseek(accessFd, 0, SEEK_END);
+    return 0;
+}
+
+
+static void closeAccessLog(void)
+{
+    if (accessFd >= 0) {
+        close(accessFd);
+        accessFd = -1;
+    }
+}
+
+
+/*
+    Test if the access log must be rotated or reopened. Prefork workers append to the same log, so accessSize only
+    counts the writes of this process. Refresh it from the file, which may also have been rotated by another worker.
+    Called with the access log locked.
+ */
+static bool checkAccessLog(void)
+{
+#if ME_UNIX_LIKE
+    struct stat info, current;
+
+    if (fstat(accessFd, &current) == 0) {
+        accessSize = (ssize) current.st_size;
+        if (stat(accessLog ? accessLog : "access.log", &info) < 0 || info.st_ino != current.st_ino) {
+            return 1;
+        }
+    }
 #endif
+    return accessSize >= accessMaxSize;
+}
 
-    assert(wp);
-    time(&timer);
+
+/*
+    Rotate the access log to path.1 and shift older logs. If another process has already rotated the log, just
+    reopen. Called with the access log locked. Prefork workers serialize via a record lock on the current log which
+    is released when it is closed.
+ */
+static void rotateAccessLog(void)
+{
+    cchar   *path;
+    char    *from, *to;
+    int     i;
+#if ME_UNIX_LIKE
+    struct stat     info, current;
+    struct flock    lock;
+#endif
+
+    path = accessLog ? accessLog : "access.log";
+#if ME_UNIX_LIKE
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    while (fcntl(accessFd, F_SETLKW, &lock) < 0 && errno == EINTR) {}
+    if (stat(path, &info) == 0 && fstat(accessFd, &current) == 0 && info.st_ino != current.st_ino) {
+        closeAccessLog();
+        openAccessLog(0);
+        return;
+    }
+#endif
+    closeAccessLog();
+    if (accessBackups > 0) {
+        for (i = accessBackups - 1; i >= 1; i--) {
+            from = sfmt("%s.%d", path, i);
+            to = sfmt("%s.%d", path, i + 1);
+            rename(from, to);
+            wfree(from);
+            wfree(to);
+        }
+        to = sfmt("%s.1", path);
+        rename(path, to);
+        wfree(to);
+    } else {
+        unlink(path);
+    }
+    openAccessLog(0);
+}
+
+
+PUBLIC int websSetAccessLog(cchar *path, cchar *format, ssize size, int backups)
+{
+    int     id;
+
+    if (format == 0 || *format == '\0' || smatch(format, "common")) {
+        id = LOG_COMMON;
+    } else if (smatch(format, "combined")) {
+        id = LOG_COMBINED;
+    } else if (smatch(format, "json")) {
+        id = LOG_JSON;
+    } else {
+        error("Unknown access log format %s", format);
+        return -1;
+    }
+    lockAccessLog();
+    accessConfigured = 1;
+    accessFormat = id;
+    accessMaxSize = max(size, 0);
+    accessBackups = max(backups, 0);
+    if (path && !smatch(path, accessLog)) {
+        wfree(accessLog);
+        accessLog = sclone(path);
+        if (accessFd >= 0) {
+            closeAccessLog();
+            if (openAccessLog(0) < 0) {
+                unlockAccessLog();
+                return -1;
+            }
+        }
+    }
+    unlockAccessLog();
+    return 0;
+}
+
+
+PUBLIC void websReopenAccessLog(void)
+{
+    accessReopen = 1;
+}
+
+
+PUBLIC void websFlushAccessLog(void)
+{
+    ssize   written, len;
+    char    *buf;
+
+    if (logLen == 0 && !accessReopen) {
+        return;
+    }
+    lockAccessLog();
+    if (accessReopen) {
+        accessReopen = 0;
+        if (accessFd >= 0) {
+            closeAccessLog();
+            openAccessLog(0);
+        }
+    }
+    if (accessMaxSize > 0 && accessFd >= 0 && checkAccessLog()) {
+        rotateAccessLog();
+    }
+    for (buf = logBuf, len = logLen; accessFd >= 0 && len > 0; ) {
+        if ((written = write(accessFd, buf, len)) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        buf += written;
+        len -= written;
+        accessSize += written;
+    }
+    if (accessMaxSize > 0 && accessSize >= accessMaxSize && accessFd >= 0) {
+        rotateAccessLog();
+    }
+    unlockAccessLog();
+    logLen = 0;
+}
+
+
+static void flushLogEvent(void *data, int id)
+{
+    websFlushAccessLog();
+    websRestartEvent(id, ME_GOAHEAD_LIMIT_LOG_FLUSH);
+}
+
+
+/*
+    Flush and free the access log buffer of the current event loop thread
+ */
+static void freeLogBuffer(void)
+{
+    websFlushAccessLog();
+    if (logEvent >= 0) {
+        websStopEvent(logEvent);
+        logEvent = -1;
+    }
+    wfree(logBuf);
+    logBuf = 0;
+}
+
+
+/*
+    Return the cached time stamp for the log format. This is reformatted when the second changes.
+ */
+static cchar *getLogTime(int format)
+{
+    WebsTime    now;
+    struct tm   tm;
+    char        zone[16];
+    int         offset;
 #if WINDOWS
-    localtime_s(&localt, &timer);
-#else
-    localtime_r(&timer, &localt);
+    TIME_ZONE_INFORMATION tzi;
 #endif
-    strftime(timeStr, sizeof(timeStr), "%d/%b/%Y:%H:%M:%S", &localt);
-    timeStr[sizeof(timeStr) - 1] = '\0';
+
+    time(&now);
+    if (now != logTime) {
 #if WINDOWS
-    dwRet = GetTimeZoneInformation(&tzi);
-    fmt(zoneStr, sizeof(zoneStr), "%+03d00", -(int) (tzi.Bias/60));
+        localtime_s(&tm, &now);
+        GetTimeZoneInformation(&tzi);
+        offset = -(int) tzi.Bias;
 #elif !VXWORKS
-    fmt(zoneStr, sizeof(zoneStr), "%+03d00", (int) (localt.tm_gmtoff/3600));
+        localtime_r(&now, &tm);
+        offset = (int) (tm.tm_gmtoff / 60);
 #else
-    zoneStr[0] = '\0';
+        localtime_r(&now, &tm);
+        offset = 0;
 #endif
-    zoneStr[sizeof(zoneStr) - 1] = '\0';
-    if (wp->written != 0) {
-        fmt(dataStr, sizeof(dataStr), "%Ld", wp->written);
-        dataStr[sizeof(dataStr) - 1] = '\0';
+        fmt(zone, sizeof(zone), "%c%02d%02d", offset < 0 ? '-' : '+', abs(offset) / 60, abs(offset) % 60);
+        strftime(logDate, sizeof(logDate), "%d/%b/%Y:%H:%M:%S ", &tm);
+        scopy(&logDate[slen(logDate)], sizeof(logDate) - slen(logDate), zone);
+        strftime(logIsoDate, sizeof(logIsoDate), "%Y-%m-%dT%H:%M:%S", &tm);
+        scopy(&logIsoDate[slen(logIsoDate)], sizeof(logIsoDate) - slen(logIsoDate), zone);
+        logTime = now;
+    }
+    return (format == LOG_JSON) ? logIsoDate : logDate;
+}
+
+
+/*
+    Append to a log record. Records are truncated rather than split so concurrent writers never interleave.
+ */
+static void logPut(LogRecord *rp, cchar *str, ssize len)
+{
+    len = min(len, rp->size - rp->len);
+    memcpy(&rp->buf[rp->len], str, len);
+    rp->len += len;
+}
+
+
+static void logPutStr(LogRecord *rp, cchar *str)
+{
+    if (str == 0 || *str == '\0') {
+        str = "-";
+    }
+    logPut(rp, str, slen(str));
+}
+
+
+static void logPutNum(LogRecord *rp, int64 value)
+{
+    char    num[32];
+
+    itosbuf(num, sizeof(num), value, 10);
+    logPut(rp, num, slen(num));
+}
+
+
+/*
+    Append a quoted, escaped JSON string. Null strings are written as null.
+ */
+static void logPutJson(LogRecord *rp, cchar *str)
+{
+    cchar   *cp;
+    char    esc[8];
+
+    if (str == 0) {
+        logPut(rp, "null", 4);
+        return;
+    }
+    logPut(rp, "\"", 1);
+    for (cp = str; *cp; cp++) {
+        if (*cp == '"' || *cp == '\\') {
+            esc[0] = '\\';
+            esc[1] = *cp;
+            logPut(rp, esc, 2);
+        } else if ((uchar) *cp < 0x20) {
+            fmt(esc, sizeof(esc), "\\u%04x", (uchar) *cp);
+            logPut(rp, esc, 6);
+        } else {
+            logPut(rp, cp, 1);
+        }
+    }
+    logPut(rp, "\"", 1);
+}
+
+
+/*
+    Format the request into the access log buffer. The buffer is written when it is half full or by the flush event.
+ */
+static void logRequest(Webs *wp, int code)
+{
+    LogRecord   rec;
+    char        buf[ME_GOAHEAD_LIMIT_HEADERS];
+    int64       usec;
+
+    assert(wp);
+
+    if (accessFd < 0) {
+        return;
+    }
+    if (logBuf == 0) {
+        if ((logBuf = walloc(LOG_BUFFER_SIZE)) == 0) {
+            return;
+        }
+        logLen = 0;
+        logEvent = websStartEvent(ME_GOAHEAD_LIMIT_LOG_FLUSH, flushLogEvent, 0);
+    }
+    rec.buf = buf;
+    rec.len = 0;
+    rec.size = sizeof(buf) - 1;
+    usec = wp->started ? websGetMicroTicks() - wp->started : 0;
+
+    if (accessFormat == LOG_JSON) {
+        logPut(&rec, "{\"time\":\"", 9);
+        logPutStr(&rec, getLogTime(LOG_JSON));
+        logPut(&rec, "\",\"remote\":", 11);
+        logPutJson(&rec, wp->ipaddr);
+        logPut(&rec, ",\"user\":", 8);
+        logPutJson(&rec, wp->username);
+        logPut(&rec, ",\"method\":", 10);
+        logPutJson(&rec, wp->method);
+        logPut(&rec, ",\"uri\":", 7);
+        logPutJson(&rec, wp->path);
+        logPut(&rec, ",\"protocol\":", 12);
+        logPutJson(&rec, wp->protoVersion);
+        logPut(&rec, ",\"status\":", 10);
+        logPutNum(&rec, code);
+        logPut(&rec, ",\"bytes\":", 9);
+        logPutNum(&rec, wp->written);
+        logPut(&rec, ",\"referrer\":", 12);
+        logPutJson(&rec, wp->referrer);
+        logPut(&rec, ",\"agent\":", 9);
+        logPutJson(&rec, wp->userAgent);
+        logPut(&rec, ",\"usec\":", 8);
+        logPutNum(&rec, usec);
+        /* Keep the closing brace when truncated */
+        rec.len = min(rec.len, rec.size - 1);
+        logPut(&rec, "}", 1);
     } else {
-        dataStr[0] = '-'; dataStr[1] = '\0';
+        logPutStr(&rec, wp->ipaddr);
+        logPut(&rec, " - ", 3);
+        logPutStr(&rec, wp->username);
+        logPut(&rec, " [", 2);
+        logPutStr(&rec, getLogTime(LOG_COMMON));
+        logPut(&rec, "] \"", 3);
+        logPutStr(&rec, wp->method);
+        logPut(&rec, " ", 1);
+        logPutStr(&rec, wp->path);
+        logPut(&rec, " ", 1);
+        logPutStr(&rec, wp->protoVersion);
+        logPut(&rec, "\" ", 2);
+        logPutNum(&rec, code);
+        logPut(&rec, " ", 1);
+        if (wp->written != 0) {
+            logPutNum(&rec, wp->written);
+        } else {
+            logPut(&rec, "-", 1);
+        }
+        if (accessFormat == LOG_COMBINED) {
+            logPut(&rec, " \"", 2);
+            logPutStr(&rec, wp->referrer);
+            logPut(&rec, "\" \"", 3);
+            logPutStr(&rec, wp->userAgent);
+            logPut(&rec, "\" ", 2);
+            logPutNum(&rec, usec);
+        }
+    }
+    /* Room for the newline is reserved */
+    rec.buf[rec.len++] = '\n';
+
+    if (logLen + rec.len > LOG_BUFFER_SIZE) {
+        websFlushAccessLog();
+    }
+    memcpy(&logBuf[logLen], rec.buf, rec.len);
+    logLen += rec.len;
+    if (logLen >= LOG_BUFFER_SIZE / 2) {
+        websFlushAccessLog();
     }
-    buf = NULL;
-    buf = sfmt("%s - %s [%s %s] \"%s %s %s\" %d %s\n",
-        wp->ipaddr, wp->username == NULL ? "-" : wp->username,
-        timeStr, zoneStr, wp->method, wp->path, wp->protoVersion, code, dataStr);
-    len = strlen(buf);
-    write(accessFd, buf, len);
-    wfree(buf);
 }
-#endif
+
+#else
+PUBLIC int websSetAccessLog(cchar *path, cchar *format, ssize size, int backups)
+{
+    return -1;
+}
+
+
+PUBLIC void websFlushAccessLog(void)
+{
+}
+
+
+PUBLIC void websReopenAccessLog(void)
+{
+}
+#endif /* ME_GOAHEAD_ACCESS_LOG */
 
 
 /*
@@ -2343,8 +4064,10 @@ static void checkTimeout(void *arg, int id)
     Webs        *wp;
     int         elapsed, delay;
 
-    wp = (Webs*) arg;
-    assert(websValid(wp));
+    if ((wp = websLookup((WebsHandle) (ssize) arg)) == 0) {
+        websStopEvent(id);
+        return;
+    }
 
     elapsed = getTimeSinceMark(wp) * 1000;
     if (websDebug) {
@@ -2463,8 +4186,7 @@ PUBLIC void websSetRequestFilename(Webs *wp, cchar *filename)
     assert(websValid(wp));
     assert(filename && *filename);
 
-    wfree(wp->filename);
-    wp->filename = sclone(filename);
+    wp->filename = websArenaClone(wp, filename);
     websSetVar(wp, "PATH_TRANSLATED", wp->filename);
 }
 #endif
@@ -2474,8 +4196,7 @@ PUBLIC int websRewriteRequest(Webs *wp, cchar *url)
 {
     char    *buf, *path;
 
-    wfree(wp->url);
-    wp->url = sclone(url);
+    wp->url = websArenaClone(wp, url);
     wfree(wp->path);
     wp->path = 0;
 
@@ -2483,7 +4204,6 @@ PUBLIC int websRewriteRequest(Webs *wp, cchar *url)
         return -1;
     }
     wp->path = sclone(path);
-    wfree(wp->filename);
     wp->filename = 0;
     wp->flags |= WEBS_REROUTE;
     wfree(buf);
@@ -2493,14 +4213,27 @@ PUBLIC int websRewriteRequest(Webs *wp, cchar *url)
 
 PUBLIC bool websValid(Webs *wp)
 {
+    return wp && 0 <= wp->wid && wp->wid < websMax && webs[wp->wid] == wp;
+}
+
+
+PUBLIC WebsHandle websGetHandle(Webs *wp)
+{
+    assert(websValid(wp));
+    return wp->handle;
+}
+
+
+PUBLIC Webs *websLookup(WebsHandle handle)
+{
+    Webs    *wp;
     int     wid;
 
-    for (wid = 0; wid < websMax; wid++) {
-        if (wp == webs[wid]) {
-            return 1;
-        }
+    wid = handle & WEBS_HANDLE_MASK;
+    if (handle < 0 || wid >= websMax || (wp = webs[wid]) == 0 || wp->handle != handle) {
+        return 0;
     }
-    return 0;
+    return wp;
 }
 
 
@@ -2509,29 +4242,60 @@ PUBLIC bool websValid(Webs *wp)
  */
 PUBLIC char *websGetDateString(WebsFileInfo *sbuf)
 {
-    WebsTime    now;
-    struct tm   tm;
-    char        *cp;
+    char    buf[64];
 
     if (sbuf == NULL) {
-        time(&now);
-    } else {
-        now = sbuf->mtime;
+        return sclone(getDate());
+    }
+    if (formatDate(buf, sizeof(buf), sbuf->mtime) == 0) {
+        return NULL;
+    }
+    return sclone(buf);
+}
+
+
+/*
+    Return the current date string. This is cached per event loop thread and reformatted when the second changes.
+ */
+static cchar *getDate(void)
+{
+    WebsTime    now;
+
+    time(&now);
+    if (now != dateTime || !dateString[0]) {
+        if (formatDate(dateString, sizeof(dateString), now) == 0) {
+            return "";
+        }
+        dateTime = now;
     }
+    return dateString;
+}
+
+
+static char *formatDate(char *buf, ssize size, WebsTime when)
+{
+    struct tm   tm;
+    char        *cp;
 #if ME_UNIX_LIKE
-    gmtime_r(&now, &tm);
+    char        tbuf[64];
+
+    gmtime_r(&when, &tm);
+    cp = asctime_r(&tm, tbuf);
 #else
-    {
-        struct tm *tp;
-        tp = gmtime(&now);
-        tm = *tp;
-    }
+    struct tm   *tp;
+
+    tp = gmtime(&when);
+    tm = *tp;
+    cp = asctime(&tm);
 #endif
-    if ((cp = asctime(&tm)) != NULL) {
-        cp[strlen(cp) - 1] = '\0';
-        return sclone(cp);
+    if (cp == NULL) {
+        return NULL;
     }
-    return NULL;
+    scopy(buf, size, cp);
+    if ((cp = strchr(buf, '\n')) != NULL) {
+        *cp = '\0';
+    }
+    return buf;
 }
 
 
@@ -2861,7 +4625,9 @@ PUBLIC void websPageClose(Webs *wp)
 {
     assert(websValid(wp));
 
-    if (wp->docfd >= 0) {
+    if (wp->docEntry) {
+        websReleaseDocument(wp);
+    } else if (wp->docfd >= 0) {
         websCloseFile(wp->docfd);
         wp->docfd = -1;
     }
@@ -2967,6 +4733,9 @@ PUBLIC void websSetCookie(Webs *wp, cchar *name, cchar *value, cchar *path, ccha
     }
     cookie = sfmt("%s=%s; path=%s%s%s%s%s%s%s%s", name, value, path, domainAtt, domain, expiresAtt, expires, secure,
         httponly, sameSite);
+    if (wp->responseCookies < 0) {
+        wp->responseCookies = hashCreate(7);
+    }
     hashEnter(wp->responseCookies, name, valueString(cookie, 0), 0);
     wfree(domain);
 }
@@ -3110,20 +4879,26 @@ static char *makeSessionID(Webs *wp)
 
 PUBLIC void websDestroySession(Webs *wp)
 {
-    websGetSession(wp, 0);
+    lockSessions();
+    getSession(wp, 0);
     if (wp->session) {
-        hashDelete(sessions, wp->session->id);
-        sessionCount--;
-        freeSession(wp->session);
+        removeSession(wp->session);
+        releaseSession(wp->session);
         wp->session = 0;
     }
+    unlockSessions();
 }
 
 
 PUBLIC WebsSession *websCreateSession(Webs *wp)
 {
+    WebsSession     *sp;
+
+    lockSessions();
     websDestroySession(wp);
-    return websGetSession(wp, 1);
+    sp = websGetSession(wp, 1);
+    unlockSessions();
+    return sp;
 }
 
 
@@ -3138,6 +4913,7 @@ WebsSession *websAllocSession(Webs *wp, cchar *id, int lifespan)
     }
     sp->lifespan = lifespan;
     sp->expires = time(0) + lifespan;
+    sp->refs = 1;
     if (id == 0) {
         sp->id = makeSessionID(wp);
     } else {
@@ -3157,6 +4933,33 @@ WebsSession *websAllocSession(Webs *wp, cchar *id, int lifespan)
 }
 
 
+/*
+    Remove a session from the session table. The session is freed once no request references it.
+    The caller must hold the session lock.
+ */
+static void removeSession(WebsSession *sp)
+{
+    WebsKey     *sym;
+
+    if ((sym = hashLookup(sessions, sp->id)) != 0 && sym->content.value.symbol == sp) {
+        hashDelete(sessions, sp->id);
+        sessionCount--;
+        releaseSession(sp);
+    }
+}
+
+
+/*
+    Release a reference to a session. The caller must hold the session lock.
+ */
+static void releaseSession(WebsSession *sp)
+{
+    if (--sp->refs == 0) {
+        freeSession(sp);
+    }
+}
+
+
 static void freeSession(WebsSession *sp)
 {
     assert(sp);
@@ -3170,7 +4973,21 @@ static void freeSession(WebsSession *sp)
 }
 
 
+/*
+    Sessions are shared by all event loop threads. Callers of the session APIs are serialized via lockSessions.
+ */
 WebsSession *websGetSession(Webs *wp, int create)
+{
+    WebsSession *sp;
+
+    lockSessions();
+    sp = getSession(wp, create);
+    unlockSessions();
+    return sp;
+}
+
+
+static WebsSession *getSession(Webs *wp, int create)
 {
     WebsKey     *sym;
     char        *id;
@@ -3203,6 +5020,8 @@ WebsSession *websGetSession(Webs *wp, int create)
         } else {
             wp->session = (WebsSession*) sym->content.value.symbol;
         }
+        /* The request holds a reference until termWebs so another thread cannot free the session while in use */
+        wp->session->refs++;
         wfree(id);
     }
     if (wp->session) {
@@ -3275,16 +5094,23 @@ PUBLIC cchar *websGetSessionVar(Webs *wp, cchar *key, cchar *defaultValue)
     WebsSession     *sp;
     WebsKey         *sym;
 
+    cchar           *value;
+
     assert(wp);
     assert(key && *key);
 
-    if ((sp = websGetSession(wp, 1)) != 0) {
+    value = 0;
+    lockSessions();
+    if ((sp = getSession(wp, 1)) != 0) {
         if ((sym = hashLookup(sp->cache, key)) == 0) {
-            return defaultValue;
+            value = defaultValue;
+        } else {
+            /* Copy while locked as another thread may replace or remove the variable */
+            value = websArenaClone(wp, sym->content.value.string);
         }
-        return (char*) sym->content.value.symbol;
     }
-    return 0;
+    unlockSessions();
+    return value;
 }
 
 
@@ -3295,27 +5121,32 @@ PUBLIC void websRemoveSessionVar(Webs *wp, cchar *key)
     assert(wp);
     assert(key && *key);
 
-    if ((sp = websGetSession(wp, 1)) != 0) {
+    lockSessions();
+    if ((sp = getSession(wp, 1)) != 0) {
         hashDelete(sp->cache, key);
     }
+    unlockSessions();
 }
 
 
 PUBLIC int websSetSessionVar(Webs *wp, cchar *key, cchar *value)
 {
     WebsSession  *sp;
+    int          rc;
 
     assert(wp);
     assert(key && *key);
     assert(value);
 
-    if ((sp = websGetSession(wp, 1)) == 0) {
-        return 0;
-    }
-    if (hashEnter(sp->cache, key, valueString(value, VALUE_ALLOCATE), 0) == 0) {
-        return -1;
+    rc = 0;
+    lockSessions();
+    if ((sp = getSession(wp, 1)) != 0) {
+        if (hashEnter(sp->cache, key, valueString(value, VALUE_ALLOCATE), 0) == 0) {
+            rc = -1;
+        }
     }
-    return 0;
+    unlockSessions();
+    return rc;
 }
 
 
@@ -3326,6 +5157,7 @@ static void pruneSessions(void)
     WebsKey         *sym, *next;
     int             oldCount;
 
+    lockSessions();
     if (sessions >= 0) {
         oldCount = sessionCount;
         when = time(0);
@@ -3333,15 +5165,14 @@ static void pruneSessions(void)
             next = hashNext(sessions, sym);
             sp = (WebsSession*) sym->content.value.symbol;
             if (sp->expires <= when) {
-                hashDelete(sessions, sp->id);
-                sessionCount--;
-                freeSession(sp);
+                removeSession(sp);
             }
         }
         if (oldCount != sessionCount || sessionCount) {
             trace(4, "Prune %d sessions. Remaining: %d", oldCount - sessionCount, sessionCount);
         }
     }
+    unlockSessions();
     websRestartEvent(pruneId, WEBS_SESSION_PRUNE);
 }
 
@@ -3355,8 +5186,7 @@ static void freeSessions(void)
         for (sym = hashFirst(sessions); sym; sym = next) {
             next = hashNext(sessions, sym);
             sp = (WebsSession*) sym->content.value.symbol;
-            hashDelete(sessions, sp->id);
-            freeSession(sp);
+            removeSession(sp);
         }
         hashFree(sessions);
         sessions = -1;
@@ -3435,8 +5265,8 @@ PUBLIC void websError(Webs *wp, int code, cchar *fmt, ...)
         wp->flags &= ~WEBS_KEEP_ALIVE;
     }
     encoded = websEscapeHtml(wp->url);
-    wfree(wp->url);
-    wp->url = encoded;
+    wp->url = websArenaClone(wp, encoded);
+    wfree(encoded);
     if (fmt) {
         if (!(code & WEBS_NOLOG)) {
             va_start(args, fmt);
@@ -14,8 +14,8 @@
 #define     OCTAL   8
 #define     HEX     16
 
-static Js   **jsHandles;    /* List of js handles */
-static int  jsMax = -1;     /* Maximum size of  */
+static WEBS_THREAD_LOCAL Js **jsHandles;   /* List of js handles */
+static WEBS_THREAD_LOCAL int jsMax = -1;    /* Maximum size of  */
 
 /****************************** Forward Declarations **************************/
 
@@ -28,6 +28,7 @@ static char *skipWhite(char *s);
 static bool jstHandler(Webs *wp)
 {
     WebsFileInfo    sbuf;
+    WebsHandle      wh;
     char            *lang, *token, *result, *ep, *cp, *buf, *nextp, *last;
     ssize           len;
     int             rc, jid;
@@ -36,7 +37,12 @@ static bool jstHandler(Webs *wp)
     assert(wp->filename && *wp->filename);
     assert(wp->ext && *wp->ext);
 
+    /*
+        Scripts may complete the request, so use a handle to test if wp is still valid after evaluation
+     */
+    wh = websGetHandle(wp);
     buf = 0;
+    websSetHeaderVars(wp);
     if ((jid = jsOpenEngine(wp->vars, websJstFunctions)) < 0) {
         websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR, "Cannot create JavaScript engine");
         goto done;
@@ -121,7 +127,7 @@ static bool jstHandler(Webs *wp)
                          Be careful if the user has called websError() already.
                      */
                     rc = -1;
-                    if (websValid(wp)) {
+                    if (websLookup(wh)) {
                         if (result) {
                             websWrite(wp, "<h2><b>Javascript Error: %s</b></h2>\n", result);
                             websWrite(wp, "<pre>%s</pre>", nextp);
@@ -152,7 +158,7 @@ static bool jstHandler(Webs *wp)
     Common exit and cleanup
  */
 done:
-    if (websValid(wp)) {
+    if (websLookup(wh)) {
         websPageClose(wp);
         if (jid >= 0) {
             jsCloseEngine(jid);
@@ -18,91 +18,145 @@
 
 /*********************************** Locals ***********************************/
 
-static WebsRoute **routes = 0;
 static WebsHash handlers = -1;
-static int routeCount = 0;
-static int routeMax = 0;
 
 #define WEBS_MAX_ROUTE 16               /* Maximum passes over route set */
 
+/*
+    Route index. A prefix trie with a node per prefix character. Children are linked in character order.
+ */
+typedef struct RouteNode {
+    struct RouteNode *child;            /* First child */
+    struct RouteNode *sibling;          /* Next sibling with a greater character */
+    int         *routes;                /* Indexes of routes with a prefix ending at this node, in order */
+    int         count;                  /* Number of routes */
+    uchar       c;                      /* Prefix character */
+} RouteNode;
+
+#define ROUTE_MAX_CANDIDATES 64         /* Maximum routes collected per request before testing every route */
+#define ROUTE_MAX_EXT        64         /* Extensions with a bit in WebsRoute.extensionMask */
+
+/*
+    Per-request match state
+ */
+typedef struct RouteMatch {
+    int         candidates[ROUTE_MAX_CANDIDATES];   /* Routes with a matching prefix in order */
+    int         count;                  /* Number of candidates */
+    int         next;                   /* Next candidate to test */
+    uint        method;                 /* Request method bit */
+    uint64      extension;              /* Request extension bit */
+    bool        extensionHash;          /* Request extension has no bit */
+    bool        extensionSet;           /* Extension bit has been computed */
+    bool        safeMethod;             /* GET, HEAD or POST */
+    bool        scan;                   /* Test every route */
+} RouteMatch;
+
+/*
+    Methods with a bit in WebsRoute.methodMask
+ */
+static cchar *routeMethods[] = { "GET", "HEAD", "POST", "PUT", "DELETE", "OPTIONS", "TRACE", "PATCH", 0 };
+
+#define ROUTE_GET   0x1
+#define ROUTE_HEAD  0x2
+#define ROUTE_POST  0x4
+
+/*
+    Route configuration. Requests hold a reference to the set they were routed with so websReload can make a new set
+    current while requests using the old routes complete.
+ */
+typedef struct WebsRouteSet {
+    WebsRoute   **routes;               /* Routes in configuration order */
+    RouteNode   *index;                 /* Prefix trie */
+    WebsHash    extIndex;               /* Extension bit numbers */
+    WebsHash    users;                  /* Users for these routes once retired (-1 while current). Freed with the set */
+    WebsHash    roles;                  /* Roles for these routes once retired (-1 while current) */
+    int         count;                  /* Number of routes */
+    int         max;                    /* Size of the routes list */
+    int         refs;                   /* References from requests plus one while current */
+} WebsRouteSet;
+
+static WebsRouteSet *routeSet = 0;      /* Current routes */
+static WebsRouteSet *loadSet = 0;       /* Routes being loaded by websReload */
+static bool useIndex = 1;               /* Use the route index */
+static int indexDefer = 0;              /* Defer building the index while loading */
+
+#if ME_GOAHEAD_THREADS
+static pthread_mutex_t routeLock = PTHREAD_MUTEX_INITIALIZER;   /* Route set references */
+#define lockRoutes() pthread_mutex_lock(&routeLock)
+#define unlockRoutes() pthread_mutex_unlock(&routeLock)
+#else
+#define lockRoutes()
+#define unlockRoutes()
+#endif
+
 /********************************** Forwards **********************************/
 
+static int addNodeRoute(RouteNode *np, int id);
+static RouteNode *allocNode(uchar c);
+static WebsRouteSet *allocSet(void);
+static void buildIndex(WebsRouteSet *set);
 static bool continueHandler(Webs *wp);
+static WebsRouteSet *editSet(void);
+static void freeNode(RouteNode *np);
 static void freeRoute(WebsRoute *route);
-static void growRoutes(void);
-static int lookupRoute(cchar *uri);
+static void freeSet(WebsRouteSet *set);
+static int growRoutes(WebsRouteSet *set);
+static void initMatch(Webs *wp, WebsRouteSet *set, RouteMatch *mp);
+static int lookupRoute(WebsRouteSet *set, cchar *uri);
+static uint methodBit(cchar *method);
+static int nextRoute(Webs *wp, WebsRouteSet *set, RouteMatch *mp, int from);
+static void releaseSet(WebsRouteSet *set);
 static bool redirectHandler(Webs *wp);
+static bool scanRoute(Webs *wp, RouteMatch *mp, WebsRoute *route);
+static void setExtension(Webs *wp, WebsRouteSet *set, RouteMatch *mp);
 
 /************************************ Code ************************************/
 /*
-    Route the request. If wp->route is already set, test routes after that route
+    Route the request. If wp->route is already set, test routes after that route. The request keeps a reference to
+    the current route set until it completes, so it is routed with one configuration even if it is reloaded.
  */
 
 PUBLIC void websRouteRequest(Webs *wp)
 {
-    WebsRoute   *route;
-    WebsHandler *handler;
-    ssize       plen, len;
-    bool        safeMethod;
-    int         i;
+    WebsRouteSet    *set;
+    WebsRoute       *route;
+    WebsHandler     *handler;
+    RouteMatch      match;
+    int             i;
 
     assert(wp);
     assert(wp->path);
     assert(wp->method);
     assert(wp->protocol);
 
-    safeMethod = smatch(wp->method, "POST") || smatch(wp->method, "GET") || smatch(wp->method, "HEAD");
-    plen = slen(wp->path);
-
+    if ((set = wp->routeSet) == 0) {
+        lockRoutes();
+        set = wp->routeSet = routeSet;
+        set->refs++;
+        unlockRoutes();
+    }
     /*
         Resume routine from last matched route. This permits the legacy service() callbacks to return false
         and continue routing.
      */
     if (wp->route && !(wp->flags & WEBS_REROUTE)) {
-        for (i = 0; i < routeCount; i++) {
-            if (wp->route == routes[i]) {
+        for (i = 0; i < set->count; i++) {
+            if (wp->route == set->routes[i]) {
                 i++;
                 break;
             }
         }
-        if (i >= routeCount) {
+        if (i >= set->count) {
             i = 0;
         }
     } else {
         i = 0;
     }
     wp->route = 0;
+    initMatch(wp, set, &match);
 
-    for (; i < routeCount; i++) {
-        route = routes[i];
-        assert(route->prefix && route->prefixLen > 0);
-
-        if (plen < route->prefixLen) continue;
-        len = min(route->prefixLen, plen);
-        trace(5, "Examine route %s", route->prefix);
-        /*
-            Match route
-         */
-        if (strncmp(wp->path, route->prefix, len) != 0) {
-            continue;
-        }
-        if (route->protocol && !smatch(route->protocol, wp->protocol)) {
-            trace(5, "Route %s does not match protocol %s", route->prefix, wp->protocol);
-            continue;
-        }
-        if (route->methods >= 0) {
-            if (!hashLookup(route->methods, wp->method)) {
-                trace(5, "Route %s does not match method %s", route->prefix, wp->method);
-                continue;
-            }
-        } else if (!safeMethod) {
-            continue;
-        }
-        if (route->extensions >= 0 && (wp->ext == 0 || !hashLookup(route->extensions, &wp->ext[1]))) {
-            trace(5, "Route %s doesn match extension %s", route->prefix, wp->ext ? wp->ext : "");
-            continue;
-        }
-
+    for (; (i = nextRoute(wp, set, &match, i)) >= 0; i++) {
+        route = set->routes[i];
         wp->route = route;
 #if ME_GOAHEAD_AUTH
         if (route->authType && !websAuthenticate(wp)) {
@@ -125,6 +179,8 @@ PUBLIC void websRouteRequest(Webs *wp)
             if (++wp->routeCount >= WEBS_MAX_ROUTE) {
                 break;
             }
+            /* The path may have changed */
+            initMatch(wp, set, &match);
             i = 0;
         }
     }
@@ -136,6 +192,301 @@ PUBLIC void websRouteRequest(Webs *wp)
 }
 
 
+/*
+    Prepare to match routes for the request. Collect the routes whose prefix matches the request path from the index
+    in configuration order, and convert the method and extension to bits.
+ */
+static void initMatch(Webs *wp, WebsRouteSet *set, RouteMatch *mp)
+{
+    RouteNode   *np;
+    cchar       *cp;
+    int         i, j, id;
+
+    mp->count = mp->next = 0;
+    mp->scan = !useIndex || set->index == 0;
+    mp->method = methodBit(wp->method);
+    mp->safeMethod = (mp->method & (ROUTE_GET | ROUTE_HEAD | ROUTE_POST)) != 0;
+    mp->extension = 0;
+    mp->extensionHash = 0;
+    mp->extensionSet = 0;
+    if (mp->scan) {
+        return;
+    }
+    for (np = set->index, cp = wp->path; *cp && np; cp++) {
+        for (np = np->child; np && np->c < (uchar) *cp; np = np->sibling) ;
+        if (np == 0 || np->c != (uchar) *cp) {
+            break;
+        }
+        for (i = 0; i < np->count; i++) {
+            if (mp->count >= ROUTE_MAX_CANDIDATES) {
+                /* Too many overlapping prefixes. Test every route */
+                mp->scan = 1;
+                return;
+            }
+            /* Insertion sort. Deeper nodes usually hold later routes, so this is short */
+            id = np->routes[i];
+            for (j = mp->count; j > 0 && mp->candidates[j - 1] > id; j--) {
+                mp->candidates[j] = mp->candidates[j - 1];
+            }
+            mp->candidates[j] = id;
+            mp->count++;
+        }
+    }
+}
+
+
+/*
+    Return the index of the next route at or after index "from" that matches the request, or -1 if none
+ */
+static int nextRoute(Webs *wp, WebsRouteSet *set, RouteMatch *mp, int from)
+{
+    WebsRoute   *route;
+    int         id;
+
+    if (mp->scan) {
+        for (id = from; id < set->count; id++) {
+            if (scanRoute(wp, mp, set->routes[id])) {
+                return id;
+            }
+        }
+        return -1;
+    }
+    for (; mp->next < mp->count; mp->next++) {
+        if ((id = mp->candidates[mp->next]) < from) {
+            continue;
+        }
+        route = set->routes[id];
+        trace(5, "Examine route %s", route->prefix);
+        if (route->protocol && !smatch(route->protocol, wp->protocol)) {
+            trace(5, "Route %s does not match protocol %s", route->prefix, wp->protocol);
+            continue;
+        }
+        if (route->methods >= 0) {
+            if (!(route->methodMask & mp->method) && !(route->methodHash && hashLookup(route->methods, wp->method))) {
+                trace(5, "Route %s does not match method %s", route->prefix, wp->method);
+                continue;
+            }
+        } else if (!mp->safeMethod) {
+            continue;
+        }
+        if (route->extensions >= 0 && !mp->extensionSet) {
+            setExtension(wp, set, mp);
+        }
+        if (route->extensions >= 0 && !(route->extensionMask & mp->extension) &&
+                !(mp->extensionHash && route->extensionHash && hashLookup(route->extensions, &wp->ext[1]))) {
+            trace(5, "Route %s doesn match extension %s", route->prefix, wp->ext ? wp->ext : "");
+            continue;
+        }
+        mp->next++;
+        return id;
+    }
+    return -1;
+}
+
+
+/*
+    Convert the request extension to a bit. This is only done if a candidate route restricts extensions.
+ */
+static void setExtension(Webs *wp, WebsRouteSet *set, RouteMatch *mp)
+{
+    WebsKey     *kp;
+    int         id;
+
+    mp->extensionSet = 1;
+    if (wp->ext && set->extIndex >= 0 && (kp = hashLookup(set->extIndex, &wp->ext[1])) != 0) {
+        if ((id = (int) kp->content.value.integer) < ROUTE_MAX_EXT) {
+            mp->extension = ((uint64) 1) << id;
+        } else {
+            mp->extensionHash = 1;
+        }
+    }
+}
+
+
+/*
+    Test a route without the index
+ */
+static bool scanRoute(Webs *wp, RouteMatch *mp, WebsRoute *route)
+{
+    ssize   plen;
+
+    assert(route->prefix && route->prefixLen > 0);
+
+    plen = slen(wp->path);
+    if (plen < route->prefixLen) {
+        return 0;
+    }
+    trace(5, "Examine route %s", route->prefix);
+    if (strncmp(wp->path, route->prefix, route->prefixLen) != 0) {
+        return 0;
+    }
+    if (route->protocol && !smatch(route->protocol, wp->protocol)) {
+        trace(5, "Route %s does not match protocol %s", route->prefix, wp->protocol);
+        return 0;
+    }
+    if (route->methods >= 0) {
+        if (!hashLookup(route->methods, wp->method)) {
+            trace(5, "Route %s does not match method %s", route->prefix, wp->method);
+            return 0;
+        }
+    } else if (!mp->safeMethod) {
+        return 0;
+    }
+    if (route->extensions >= 0 && (wp->ext == 0 || !hashLookup(route->extensions, &wp->ext[1]))) {
+        trace(5, "Route %s doesn match extension %s", route->prefix, wp->ext ? wp->ext : "");
+        return 0;
+    }
+    return 1;
+}
+
+
+static uint methodBit(cchar *method)
+{
+    int     i;
+
+    if (method == 0) {
+        return 0;
+    }
+    for (i = 0; routeMethods[i]; i++) {
+        if (method[0] == routeMethods[i][0] && strcmp(method, routeMethods[i]) == 0) {
+            return 1 << i;
+        }
+    }
+    return 0;
+}
+
+
+/*
+    Compile the routes into a prefix trie. Each node lists the routes whose prefix ends at the node in configuration
+    order. Method and extension sets are converted to bitmasks. Extensions are numbered across all routes.
+ */
+static void buildIndex(WebsRouteSet *set)
+{
+    WebsRoute   *route;
+    WebsKey     *kp, *ext;
+    RouteNode   *np, *child, **link;
+    cchar       *cp;
+    uint        bit;
+    int         i, id, extCount;
+
+    if (indexDefer) {
+        return;
+    }
+    freeNode(set->index);
+    set->index = 0;
+    hashFree(set->extIndex);
+    set->extIndex = -1;
+    if (set->count == 0) {
+        return;
+    }
+    if ((set->index = allocNode(0)) == 0 || (set->extIndex = hashCreate(-1)) < 0) {
+        freeNode(set->index);
+        set->index = 0;
+        return;
+    }
+    extCount = 0;
+    for (i = 0; i < set->count; i++) {
+        route = set->routes[i];
+        route->methodMask = 0;
+        route->methodHash = 0;
+        if (route->methods >= 0) {
+            for (kp = hashFirst(route->methods); kp; kp = hashNext(route->methods, kp)) {
+                if ((bit = methodBit(kp->name.value.string)) != 0) {
+                    route->methodMask |= bit;
+                } else {
+                    route->methodHash = 1;
+                }
+            }
+        }
+        route->extensionMask = 0;
+        route->extensionHash = 0;
+        if (route->extensions >= 0) {
+            for (kp = hashFirst(route->extensions); kp; kp = hashNext(route->extensions, kp)) {
+                if ((ext = hashLookup(set->extIndex, kp->name.value.string)) != 0) {
+                    id = (int) ext->content.value.integer;
+                } else {
+                    id = extCount++;
+                    hashEnter(set->extIndex, kp->name.value.string, valueInteger(id), 0);
+                }
+                if (id < ROUTE_MAX_EXT) {
+                    route->extensionMask |= ((uint64) 1) << id;
+                } else {
+                    route->extensionHash = 1;
+                }
+            }
+        }
+        /*
+            Insert the prefix. Siblings are sorted by character.
+         */
+        np = set->index;
+        for (cp = route->prefix; *cp; cp++) {
+            for (link = &np->child; *link && (*link)->c < (uchar) *cp; link = &(*link)->sibling) ;
+            if (*link == 0 || (*link)->c != (uchar) *cp) {
+                if ((child = allocNode((uchar) *cp)) == 0) {
+                    break;
+                }
+                child->sibling = *link;
+                *link = child;
+            }
+            np = *link;
+        }
+        if (*cp || addNodeRoute(np, i) < 0) {
+            error("Cannot index route %s", route->prefix);
+            freeNode(set->index);
+            set->index = 0;
+            return;
+        }
+    }
+}
+
+
+static RouteNode *allocNode(uchar c)
+{
+    RouteNode   *np;
+
+    if ((np = walloc(sizeof(RouteNode))) == 0) {
+        return 0;
+    }
+    memset(np, 0, sizeof(RouteNode));
+    np->c = c;
+    return np;
+}
+
+
+static int addNodeRoute(RouteNode *np, int id)
+{
+    int     *list;
+
+    if ((list = wrealloc(np->routes, (np->count + 1) * sizeof(int))) == 0) {
+        return -1;
+    }
+    list[np->count++] = id;
+    np->routes = list;
+    return 0;
+}
+
+
+static void freeNode(RouteNode *np)
+{
+    RouteNode   *child, *next;
+
+    if (np) {
+        for (child = np->child; child; child = next) {
+            next = child->sibling;
+            freeNode(child);
+        }
+        wfree(np->routes);
+        wfree(np);
+    }
+}
+
+
+PUBLIC void websSetRouteIndex(bool on)
+{
+    useIndex = on;
+}
+
+
 PUBLIC bool websRunRequest(Webs *wp)
 {
     WebsRoute   *route;
@@ -155,8 +506,7 @@ PUBLIC bool websRunRequest(Webs *wp)
         return 1;
     }
     if (!wp->filename || route->dir) {
-        wfree(wp->filename);
-        wp->filename = sfmt("%s%s", route->dir ? route->dir : websGetDocuments(), wp->path);
+        wp->filename = websArenaFmt(wp, "%s%s", route->dir ? route->dir : websGetDocuments(), wp->path);
     }
     if (!(wp->flags & WEBS_VARS_ADDED)) {
         if (wp->query && *wp->query) {
@@ -210,7 +560,7 @@ PUBLIC bool websCan(Webs *wp, WebsHash abilities)
                 websError(wp, HTTP_CODE_UNAUTHORIZED, "Access Denied. User not logged in.");
                 return 0;
             }
-            if ((wp->user = websLookupUser(wp->username)) == 0) {
+            if ((wp->user = websLookupRequestUser(wp, wp->username)) == 0) {
                 websError(wp, HTTP_CODE_UNAUTHORIZED, "Access Denied. Unknown user.");
                 return 0;
             }
@@ -218,7 +568,7 @@ PUBLIC bool websCan(Webs *wp, WebsHash abilities)
     }
     if (abilities >= 0) {
         if (!wp->user && wp->username) {
-            wp->user = websLookupUser(wp->username);
+            wp->user = websLookupRequestUser(wp, wp->username);
         }
         for (key = hashFirst(abilities); key; key = hashNext(abilities, key)) {
             ability = key->name.value.string;
@@ -259,7 +609,7 @@ PUBLIC bool websCanString(Webs *wp, char *abilities)
         if (!wp->username) {
             return 0;
         }
-        if ((user = websLookupUser(wp->username)) == 0) {
+        if ((user = websLookupRequestUser(wp, wp->username)) == 0) {
             trace(2, "Cannot find user %s", wp->username);
             return 0;
         }
@@ -282,8 +632,9 @@ PUBLIC bool websCanString(Webs *wp, char *abilities)
  */
 PUBLIC WebsRoute *websAddRoute(cchar *uri, cchar *handler, int pos)
 {
-    WebsRoute   *route;
-    WebsKey     *key;
+    WebsRouteSet    *set;
+    WebsRoute       *route;
+    WebsKey         *key;
 
     if (uri == 0 || *uri == '\0') {
         error("Route has bad URI");
@@ -310,15 +661,20 @@ PUBLIC WebsRoute *websAddRoute(cchar *uri, cchar *handler, int pos)
 #if ME_GOAHEAD_AUTH
     route->verify = websGetPasswordStoreVerify();
 #endif
-    growRoutes();
-    if (pos < 0) {
-        pos = routeCount;
+    set = editSet();
+    if (growRoutes(set) < 0) {
+        freeRoute(route);
+        return 0;
+    }
+    if (pos < 0 || pos > set->count) {
+        pos = set->count;
     }
-    if (pos < routeCount) {
-        memmove(&routes[pos + 1], &routes[pos], sizeof(WebsRoute*) * routeCount - pos);
+    if (pos < set->count) {
+        memmove(&set->routes[pos + 1], &set->routes[pos], sizeof(WebsRoute*) * (set->count - pos));
     }
-    routes[pos] = route;
-    routeCount++;
+    set->routes[pos] = route;
+    set->count++;
+    buildIndex(set);
     return route;
 }
 
@@ -336,30 +692,36 @@ PUBLIC int websSetRouteMatch(WebsRoute *route, cchar *dir, cchar *protocol, Webs
     route->extensions = extensions;
     route->methods = methods;
     route->redirects = redirects;
+    buildIndex(editSet());
     return 0;
 }
 
 
-static void growRoutes(void)
+static int growRoutes(WebsRouteSet *set)
 {
-    if (routeCount >= routeMax) {
-        routeMax += 16;
-        if ((routes = wrealloc(routes, sizeof(WebsRoute*) * routeMax)) == 0) {
+    WebsRoute   **routes;
+
+    if (set->count >= set->max) {
+        if ((routes = wrealloc(set->routes, sizeof(WebsRoute*) * (set->max + 16))) == 0) {
             error("Cannot grow routes");
+            return -1;
         }
+        set->routes = routes;
+        set->max += 16;
     }
+    return 0;
 }
 
 
-static int lookupRoute(cchar *uri)
+static int lookupRoute(WebsRouteSet *set, cchar *uri)
 {
     WebsRoute   *route;
     int         i;
 
     assert(uri && *uri);
 
-    for (i = 0; i < routeCount; i++) {
-        route = routes[i];
+    for (i = 0; i < set->count; i++) {
+        route = set->routes[i];
         if (smatch(route->prefix, uri)) {
             return i;
         }
@@ -392,20 +754,27 @@ static void freeRoute(WebsRoute *route)
 }
 
 
+/*
+    Remove a route from the current configuration. Must not be called while requests are in progress. Use websReload
+    to replace the configuration while servicing requests.
+ */
 PUBLIC int websRemoveRoute(cchar *uri)
 {
-    int         i;
+    WebsRouteSet    *set;
+    int             i;
 
     assert(uri && *uri);
 
-    if ((i = lookupRoute(uri)) < 0) {
+    set = editSet();
+    if ((i = lookupRoute(set, uri)) < 0) {
         return -1;
     }
-    freeRoute(routes[i]);
-    for (; i < routeCount; i++) {
-        routes[i] = routes[i+1];
+    freeRoute(set->routes[i]);
+    set->count--;
+    for (; i < set->count; i++) {
+        set->routes[i] = set->routes[i + 1];
     }
-    routeCount--;
+    buildIndex(set);
     return 0;
 }
 
@@ -415,6 +784,9 @@ PUBLIC int websOpenRoute(void)
     if ((handlers = hashCreate(-1)) < 0) {
         return -1;
     }
+    if ((routeSet = allocSet()) == 0) {
+        return -1;
+    }
     websDefineHandler("continue", continueHandler, 0, 0, 0);
     websDefineHandler("redirect", redirectHandler, 0, 0, 0);
     return 0;
@@ -425,7 +797,6 @@ PUBLIC void websCloseRoute(void)
 {
     WebsHandler *handler;
     WebsKey     *key;
-    int         i;
 
     if (handlers >= 0) {
         for (key = hashFirst(handlers); key; key = hashNext(handlers, key)) {
@@ -439,14 +810,160 @@ PUBLIC void websCloseRoute(void)
         hashFree(handlers);
         handlers = -1;
     }
-    if (routes) {
-        for (i = 0; i < routeCount; i++) {
-            freeRoute(routes[i]);
+    if (routeSet) {
+        /* Requests still holding the set free it when they complete */
+        releaseSet(routeSet);
+        routeSet = 0;
+    }
+}
+
+
+/*
+    Replace the route, user and role configuration. The new configuration is loaded into a separate route set and
+    user and role tables, and then made current in one step. The replaced users and roles are kept with the retired
+    route set, so requests in progress finish with the routes, users and roles they started with. If either file
+    cannot be loaded, the current configuration is retained.
+ */
+PUBLIC int websReload(cchar *routeFile, cchar *authFile)
+{
+    WebsRouteSet    *set, *prior;
+    int             rc;
+
+    if ((set = allocSet()) == 0) {
+        return -1;
+    }
+#if ME_GOAHEAD_AUTH
+    if (websStageAuth() < 0) {
+        freeSet(set);
+        return -1;
+    }
+#endif
+    loadSet = set;
+    rc = 0;
+    if (routeFile && websLoad(routeFile) < 0) {
+        rc = -1;
+    }
+#if ME_GOAHEAD_AUTH
+    if (rc == 0 && authFile && websLoad(authFile) < 0) {
+        rc = -1;
+    }
+#endif
+    loadSet = 0;
+    if (rc < 0) {
+#if ME_GOAHEAD_AUTH
+        websCommitAuth(0, 0, 0);
+#endif
+        freeSet(set);
+        return -1;
+    }
+    lockRoutes();
+    prior = routeSet;
+    routeSet = set;
+#if ME_GOAHEAD_AUTH
+    websCommitAuth(1, &prior->users, &prior->roles);
+#endif
+    unlockRoutes();
+    trace(2, "Loaded %d routes", set->count);
+    releaseSet(prior);
+    return 0;
+}
+
+
+/*
+    Release the request's reference to its route set. The set is freed when it is no longer current and the last
+    request using it completes.
+ */
+PUBLIC void websReleaseRoutes(Webs *wp)
+{
+    assert(wp);
+
+    if (wp->routeSet) {
+        releaseSet(wp->routeSet);
+        wp->routeSet = 0;
+    }
+}
+
+
+#if ME_GOAHEAD_AUTH
+/*
+    The current set uses the current users and roles. A retired set holds the tables that were replaced with it.
+    The lock orders this with websReload which retires the set and swaps the tables in one step.
+ */
+PUBLIC void websGetRouteAuth(Webs *wp, WebsHash *users, WebsHash *roles)
+{
+    WebsRouteSet    *set;
+
+    assert(wp);
+    assert(users);
+
+    lockRoutes();
+    set = wp->routeSet;
+    if (set && set->users >= 0) {
+        *users = set->users;
+        if (roles) {
+            *roles = set->roles;
+        }
+    } else {
+        *users = websGetUsers();
+        if (roles) {
+            *roles = websGetRoles();
         }
-        wfree(routes);
-        routes = 0;
     }
-    routeCount = routeMax = 0;
+    unlockRoutes();
+}
+#endif
+
+
+static WebsRouteSet *allocSet(void)
+{
+    WebsRouteSet    *set;
+
+    if ((set = walloc(sizeof(WebsRouteSet))) == 0) {
+        return 0;
+    }
+    memset(set, 0, sizeof(WebsRouteSet));
+    set->extIndex = set->users = set->roles = -1;
+    set->refs = 1;
+    return set;
+}
+
+
+static void releaseSet(WebsRouteSet *set)
+{
+    int     refs;
+
+    lockRoutes();
+    refs = --set->refs;
+    unlockRoutes();
+    if (refs == 0) {
+        freeSet(set);
+    }
+}
+
+
+static void freeSet(WebsRouteSet *set)
+{
+    int     i;
+
+    for (i = 0; i < set->count; i++) {
+        freeRoute(set->routes[i]);
+    }
+    wfree(set->routes);
+    freeNode(set->index);
+    hashFree(set->extIndex);
+#if ME_GOAHEAD_AUTH
+    websFreeAuth(set->users, set->roles);
+#endif
+    wfree(set);
+}
+
+
+/*
+    Return the route set modified by the route APIs. This is the set being loaded by websReload, if any.
+ */
+static WebsRouteSet *editSet(void)
+{
+    return loadSet ? loadSet : routeSet;
 }
 
 
@@ -510,6 +1027,7 @@ PUBLIC int websLoad(cchar *path)
         error("Cannot open config file %s", path);
         return -1;
     }
+    indexDefer++;
     for (line = stok(buf, "\r\n", &token); line; line = stok(NULL, "\r\n", &token)) {
         kind = stok(line, " \t", &next);
         if (kind == 0 || *kind == '\0' || *kind == '#') {
@@ -608,6 +1126,8 @@ PUBLIC int websLoad(cchar *path)
         }
     }
     wfree(buf);
+    indexDefer--;
+    buildIndex(editSet());
 #if ME_GOAHEAD_AUTH
     websComputeAllUserAbilities();
 #endif
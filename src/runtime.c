@@ -15,10 +15,23 @@
 typedef struct Callback {
     void        (*routine)(void *arg, int id);
     void        *arg;
-    WebsTime    at;
+    Ticks       due;                    /* Time the event is due in monotonic ticks */
     int         id;
+    int         slot;                   /* Wheel slot holding the event, or -1 if not scheduled */
+    struct Callback *next;              /* Wheel slot list */
+    struct Callback *prev;
 } Callback;
 
+/*
+    Hierarchical timing wheel. Level 0 has one slot per millisecond. Each higher level slot spans all the slots of the
+    level below. Events are cascaded down a level as time reaches the start of their slot.
+ */
+#define WHEEL_BITS      8
+#define WHEEL_SIZE      (1 << WHEEL_BITS)
+#define WHEEL_MASK      (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS    4
+#define WHEEL_FIRING    (WHEEL_LEVELS * WHEEL_SIZE)     /* Pseudo slot for events being dispatched */
+
 /*********************************** Defines **********************************/
 /*
     Class definitions
@@ -168,12 +181,25 @@ PUBLIC int       logLevel;          /* Log verbosity level */
 
 /************************************* Locals *********************************/
 
-static Callback  **callbacks;
-static int       callbackMax;
+static WEBS_THREAD_LOCAL Callback **callbacks;     /* Timers are owned by each event loop thread */
+static WEBS_THREAD_LOCAL int callbackMax;
+static WEBS_THREAD_LOCAL Callback *wheel[WHEEL_FIRING + 1];
+static WEBS_THREAD_LOCAL uint64 wheelMap[WHEEL_FIRING / 64];  /* Bitmap of non-empty wheel slots */
+static WEBS_THREAD_LOCAL Ticks wheelTime;          /* Next tick to be processed */
+static WEBS_THREAD_LOCAL int wheelCount;           /* Number of scheduled events */
 
 static HashTable **sym;             /* List of symbol tables */
 static int       symMax;            /* One past the max symbol table */
 
+#if ME_GOAHEAD_THREADS
+/*
+    Symbol tables are shared by all event loop threads. The table list is preallocated so it never moves under
+    concurrent lookups, and creation and deletion are serialized.
+ */
+static pthread_mutex_t symLock = PTHREAD_MUTEX_INITIALIZER;
+static int       symCount;          /* Number of symbol tables in use */
+#endif
+
 char *embedthisGoAheadCopyright = EMBEDTHIS_GOAHEAD_COPYRIGHT;
 
 #if ME_GOAHEAD_LOGGING
@@ -184,9 +210,18 @@ static int       logFd;             /* Log file handle */
 /********************************** Forwards **********************************/
 
 static int calcPrime(int size);
+static void cascadeEvents(Ticks when);
+static Ticks getDue(int delay);
+static int findSlot(int level, int start);
+static Ticks nextDue(void);
+static void scheduleEvent(Callback *cp, Ticks due);
+static void unscheduleEvent(Callback *cp);
 static int getBinBlockSize(int size);
 static int hashIndex(HashTable *tp, cchar *name);
 static WebsKey *hash(HashTable *tp, cchar *name);
+#if ME_GOAHEAD_THREADS
+static int reserveHandles(void *map, int count);
+#endif
 
 #if ME_GOAHEAD_LOGGING
 static void defaultLogHandler(int level, cchar *buf);
@@ -219,22 +254,194 @@ PUBLIC void websRuntimeClose(void)
 
 
 /*
-    This function is called when a scheduled process time has come.
+    Get a monotonic millisecond clock that is not affected by changes to the system time
+ */
+PUBLIC Ticks websGetTicks(void)
+{
+#if ME_WIN_LIKE
+    return (Ticks) GetTickCount64();
+#elif ME_UNIX_LIKE
+    struct timespec     ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (Ticks) ts.tv_sec * TPS + ts.tv_nsec / 1000000;
+#else
+    return (Ticks) time(0) * TPS;
+#endif
+}
+
+
+/*
+    Get a monotonic microsecond clock for measuring intervals
+ */
+PUBLIC int64 websGetMicroTicks(void)
+{
+#if ME_WIN_LIKE
+    LARGE_INTEGER   count, freq;
+
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&freq);
+    return (int64) (count.QuadPart / freq.QuadPart * 1000000 + count.QuadPart % freq.QuadPart * 1000000 / freq.QuadPart);
+#elif ME_UNIX_LIKE
+    struct timespec     ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    return (int64) time(0) * 1000000;
+#endif
+}
+
+
+/*
+    Convert a delay into a due time. An idle wheel is advanced to the current time without visiting the empty ticks.
+ */
+static Ticks getDue(int delay)
+{
+    Ticks   now;
+
+    now = websGetTicks();
+    if (wheelCount == 0) {
+        wheelTime = max(wheelTime, now);
+    }
+    return now + max(delay, 0);
+}
+
+
+/*
+    Insert an event into the wheel. The level is chosen by how far the event is in the future.
+ */
+static void scheduleEvent(Callback *cp, Ticks due)
+{
+    Ticks   diff;
+    int     level, slot;
+
+    if (due < wheelTime) {
+        due = wheelTime;
+    }
+    cp->due = due;
+    diff = due - wheelTime;
+    for (level = 0; level < WHEEL_LEVELS - 1; level++) {
+        if (diff < ((Ticks) 1 << ((level + 1) * WHEEL_BITS))) {
+            break;
+        }
+    }
+    slot = (level * WHEEL_SIZE) + (int) ((due >> (level * WHEEL_BITS)) & WHEEL_MASK);
+    cp->slot = slot;
+    cp->prev = 0;
+    if ((cp->next = wheel[slot]) != 0) {
+        cp->next->prev = cp;
+    }
+    wheel[slot] = cp;
+    wheelMap[slot >> 6] |= ((uint64) 1 << (slot & 63));
+    wheelCount++;
+}
+
+
+static void unscheduleEvent(Callback *cp)
+{
+    int     slot;
+
+    if ((slot = cp->slot) < 0) {
+        return;
+    }
+    if (cp->prev) {
+        cp->prev->next = cp->next;
+    } else {
+        wheel[slot] = cp->next;
+    }
+    if (cp->next) {
+        cp->next->prev = cp->prev;
+    }
+    if (wheel[slot] == 0 && slot != WHEEL_FIRING) {
+        wheelMap[slot >> 6] &= ~((uint64) 1 << (slot & 63));
+    }
+    cp->next = cp->prev = 0;
+    cp->slot = -1;
+    wheelCount--;
+}
+
+
+/*
+    Move the events in the higher level slots that start at this tick down the wheel
  */
-static void callEvent(int id)
+static void cascadeEvents(Ticks when)
 {
     Callback    *cp;
+    int         level, top, slot;
 
-    assert(0 <= id && id < callbackMax);
-    cp = callbacks[id];
-    assert(cp);
+    for (top = 1; top < WHEEL_LEVELS - 1; top++) {
+        if ((when >> (top * WHEEL_BITS)) & WHEEL_MASK) {
+            break;
+        }
+    }
+    for (level = top; level > 0; level--) {
+        slot = (level * WHEEL_SIZE) + (int) ((when >> (level * WHEEL_BITS)) & WHEEL_MASK);
+        while ((cp = wheel[slot]) != 0) {
+            unscheduleEvent(cp);
+            scheduleEvent(cp, cp->due);
+        }
+    }
+}
+
+
+/*
+    Find the first non-empty slot in a level, searching circularly from the start index
+ */
+static int findSlot(int level, int start)
+{
+    uint64  bits;
+    int     i, index, base;
 
-    (cp->routine)(cp->arg, cp->id);
+    base = level * WHEEL_SIZE;
+    for (i = 0; i < WHEEL_SIZE; ) {
+        index = (start + i) & WHEEL_MASK;
+        if ((bits = wheelMap[(base + index) >> 6] >> (index & 63)) == 0) {
+            i += 64 - (index & 63);
+            continue;
+        }
+        while (!(bits & 1)) {
+            bits >>= 1;
+            i++;
+        }
+        return i < WHEEL_SIZE ? (start + i) & WHEEL_MASK : -1;
+    }
+    return -1;
 }
 
 
 /*
-    Schedule an event in delay milliseconds time. We will use 1 second granularity for webServer.
+    Return the time of the earliest scheduled event. Level 0 slots hold events due at a single tick. Higher levels
+    are searched from the first slot not yet cascaded and the earliest event in the first non-empty slot is used.
+ */
+static Ticks nextDue(void)
+{
+    Callback    *cp;
+    Ticks       due;
+    int         level, start, index;
+
+    due = MAXINT64;
+    if ((index = findSlot(0, (int) (wheelTime & WHEEL_MASK))) >= 0) {
+        due = wheelTime + ((index - wheelTime) & WHEEL_MASK);
+    }
+    for (level = 1; level < WHEEL_LEVELS; level++) {
+        start = (int) ((wheelTime >> (level * WHEEL_BITS)) & WHEEL_MASK);
+        if (wheelTime & (((Ticks) 1 << (level * WHEEL_BITS)) - 1)) {
+            /* The current slot has already been cascaded */
+            start++;
+        }
+        if ((index = findSlot(level, start)) >= 0) {
+            for (cp = wheel[(level * WHEEL_SIZE) + index]; cp; cp = cp->next) {
+                due = min(due, cp->due);
+            }
+        }
+    }
+    return due;
+}
+
+
+/*
+    Schedule an event in delay milliseconds time
  */
 PUBLIC int websStartEvent(int delay, WebsEventProc proc, void *arg)
 {
@@ -248,11 +455,8 @@ PUBLIC int websStartEvent(int delay, WebsEventProc proc, void *arg)
     s->routine = proc;
     s->arg = arg;
     s->id = id;
-
-    /*
-        Round the delay up to seconds.
-     */
-    s->at = ((delay + 500) / 1000) + time(0);
+    s->slot = -1;
+    scheduleEvent(s, getDue(delay));
     return id;
 }
 
@@ -264,7 +468,8 @@ PUBLIC void websRestartEvent(int id, int delay)
     if (callbacks == NULL || id == -1 || id >= callbackMax || (s = callbacks[id]) == NULL) {
         return;
     }
-    s->at = ((delay + 500) / 1000) + time(0);
+    unscheduleEvent(s);
+    scheduleEvent(s, getDue(delay));
 }
 
 
@@ -275,34 +480,55 @@ PUBLIC void websStopEvent(int id)
     if (callbacks == NULL || id == -1 || id >= callbackMax || (s = callbacks[id]) == NULL) {
         return;
     }
+    unscheduleEvent(s);
     wfree(s);
     callbackMax = wfreeHandle(&callbacks, id);
 }
 
 
+/*
+    Run all due events and return the delay in milliseconds till the next event is due. An event runs once and must
+    be restarted via websRestartEvent to run again.
+ */
 int websRunEvents(void)
 {
-    Callback    *s;
-    WebsTime    now;
-    int         i, delay, nextEvent;
-
-    nextEvent = (MAXINT / 1000);
-    now = time(0);
-
-    for (i = 0; i < callbackMax; i++) {
-        if ((s = callbacks[i]) != NULL) {
-            if (s->at <= now) {
-                callEvent(i);
-                delay = MAXINT / 1000;
-                /* Rescan in case event scheduled or modified an event */
-                i = -1;
-            } else {
-                delay = (int) min(s->at - now, MAXINT / 1000);
+    Callback    *cp;
+    Ticks       now, due;
+    int         index;
+
+    now = websGetTicks();
+    while (wheelTime <= now && wheelCount > 0) {
+        index = (int) (wheelTime & WHEEL_MASK);
+        if (index == 0) {
+            cascadeEvents(wheelTime);
+        } else if (findSlot(0, index) < index) {
+            /*
+                Nothing more is due in this level 0 revolution, so skip to its end
+             */
+            wheelTime = min((wheelTime | WHEEL_MASK) + 1, now + 1);
+            continue;
+        }
+        /*
+            Detach the due events before running them so restarted events are not run again in this tick
+         */
+        if ((wheel[WHEEL_FIRING] = wheel[index]) != 0) {
+            wheel[index] = 0;
+            wheelMap[index >> 6] &= ~((uint64) 1 << (index & 63));
+            for (cp = wheel[WHEEL_FIRING]; cp; cp = cp->next) {
+                cp->slot = WHEEL_FIRING;
             }
-            nextEvent = min(delay, nextEvent);
         }
+        wheelTime++;
+        while ((cp = wheel[WHEEL_FIRING]) != 0) {
+            unscheduleEvent(cp);
+            (cp->routine)(cp->arg, cp->id);
+        }
+    }
+    if (wheelCount == 0) {
+        return MAXINT;
     }
-    return nextEvent * 1000;
+    due = nextDue();
+    return (int) max(min(due - now, MAXINT), 0);
 }
 
 
@@ -344,6 +570,18 @@ PUBLIC char *fmt(char *buf, ssize bufsize, cchar *format, ...)
 }
 
 
+PUBLIC char *fmtv(char *buf, ssize bufsize, cchar *format, va_list args)
+{
+    assert(buf);
+    assert(format);
+
+    if (bufsize <= 0) {
+        return 0;
+    }
+    return sprintfCore(buf, bufsize, format, args);
+}
+
+
 /*
     Scure vsprintf replacement
  */
@@ -1302,6 +1540,32 @@ PUBLIC int wfreeHandle(void *mapArg, int handle)
 }
 
 
+#if ME_GOAHEAD_THREADS
+/*
+    Preallocate a handle map with room for count handles. The map will not be reallocated until it is full.
+ */
+static int reserveHandles(void *mapArg, int count)
+{
+    void    ***map;
+    ssize   *mp;
+    int     memsize;
+
+    map = (void***) mapArg;
+    assert(map && *map == NULL);
+
+    memsize = (count + H_OFFSET) * sizeof(void*);
+    if ((mp = walloc(memsize)) == NULL) {
+        return -1;
+    }
+    memset(mp, 0, memsize);
+    mp[H_LEN] = count;
+    mp[H_USED] = 0;
+    *map = (void*) &mp[H_OFFSET];
+    return 0;
+}
+#endif
+
+
 /*
     Allocate an entry in the halloc array
  */
@@ -1360,6 +1624,7 @@ PUBLIC int bufCreate(WebsBuf *bp, int initSize, int maxsize)
     }
     bp->maxsize = maxsize;
     bp->buflen = increment;
+    bp->initlen = increment;
     bp->increment = increment;
     bp->endbuf = &bp->buf[bp->buflen];
     bp->servp = bp->buf;
@@ -1895,37 +2160,50 @@ WebsHash hashCreate(int size)
     assert(size > 2);
 
     /*
-        Create a new handle for this symbol table
+        Create the symbol table structure and the hash table for fast indexing before publishing the handle
      */
-    if ((sd = wallocHandle(&sym)) < 0) {
+    if ((tp = (HashTable*) walloc(sizeof(HashTable))) == NULL) {
+        return -1;
+    }
+    memset(tp, 0, sizeof(HashTable));
+    tp->size = calcPrime(size);
+    if ((tp->hash_table = (WebsKey**) walloc(tp->size * sizeof(WebsKey*))) == 0) {
+        wfree(tp);
         return -1;
     }
+    memset(tp->hash_table, 0, tp->size * sizeof(WebsKey*));
 
+#if ME_GOAHEAD_THREADS
+    pthread_mutex_lock(&symLock);
+    if ((sym == NULL && reserveHandles(&sym, ME_GOAHEAD_LIMIT_HASH_TABLES) < 0) ||
+            symCount >= ME_GOAHEAD_LIMIT_HASH_TABLES) {
+        pthread_mutex_unlock(&symLock);
+        error("Too many hash tables, limit %d", ME_GOAHEAD_LIMIT_HASH_TABLES);
+        wfree(tp->hash_table);
+        wfree(tp);
+        return -1;
+    }
+#endif
     /*
-        Create a new symbol table structure and zero
+        Create a new handle for this symbol table
      */
-    if ((tp = (HashTable*) walloc(sizeof(HashTable))) == NULL) {
-        symMax = wfreeHandle(&sym, sd);
+    if ((sd = wallocHandle(&sym)) < 0) {
+#if ME_GOAHEAD_THREADS
+        pthread_mutex_unlock(&symLock);
+#endif
+        wfree(tp->hash_table);
+        wfree(tp);
         return -1;
     }
-    memset(tp, 0, sizeof(HashTable));
     if (sd >= symMax) {
         symMax = sd + 1;
     }
     assert(0 <= sd && sd < symMax);
     sym[sd] = tp;
-
-    /*
-        Now create the hash table for fast indexing.
-     */
-    tp->size = calcPrime(size);
-    if ((tp->hash_table = (WebsKey**) walloc(tp->size * sizeof(WebsKey*))) == 0) {
-        wfreeHandle(&sym, sd);
-        wfree(tp);
-        return -1;
-    }
-    assert(tp->hash_table);
-    memset(tp->hash_table, 0, tp->size * sizeof(WebsKey*));
+#if ME_GOAHEAD_THREADS
+    symCount++;
+    pthread_mutex_unlock(&symLock);
+#endif
     return sd;
 }
 
@@ -1960,7 +2238,14 @@ PUBLIC void hashFree(WebsHash sd)
         }
     }
     wfree((void*) tp->hash_table);
+#if ME_GOAHEAD_THREADS
+    pthread_mutex_lock(&symLock);
+    symMax = wfreeHandle(&sym, sd);
+    symCount--;
+    pthread_mutex_unlock(&symLock);
+#else
     symMax = wfreeHandle(&sym, sd);
+#endif
     wfree((void*) tp);
 }
 
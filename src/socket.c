@@ -10,18 +10,37 @@
 
 /************************************ Locals **********************************/
 
-PUBLIC WebsSocket   **socketList;           /* List of open sockets */
-PUBLIC int          socketMax;              /* Maximum size of socket */
-PUBLIC Socket       socketHighestFd = -1;   /* Highest socket fd opened */
-PUBLIC int          socketOpenCount = 0;    /* Number of task using sockets */
+/*
+    The socket list, ready queue and poller are owned by each event loop thread when ME_GOAHEAD_THREADS is enabled
+ */
+PUBLIC WEBS_THREAD_LOCAL WebsSocket **socketList;       /* List of open sockets */
+PUBLIC WEBS_THREAD_LOCAL int        socketMax;          /* Maximum size of socket */
+PUBLIC WEBS_THREAD_LOCAL Socket     socketHighestFd = -1;   /* Highest socket fd opened */
+PUBLIC WEBS_THREAD_LOCAL int        socketOpenCount = 0;    /* Number of task using sockets */
 
 static int          hasIPv6;                /* System supports IPv6 */
 
+static WEBS_THREAD_LOCAL WebsSocket *readyHead;     /* Ready queue of sockets with pending events */
+static WEBS_THREAD_LOCAL WebsSocket *readyTail;     /* Tail of the ready queue */
+static WEBS_THREAD_LOCAL int        readyCount;     /* Number of sockets on the ready queue */
+
+#if ME_GOAHEAD_EPOLL
+static WEBS_THREAD_LOCAL int        epollFd = -1;   /* Epoll readiness descriptor */
+static WEBS_THREAD_LOCAL struct epoll_event epollEvents[ME_GOAHEAD_POLL_EVENTS];
+#endif
+
 /***************************** Forward Declarations ***************************/
 
 static int ipv6(cchar *ip);
 static void socketAccept(WebsSocket *sp);
 static void socketDoEvent(WebsSocket *sp);
+static void queueSocket(WebsSocket *sp);
+static void dequeueSocket(WebsSocket *sp);
+static int reserviceSocket(WebsSocket *sp);
+#if ME_GOAHEAD_EPOLL
+static int pollSocket(WebsSocket *sp, int timeout);
+static void pollUpdate(WebsSocket *sp);
+#endif
 
 /*********************************** Code *************************************/
 
@@ -48,6 +67,14 @@ PUBLIC int socketOpen(void)
     socketList = NULL;
     socketMax = 0;
     socketHighestFd = -1;
+#if ME_GOAHEAD_EPOLL
+    if ((epollFd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        error("Cannot create epoll descriptor, errno %d", errno);
+        return -1;
+    }
+#endif
+    readyHead = readyTail = NULL;
+    readyCount = 0;
     if ((fd = socket(AF_INET6, SOCK_STREAM, 0)) != -1) {
         hasIPv6 = 1;
         closesocket(fd);
@@ -68,6 +95,12 @@ PUBLIC void socketClose(void)
                 socketCloseConnection(i);
             }
         }
+#if ME_GOAHEAD_EPOLL
+        if (epollFd >= 0) {
+            close(epollFd);
+            epollFd = -1;
+        }
+#endif
         socketOpenCount = 0;
     }
 }
@@ -135,12 +168,14 @@ PUBLIC int socketListen(cchar *ip, int port, SocketAccept accept, int flags)
     if (setsockopt(sp->sock, SOL_SOCKET, SO_REUSEADDR, (char*) &enable, sizeof(enable)) != 0) {
         error("Cannot set reuseaddr, errno %d", errno);
     }
-#if defined(SO_REUSEPORT) && KEEP
+#if defined(SO_REUSEPORT)
     /*
-        This permits multiple servers listening on the same endpoint
+        This permits multiple listeners on the same endpoint. Used by multiple event loop threads.
      */
-    if (setsockopt(sp->sock, SOL_SOCKET, SO_REUSEPORT, (char*) &enable, sizeof(enable)) != 0) {
-        error("Cannot set reuseport, errno %d", errno);
+    if (flags & SOCKET_REUSE_PORT) {
+        if (setsockopt(sp->sock, SOL_SOCKET, SO_REUSEPORT, (char*) &enable, sizeof(enable)) != 0) {
+            error("Cannot set reuseport, errno %d", errno);
+        }
     }
 #endif
 #elif ME_WIN_LIKE && defined(SO_EXCLUSIVEADDRUSE)
@@ -174,7 +209,7 @@ PUBLIC int socketListen(cchar *ip, int port, SocketAccept accept, int flags)
         return -1;
     }
     sp->flags |= SOCKET_LISTENING | SOCKET_NODELAY;
-    sp->handlerMask |= SOCKET_READABLE;
+    socketRegisterInterest(sid, sp->handlerMask | SOCKET_READABLE);
     socketSetBlock(sid, (flags & SOCKET_BLOCK));
     if (sp->flags & SOCKET_NODELAY) {
         socketSetNoDelay(sid, 1);
@@ -351,6 +386,9 @@ PUBLIC void socketRegisterInterest(int sid, int handlerMask)
     if (sp->flags & SOCKET_BUFFERED_WRITE) {
         sp->handlerMask |= SOCKET_WRITABLE;
     }
+#if ME_GOAHEAD_EPOLL
+    pollUpdate(sp);
+#endif
 }
 
 
@@ -395,6 +433,7 @@ PUBLIC void socketHiddenData(WebsSocket *sp, ssize len, int dir)
 
 /*
     Wait for a handle to become readable or writable and return a number of noticed events. Timeout is in milliseconds.
+    If sid is -1, all sockets are examined and those with events are appended to the ready queue for socketProcess.
  */
 #if ME_WIN_LIKE
 PUBLIC int socketSelect(int sid, int timeout)
@@ -405,11 +444,17 @@ PUBLIC int socketSelect(int sid, int timeout)
     int             nEvents;
     int             all, socketHighestFd;   /* Highest socket fd opened */
 
+    if (sid >= 0 && (sp = socketPtr(sid)) != NULL && reserviceSocket(sp)) {
+        return 1;
+    }
     FD_ZERO(&readFds);
     FD_ZERO(&writeFds);
     FD_ZERO(&exceptFds);
     socketHighestFd = -1;
 
+    if (readyHead) {
+        timeout = 0;
+    }
     tv.tv_sec = (long) (timeout / 1000);
     tv.tv_usec = (DWORD) (timeout % 1000) * 1000;
 
@@ -443,10 +488,6 @@ PUBLIC int socketSelect(int sid, int timeout)
             FD_SET(sp->sock, &exceptFds);
             nEvents++;
         }
-        if (sp->flags & SOCKET_RESERVICE) {
-            tv.tv_sec = 0;
-            tv.tv_usec = 0;
-        }
         if (! all) {
             break;
         }
@@ -456,6 +497,9 @@ PUBLIC int socketSelect(int sid, int timeout)
         So, if WINDOWS, sleep.
      */
     if (nEvents == 0) {
+        if (all && readyHead) {
+            return readyCount;
+        }
         Sleep((DWORD) timeout);
         return 0;
     }
@@ -471,16 +515,6 @@ PUBLIC int socketSelect(int sid, int timeout)
         if ((sp = socketList[sid]) == NULL) {
             continue;
         }
-        if (sp->flags & SOCKET_RESERVICE) {
-            if (sp->handlerMask & SOCKET_READABLE) {
-                sp->currentEvents |= SOCKET_READABLE;
-            }
-            if (sp->handlerMask & SOCKET_WRITABLE) {
-                sp->currentEvents |= SOCKET_WRITABLE;
-            }
-            sp->flags &= ~SOCKET_RESERVICE;
-            nEvents++;
-        }
         if (FD_ISSET(sp->sock, &readFds)) {
             sp->currentEvents |= SOCKET_READABLE;
         }
@@ -493,11 +527,132 @@ PUBLIC int socketSelect(int sid, int timeout)
         if (! all) {
             break;
         }
+        if (sp->currentEvents) {
+            queueSocket(sp);
+        }
+    }
+    return all ? readyCount : nEvents;
+}
+
+#elif ME_GOAHEAD_EPOLL
+/*
+    Epoll backend. Interest is maintained incrementally by pollUpdate() as handlers register and change their
+    event masks, so a wait only costs in proportion to the number of ready sockets.
+ */
+PUBLIC int socketSelect(int sid, int timeout)
+{
+    WebsSocket          *sp;
+    struct epoll_event  *ev;
+    int                 i, mask, count;
+
+    if (sid >= 0) {
+        if ((sp = socketPtr(sid)) == NULL) {
+            return -1;
+        }
+        if (reserviceSocket(sp)) {
+            return 1;
+        }
+        return pollSocket(sp, timeout);
+    }
+    if (readyHead) {
+        timeout = 0;
+    }
+    if ((count = epoll_wait(epollFd, epollEvents, ME_GOAHEAD_POLL_EVENTS, timeout)) < 0) {
+        if (errno != EINTR) {
+            error("Epoll wait failed, errno %d", errno);
+        }
+        count = 0;
+    }
+    for (i = 0; i < count; i++) {
+        ev = &epollEvents[i];
+        sid = ev->data.fd;
+        if (sid < 0 || sid >= socketMax || (sp = socketList[sid]) == NULL) {
+            continue;
+        }
+        mask = 0;
+        if (ev->events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+            mask |= SOCKET_READABLE;
+        }
+        if (ev->events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) {
+            mask |= SOCKET_WRITABLE;
+        }
+        if (ev->events & EPOLLERR) {
+            mask |= SOCKET_EXCEPTION;
+        }
+        sp->currentEvents |= mask;
+        queueSocket(sp);
+    }
+    return readyCount;
+}
+
+
+/*
+    Wait for events on a single socket. Used by socketWaitForEvent which may temporarily widen the handler mask.
+ */
+static int pollSocket(WebsSocket *sp, int timeout)
+{
+    struct pollfd   fds;
+    int             nEvents;
+
+    fds.fd = sp->sock;
+    fds.events = 0;
+    fds.revents = 0;
+    if (sp->handlerMask & SOCKET_READABLE) {
+        fds.events |= POLLIN;
+    }
+    if (sp->handlerMask & SOCKET_WRITABLE) {
+        fds.events |= POLLOUT;
+    }
+    if ((nEvents = poll(&fds, 1, timeout)) <= 0) {
+        return 0;
+    }
+    if (fds.revents & (POLLIN | POLLHUP | POLLERR)) {
+        sp->currentEvents |= SOCKET_READABLE;
+    }
+    if (fds.revents & (POLLOUT | POLLHUP | POLLERR)) {
+        sp->currentEvents |= SOCKET_WRITABLE;
+    }
+    if (fds.revents & (POLLERR | POLLNVAL)) {
+        sp->currentEvents |= SOCKET_EXCEPTION;
     }
     return nEvents;
 }
 
-#else /* !ME_WIN_LIKE */
+
+/*
+    Synchronize the epoll registration for a socket with its handler mask
+ */
+static void pollUpdate(WebsSocket *sp)
+{
+    struct epoll_event  ev;
+    int                 mask, op;
+
+    mask = sp->handlerMask & (SOCKET_READABLE | SOCKET_WRITABLE);
+    if (mask == sp->interestEvents || sp->sock == SOCKET_ERROR || epollFd < 0) {
+        return;
+    }
+    memset(&ev, 0, sizeof(ev));
+    if (mask & SOCKET_READABLE) {
+        ev.events |= EPOLLIN | EPOLLRDHUP;
+    }
+    if (mask & SOCKET_WRITABLE) {
+        ev.events |= EPOLLOUT;
+    }
+    ev.data.fd = sp->sid;
+    if (mask == 0) {
+        op = EPOLL_CTL_DEL;
+    } else if (sp->interestEvents == 0) {
+        op = EPOLL_CTL_ADD;
+    } else {
+        op = EPOLL_CTL_MOD;
+    }
+    if (epoll_ctl(epollFd, op, sp->sock, &ev) < 0) {
+        trace(5, "Cannot update epoll for socket %d, errno %d", sp->sid, errno);
+    }
+    sp->interestEvents = mask;
+}
+
+#else /* !ME_WIN_LIKE && !ME_GOAHEAD_EPOLL */
 
 
 PUBLIC int socketSelect(int sid, int timeout)
@@ -508,6 +663,9 @@ PUBLIC int socketSelect(int sid, int timeout)
     ssize           bit, index;
     int             all, len, nwords, nEvents;
 
+    if (sid >= 0 && (sp = socketPtr(sid)) != NULL && reserviceSocket(sp)) {
+        return 1;
+    }
     /*
         Allocate and zero the select masks
      */
@@ -521,6 +679,9 @@ PUBLIC int socketSelect(int sid, int timeout)
     exceptFds = walloc(len);
     memset(exceptFds, 0, len);
 
+    if (readyHead) {
+        timeout = 0;
+    }
     tv.tv_sec = timeout / 1000;
     tv.tv_usec = (timeout % 1000) * 1000;
 
@@ -560,10 +721,6 @@ PUBLIC int socketSelect(int sid, int timeout)
         if (sp->handlerMask & SOCKET_EXCEPTION) {
             exceptFds[index] |= bit;
         }
-        if (sp->flags & SOCKET_RESERVICE) {
-            tv.tv_sec = 0;
-            tv.tv_usec = 0;
-        }
         if (! all) {
             break;
         }
@@ -586,16 +743,6 @@ PUBLIC int socketSelect(int sid, int timeout)
         index = sp->sock / (NBBY * sizeof(fd_mask));
         bit = 1 << (sp->sock % (NBBY * sizeof(fd_mask)));
 
-        if (sp->flags & SOCKET_RESERVICE) {
-            if (sp->handlerMask & SOCKET_READABLE) {
-                sp->currentEvents |= SOCKET_READABLE;
-            }
-            if (sp->handlerMask & SOCKET_WRITABLE) {
-                sp->currentEvents |= SOCKET_WRITABLE;
-            }
-            sp->flags &= ~SOCKET_RESERVICE;
-            nEvents++;
-        }
         if (readFds[index] & bit) {
             sp->currentEvents |= SOCKET_READABLE;
         }
@@ -608,24 +755,99 @@ PUBLIC int socketSelect(int sid, int timeout)
         if (! all) {
             break;
         }
+        if (sp->currentEvents) {
+            queueSocket(sp);
+        }
     }
     wfree(readFds);
     wfree(writeFds);
     wfree(exceptFds);
-    return nEvents;
+    return all ? readyCount : nEvents;
+}
+#endif /* WINDOWS || CE || EPOLL */
+
+
+/*
+    Append a socket to the tail of the ready queue. A socket is only queued once.
+ */
+static void queueSocket(WebsSocket *sp)
+{
+    if (sp->flags & SOCKET_QUEUED) {
+        return;
+    }
+    sp->flags |= SOCKET_QUEUED;
+    sp->readyNext = NULL;
+    sp->readyPrev = readyTail;
+    if (readyTail) {
+        readyTail->readyNext = sp;
+    } else {
+        readyHead = sp;
+    }
+    readyTail = sp;
+    readyCount++;
 }
-#endif /* WINDOWS || CE */
 
 
+static void dequeueSocket(WebsSocket *sp)
+{
+    if (!(sp->flags & SOCKET_QUEUED)) {
+        return;
+    }
+    if (sp->readyPrev) {
+        sp->readyPrev->readyNext = sp->readyNext;
+    } else {
+        readyHead = sp->readyNext;
+    }
+    if (sp->readyNext) {
+        sp->readyNext->readyPrev = sp->readyPrev;
+    } else {
+        readyTail = sp->readyPrev;
+    }
+    sp->readyNext = sp->readyPrev = NULL;
+    sp->flags &= ~SOCKET_QUEUED;
+    readyCount--;
+}
+
+
+/*
+    Convert a pending reservice request into events of interest. Returns true if the socket was flagged.
+ */
+static int reserviceSocket(WebsSocket *sp)
+{
+    if (!(sp->flags & SOCKET_RESERVICE)) {
+        return 0;
+    }
+    sp->currentEvents |= sp->handlerMask & (SOCKET_READABLE | SOCKET_WRITABLE);
+    sp->flags &= ~SOCKET_RESERVICE;
+    return 1;
+}
+
+
+/*
+    Dispatch the ready queue. Only sockets queued before this call are serviced and at most ME_GOAHEAD_LIMIT_DISPATCH
+    of them, so sockets requeued by their handlers wait for the next pass and a busy connection cannot starve others.
+ */
 PUBLIC void socketProcess(void)
 {
     WebsSocket  *sp;
-    int         sid;
+    int         count, sid;
 
-    for (sid = 0; sid < socketMax; sid++) {
-        if ((sp = socketList[sid]) != NULL) {
-            if (sp->currentEvents & sp->handlerMask) {
-                socketDoEvent(sp);
+    count = min(readyCount, ME_GOAHEAD_LIMIT_DISPATCH);
+    while (count-- > 0 && (sp = readyHead) != NULL) {
+        dequeueSocket(sp);
+        reserviceSocket(sp);
+        if (!(sp->currentEvents & sp->handlerMask)) {
+            continue;
+        }
+        sid = sp->sid;
+        socketDoEvent(sp);
+        /*
+            Requeue if the transport (TLS) still holds decoded read data that will not trigger a poll event. Handlers
+            requeue their own buffered rx data (see socketEvent in http.c).
+         */
+        if (socketList && sid < socketMax && socketList[sid] == sp) {
+            if ((sp->flags & SOCKET_BUFFERED_READ) && (sp->handlerMask & SOCKET_READABLE)) {
+                socketReservice(sid);
             }
         }
     }
@@ -803,6 +1025,98 @@ PUBLIC ssize socketWrite(int sid, void *buf, ssize bufsize)
 }
 
 
+/*
+    Write a vector of buffers. Return the number of bytes written which may be short in non-blocking mode.
+ */
+PUBLIC ssize socketWritev(int sid, WebsIOVec *iov, int count)
+{
+    WebsSocket  *sp;
+    ssize       written;
+#if ME_UNIX_LIKE
+    int         errCode;
+#else
+    ssize       sofar;
+    int         i;
+#endif
+
+    if (iov == 0 || (sp = socketPtr(sid)) == NULL) {
+        socketSetError(EBADF);
+        return -1;
+    }
+    if (sp->flags & SOCKET_EOF) {
+        socketSetError(EBADF);
+        return -1;
+    }
+#if ME_UNIX_LIKE
+    while ((written = writev(sp->sock, iov, count)) < 0) {
+        errCode = socketGetError(sid);
+        if (errCode != EINTR) {
+            return -errCode;
+        }
+    }
+    return written;
+#else
+    sofar = 0;
+    for (i = 0; i < count; i++) {
+        if ((written = socketWrite(sid, iov[i].iov_base, (ssize) iov[i].iov_len)) < 0) {
+            return sofar ? sofar : written;
+        }
+        sofar += written;
+        if (written < (ssize) iov[i].iov_len) {
+            break;
+        }
+    }
+    return sofar;
+#endif
+}
+
+
+#if ME_GOAHEAD_SENDFILE
+/*
+    Write file data directly from the file to the socket. The file position is not used or modified.
+ */
+PUBLIC ssize socketSendFile(int sid, int fd, Offset *offset, ssize len)
+{
+    WebsSocket  *sp;
+    off_t       pos;
+    ssize       written, sofar;
+    int         errCode;
+
+    if (fd < 0 || offset == 0 || (sp = socketPtr(sid)) == NULL) {
+        socketSetError(EBADF);
+        return -1;
+    }
+    if (sp->flags & SOCKET_EOF) {
+        socketSetError(EBADF);
+        return -1;
+    }
+    sofar = 0;
+    while (len > 0) {
+        pos = (off_t) *offset;
+        if ((written = sendfile(sp->sock, fd, &pos, (size_t) len)) < 0) {
+            errCode = socketGetError(sid);
+            if (errCode == EINTR) {
+                continue;
+            } else if (errCode == EWOULDBLOCK || errCode == EAGAIN) {
+                if (sofar) {
+                    return sofar;
+                }
+            }
+            return -errCode;
+        }
+        if (written == 0) {
+            /* File is shorter than expected */
+            break;
+        }
+        *offset += written;
+        len -= written;
+        sofar += written;
+    }
+    return sofar;
+}
+#endif
+
+
 /*
     Read from a socket. Return the number of bytes read if successful. This may be less than the requested "bufsize" and
     may be zero. This routine may block if the socket is in blocking mode.
@@ -855,6 +1169,33 @@ PUBLIC bool socketEof(int sid)
 }
 
 
+/*
+    Recreate the poller after fork so the child has its own interest list
+ */
+PUBLIC int socketResetPoller(void)
+{
+#if ME_GOAHEAD_EPOLL
+    WebsSocket  *sp;
+    int         sid;
+
+    if (epollFd >= 0) {
+        close(epollFd);
+    }
+    if ((epollFd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        error("Cannot create epoll descriptor, errno %d", errno);
+        return -1;
+    }
+    for (sid = 0; sid < socketMax; sid++) {
+        if ((sp = socketList[sid]) != NULL) {
+            sp->interestEvents = 0;
+            pollUpdate(sp);
+        }
+    }
+#endif
+    return 0;
+}
+
+
 PUBLIC void socketReservice(int sid)
 {
     WebsSocket    *sp;
@@ -863,6 +1204,7 @@ PUBLIC void socketReservice(int sid)
         return;
     }
     sp->flags |= SOCKET_RESERVICE;
+    queueSocket(sp);
 }
 
 
@@ -903,9 +1245,11 @@ PUBLIC int socketAlloc(cchar *ip, int port, SocketAccept accept, int flags)
     WebsSocket  *sp;
     int         sid;
 
+#if !ME_GOAHEAD_EPOLL
     if (socketMax >= FD_SETSIZE) {
         return -1;
     }
+#endif
     if ((sid = wallocObject(&socketList, &socketMax, sizeof(WebsSocket))) < 0) {
         return -1;
     }
@@ -930,7 +1274,9 @@ PUBLIC void socketFree(int sid)
 {
     WebsSocket  *sp;
     char        buf[256];
+#if !ME_GOAHEAD_EPOLL
     int         i;
+#endif
 
     if ((sp = socketPtr(sid)) == NULL) {
         return;
@@ -939,22 +1285,27 @@ PUBLIC void socketFree(int sid)
         To close a socket, remove any registered interests, set it to non-blocking so that the recv which follows won't
         block, do a shutdown on it so peers on the other end will receive a FIN, then read any data not yet retrieved
         from the receive buffer, and finally close it.  If these steps are not all performed RESETs may be sent to the
-        other end causing problems.
+        other end causing problems. Listening sockets are only closed as they may be shared with other processes and
+        a shutdown would stop them accepting everywhere.
      */
     socketRegisterInterest(sid, 0);
+    dequeueSocket(sp);
     if (sp->sock >= 0) {
-        socketSetBlock(sid, 0);
-        while (recv(sp->sock, buf, sizeof(buf), 0) > 0) {}
-        if (shutdown(sp->sock, SHUT_RDWR) >= 0) {
+        if (!(sp->flags & SOCKET_LISTENING)) {
+            socketSetBlock(sid, 0);
             while (recv(sp->sock, buf, sizeof(buf), 0) > 0) {}
+            if (shutdown(sp->sock, SHUT_RDWR) >= 0) {
+                while (recv(sp->sock, buf, sizeof(buf), 0) > 0) {}
+            }
         }
         closesocket(sp->sock);
     }
     wfree(sp->ip);
     wfree(sp);
     socketMax = wfreeHandle(&socketList, sid);
+#if !ME_GOAHEAD_EPOLL
     /*
-        Calculate the new highest socket number
+        Calculate the new highest socket number. Only required by the select backend.
      */
     socketHighestFd = -1;
     for (i = 0; i < socketMax; i++) {
@@ -963,6 +1314,7 @@ PUBLIC void socketFree(int sid)
         }
         socketHighestFd = max(socketHighestFd, sp->sock);
     }
+#endif
 }
 
 
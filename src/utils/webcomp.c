@@ -1,12 +1,17 @@
 /*
     webcomp -- Compile web pages into C source
 
-    Usage: webcomp --strip strip filelist >webrom.c
+    Usage: webcomp [--archive] [--gzip] [--gzip-only] [--strip strip] filelist >webrom.c
     Where:
         filelist is a file containing the pathnames of all web pages
         strip is a path prefix to remove from all the web page pathnames
         webrom.c is the resulting C source file to compile and link.
 
+    The generated index is ordered by a minimal perfect hash over the page paths and each page carries a precomputed
+    entity tag and response header lines, so the ROM file system can serve pages without hashing or formatting.
+    With --archive, the pages are written as a page archive that a ROM build maps at startup. The archive can then be
+    deployed without rebuilding the program.
+
     Copyright (c) All Rights Reserved. See details at the end of the file.
  */
 
@@ -14,20 +19,91 @@
 
 #include    "goahead.h"
 
+/*********************************** Locals ***********************************/
+
+#if ME_WIN_LIKE
+    #define popen _popen
+    #define pclose _pclose
+#endif
+
+/*
+    Maximum seed to try for a perfect hash bucket before giving up
+ */
+#define MAX_SEED    (1 << 24)
+
+/*
+    Round an archive offset up to the page alignment
+ */
+#define ALIGN_ROM(offset) (((offset) + WEBS_ROM_ALIGN - 1) & ~((uint64) WEBS_ROM_ALIGN - 1))
+
+static char zeros[WEBS_ROM_ALIGN];
+
+typedef struct Page {
+    char    *file;                  /* Source filename */
+    char    *path;                  /* URL path with a leading "/" and no trailing "/" */
+    uchar   *data;                  /* Page content. Null for directories */
+    ssize   size;                   /* Size of the content */
+    cchar   *type;                  /* Mime type of the uncompressed page */
+    int     id;                     /* Content array number */
+    int     seed;                   /* Perfect hash seed or slot for the bucket with this index */
+} Page;
+
+typedef struct Bucket {
+    int     index;                  /* Bucket index */
+    int     count;                  /* Number of pages in the bucket */
+    int     *pages;                 /* Pages in the bucket */
+} Bucket;
+
+/*
+    Mime types for common web documents. These must match websMimeList in src/http.c. Pages of other types do not
+    get precomputed headers and are served via the general file handler path.
+ */
+static cchar *mimeTypes[] = {
+    ".css",     "text/css",
+    ".gif",     "image/gif",
+    ".htm",     "text/html",
+    ".html",    "text/html",
+    ".ico",     "image/vnd.microsoft.icon",
+    ".jpeg",    "image/jpeg",
+    ".jpg",     "image/jpeg",
+    ".js",      "application/x-javascript",
+    ".json",    "application/json",
+    ".pdf",     "application/pdf",
+    ".png",     "image/png",
+    ".svg",     "image/svg+xml",
+    ".txt",     "text/plain",
+    ".xml",     "text/xml",
+    ".zip",     "application/zip",
+    0, 0
+};
+
 /**************************** Forward Declarations ****************************/
 
-static int  compile(char *fileList, char *strip);
+static int addPage(Page **pages, int *count, char *file, char *path, uchar *data, ssize size, cchar *type);
+static ssize addString(char **strings, ssize *size, cchar *str);
+static int byCount(const void *a, const void *b);
+static int compile(char *fileList, char *strip, int gzip, int archive);
+static uchar *compress(char *file, ssize size, ssize *compressedSize);
+static cchar *getMimeType(cchar *path);
+static uint64 hashContent(uchar *data, ssize len);
+static int perfectHash(Page *pages, int count);
+static uchar *readPage(char *file, ssize *size);
+static uint romHash(cchar *path, ssize len, uint seed);
 static void usage();
+static int writeArchive(Page *pages, int count);
+static void writeSource(Page *pages, int count);
 
 /*********************************** Code *************************************/
 
 int main(int argc, char* argv[])
 {
     char    *argp, *fileList, *strip;
-    int     argind;
+    int     argind, gzip, archive;
 
     fileList = NULL;
     strip = "";
+    gzip = 0;
+    archive = 0;
 
     for (argind = 1; argind < argc; argind++) {
         argp = argv[argind];
@@ -36,13 +112,19 @@ int main(int argc, char* argv[])
         } else if (strcmp(argp, "--prefix") == 0 || strcmp(argp, "--strip") == 0) {
             if (argind >= argc) usage();
             strip = argv[++argind];
+        } else if (strcmp(argp, "--archive") == 0) {
+            archive = 1;
+        } else if (strcmp(argp, "--gzip") == 0) {
+            gzip = 1;
+        } else if (strcmp(argp, "--gzip-only") == 0) {
+            gzip = 2;
         }
     }
     if (argind >= argc) {
         usage();
     }
     fileList = argv[argind];
-    if (compile(fileList, strip) < 0) {
+    if (compile(fileList, strip, gzip, archive) < 0) {
         return -1;
     }
     return 0;
@@ -51,7 +133,10 @@ int main(int argc, char* argv[])
 
 static void usage()
 {
-    fprintf(stdout, "usage: webcomp [--strip strip] filelist >output.c\n\
+    fprintf(stdout, "usage: webcomp [--archive] [--gzip] [--gzip-only] [--strip strip] filelist >output.c\n\
+        --archive writes a page archive to map at runtime instead of C source\n\
+        --gzip adds a gzip compressed page.gz variant of each page where smaller\n\
+        --gzip-only stores only the gzip compressed variant where smaller\n\
         --strip specifies is a path prefix to remove from all the web page pathnames\n\
         filelist is a file containing the pathnames of all web pages\n\
         output.c is the resulting C source file to compile and link.\n");
@@ -59,30 +144,22 @@ static void usage()
 }
 
 
-static int compile(char *fileList, char *strip)
+static int compile(char *fileList, char *strip, int gzip, int archive)
 {
     WebsStat        sbuf;
-    WebsTime        now;
     FILE            *lp;
-    char            buf[512], file[ME_GOAHEAD_LIMIT_FILENAME], *cp, *sl;
-    uchar           *p;
-    ssize           len;
-    int             j, i, fd, nFile;
+    Page            *pages;
+    char            file[ME_GOAHEAD_LIMIT_FILENAME], path[ME_GOAHEAD_LIMIT_FILENAME + 4], *cp, *sl, *ext;
+    uchar           *p, *data, *zdata;
+    ssize           len, size, zsize;
+    int             count;
 
     if ((lp = fopen(fileList, "r")) == NULL) {
         fprintf(stderr, "Cannot open file list %s\n", fileList);
         return -1;
     }
-    time(&now);
-    fprintf(stdout, "/*\n   rom.c \n");
-    fprintf(stdout, "   Compiled by webcomp: %s */\n\n", ctime(&now));
-    fprintf(stdout, "#include \"goahead.h\"\n\n");
-    fprintf(stdout, "#if ME_ROM\n\n");
-
-    /*
-        Open each input file and compile each web page
-     */
-    nFile = 0;
+    pages = NULL;
+    count = 0;
     while (fgets(file, sizeof(file), lp) != NULL) {
         if ((p = (uchar*) strchr(file, '\n')) || (p = (uchar*) strchr(file, '\r'))) {
             *p = '\0';
@@ -90,73 +167,131 @@ static int compile(char *fileList, char *strip)
         if (*file == '\0') {
             continue;
         }
+        /*
+            Remove the prefix, add a leading "/" and remove any trailing "/"
+         */
+        while ((sl = strchr(file, '\\')) != NULL) {
+            *sl = '/';
+        }
+        if (strncmp(file, strip, strlen(strip)) == 0) {
+            cp = &file[strlen(strip)];
+        } else {
+            cp = file;
+        }
+        if (*cp == '/') {
+            cp++;
+        }
+        snprintf(path, sizeof(path), "/%s", cp);
+        len = strlen(path);
+        if (len > 1 && path[len - 1] == '/') {
+            path[len - 1] = '\0';
+        }
         if (stat(file, &sbuf) == 0 && sbuf.st_mode & S_IFDIR) {
+            if (addPage(&pages, &count, file, path, NULL, 0, NULL) < 0) {
+                return -1;
+            }
             continue;
         }
-        if ((fd = open(file, O_RDONLY | O_BINARY, 0644)) < 0) {
+        if ((data = readPage(file, &size)) == NULL) {
             fprintf(stderr, "Cannot open file %s\n", file);
             return -1;
         }
-        fprintf(stdout, "/* %s */\n", file);
-        fprintf(stdout, "static uchar p%d[] = {\n", nFile);
-
-        while ((len = read(fd, buf, sizeof(buf))) > 0) {
-            p = (uchar*)buf;
-            for (i = 0; i < len; ) {
-                fprintf(stdout, "\t");
-                for (j = 0; p< (uchar*)(&buf[len]) && j < 16; j++, p++) {
-                    fprintf(stdout, "%4d,", *p);
-                }
-                i += j;
-                fprintf(stdout, "\n");
+        zdata = NULL;
+        zsize = 0;
+        ext = strrchr(path, '.');
+        if (gzip && !(ext && (strcmp(ext, ".gz") == 0 || strcmp(ext, ".br") == 0))) {
+            if ((zdata = compress(file, size, &zsize)) != NULL && zsize >= size) {
+                free(zdata);
+                zdata = NULL;
+            }
+        }
+        if (!zdata || gzip == 1) {
+            if (addPage(&pages, &count, file, path, data, size, getMimeType(path)) < 0) {
+                return -1;
+            }
+        } else {
+            free(data);
+        }
+        if (zdata) {
+            /* The variant is served to clients that accept gzip with the type of the uncompressed page */
+            strcat(path, ".gz");
+            if (addPage(&pages, &count, file, path, zdata, zsize, getMimeType(file)) < 0) {
+                return -1;
             }
         }
-        fprintf(stdout, "\t   0\n};\n\n");
-        close(fd);
-        nFile++;
     }
     fclose(lp);
+    if (perfectHash(pages, count) < 0) {
+        fprintf(stderr, "Cannot generate a perfect hash for the page index, using the default index\n");
+    }
+
+    if (archive) {
+        return writeArchive(pages, count);
+    }
+    writeSource(pages, count);
+    return 0;
+}
+
+
+/*
+    Write the pages as C source to compile and link into the program
+ */
+static void writeSource(Page *pages, int count)
+{
+    WebsTime    now;
+    Page        *pp;
+    uchar       *p;
+    uint64      etag;
+    ssize       i;
+    int         j, nFile;
+
+    time(&now);
+    fprintf(stdout, "/*\n   rom.c \n");
+    fprintf(stdout, "   Compiled by webcomp: %s */\n\n", ctime(&now));
+    fprintf(stdout, "#include \"goahead.h\"\n\n");
+    fprintf(stdout, "#if ME_ROM\n\n");
 
     /*
-        Output the page index
+        Output the content of each web page. The content is constant so it is placed in read-only data
      */
-    fprintf(stdout, "WebsRomIndex websRomIndex[] = {\n");
-
-    if ((lp = fopen(fileList, "r")) == NULL) {
-        fprintf(stderr, "Cannot open file list %s\n", fileList);
-        return -1;
-    }
     nFile = 0;
-    while (fgets(file, sizeof(file), lp) != NULL) {
-        if ((p = (uchar*) strchr(file, '\n')) || (p = (uchar *) strchr(file, '\r'))) {
-            *p = '\0';
-        }
-        if (*file == '\0') {
+    for (pp = pages; pp < &pages[count]; pp++) {
+        if (!pp->data) {
             continue;
         }
-        /*
-            Remove the prefix and add a leading "/" when we print the path
-         */
-        if (strncmp(file, strip, strlen(strip)) == 0) {
-            cp = &file[strlen(strip)];
-        } else {
-            cp = file;
-        }
-        while ((sl = strchr(file, '\\')) != NULL) {
-            *sl = '/';
-        }
-        if (*cp == '/') {
-            cp++;
+        pp->id = nFile++;
+        fprintf(stdout, "/* %s */\n", pp->file);
+        fprintf(stdout, "static const uchar p%d[] = {\n", pp->id);
+        p = pp->data;
+        for (i = 0; i < pp->size; ) {
+            fprintf(stdout, "\t");
+            for (j = 0; i < pp->size && j < 16; j++, i++) {
+                fprintf(stdout, "%4d,", p[i]);
+            }
+            fprintf(stdout, "\n");
         }
+        fprintf(stdout, "\t   0\n};\n\n");
+    }
 
-        if (stat(file, &sbuf) == 0 && sbuf.st_mode & S_IFDIR) {
-            fprintf(stdout, "\t{ \"/%s\", 0, 0 },\n", cp);
+    /*
+        Output the page index in perfect hash order with the precomputed entity tags and headers
+     */
+    fprintf(stdout, "WebsRomIndex websRomIndex[] = {\n");
+    for (pp = pages; pp < &pages[count]; pp++) {
+        if (!pp->data) {
+            fprintf(stdout, "\t{ \"%s\", 0, 0, 0, 0, 0, %d },\n", pp->path, pp->seed);
             continue;
         }
-        fprintf(stdout, "\t{ \"/%s\", p%d, %d },\n", cp, nFile, (int) sbuf.st_size);
-        nFile++;
+        etag = hashContent(pp->data, pp->size);
+        fprintf(stdout, "\t{ \"%s\", (uchar*) p%d, %d, 0, \"\\\"%016llx\\\"\",", pp->path, pp->id, (int) pp->size,
+            (unsigned long long) etag);
+        if (pp->type) {
+            fprintf(stdout, "\n\t  \"Content-Length: %d\\r\\nContent-Type: %s\\r\\nETag: \\\"%016llx\\\"\\r\\n"
+                "Accept-Ranges: bytes\\r\\n\", %d },\n", (int) pp->size, pp->type, (unsigned long long) etag, pp->seed);
+        } else {
+            fprintf(stdout, " 0, %d },\n", pp->seed);
+        }
     }
-    fclose(lp);
     fprintf(stdout, "\t{ 0, 0, 0 }\n");
     fprintf(stdout, "};\n");
     fprintf(stdout, "#else\n");
@@ -164,9 +299,358 @@ static int compile(char *fileList, char *strip)
     fprintf(stdout, "\t{ 0, 0, 0 }\n};\n");
     fprintf(stdout, "#endif\n");
     fflush(stdout);
+}
+
+
+/*
+    Write the pages as a page archive. The header is followed by the index in perfect hash order, the paths, entity
+    tags and headers, and the page content with each page aligned to WEBS_ROM_ALIGN bytes.
+ */
+static int writeArchive(Page *pages, int count)
+{
+    WebsRomHeader   header;
+    WebsRomEntry    *entries, *ep;
+    Page            *pp;
+    char            *strings, etag[32], headers[256];
+    uint64          offset;
+    ssize           len, stringsLen;
+    int             i;
+
+    if ((entries = calloc(count ? count : 1, sizeof(WebsRomEntry))) == NULL) {
+        return -1;
+    }
+    strings = NULL;
+    stringsLen = 0;
+    offset = sizeof(WebsRomHeader) + count * sizeof(WebsRomEntry);
+    for (i = 0; i < count; i++) {
+        pp = &pages[i];
+        ep = &entries[i];
+        ep->seed = pp->seed;
+        ep->path = (uint) (offset + addString(&strings, &stringsLen, pp->path));
+        if (pp->data) {
+            snprintf(etag, sizeof(etag), "\"%016llx\"", (unsigned long long) hashContent(pp->data, pp->size));
+            ep->etag = (uint) (offset + addString(&strings, &stringsLen, etag));
+            if (pp->type) {
+                snprintf(headers, sizeof(headers),
+                    "Content-Length: %d\r\nContent-Type: %s\r\nETag: %s\r\nAccept-Ranges: bytes\r\n",
+                    (int) pp->size, pp->type, etag);
+                ep->headers = (uint) (offset + addString(&strings, &stringsLen, headers));
+            }
+        }
+        if (strings == NULL) {
+            fprintf(stderr, "Cannot allocate memory\n");
+            free(entries);
+            return -1;
+        }
+    }
+    offset = ALIGN_ROM(offset + stringsLen);
+    for (i = 0; i < count; i++) {
+        if (pages[i].data) {
+            entries[i].data = offset;
+            entries[i].size = pages[i].size;
+            offset = ALIGN_ROM(offset + pages[i].size);
+        }
+    }
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, WEBS_ROM_MAGIC, sizeof(WEBS_ROM_MAGIC));
+    header.version = WEBS_ROM_VERSION;
+    header.count = count;
+    header.size = offset;
+
+#if ME_WIN_LIKE
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    fwrite(&header, sizeof(header), 1, stdout);
+    fwrite(entries, sizeof(WebsRomEntry), count, stdout);
+    fwrite(strings, 1, stringsLen, stdout);
+    offset = sizeof(WebsRomHeader) + count * sizeof(WebsRomEntry) + stringsLen;
+    for (i = 0; i < count; i++) {
+        if (pages[i].data) {
+            len = (ssize) (entries[i].data - offset);
+            fwrite(zeros, 1, len, stdout);
+            fwrite(pages[i].data, 1, pages[i].size, stdout);
+            offset = entries[i].data + pages[i].size;
+        }
+    }
+    fwrite(zeros, 1, (ssize) (header.size - offset), stdout);
+    free(entries);
+    free(strings);
+    if (fflush(stdout) != 0 || ferror(stdout)) {
+        fprintf(stderr, "Cannot write the page archive\n");
+        return -1;
+    }
     return 0;
 }
 
+
+/*
+    Append a string to the archive strings. Returns the offset of the string in the strings. On allocation failure
+    the strings are freed and set to null.
+ */
+static ssize addString(char **strings, ssize *size, cchar *str)
+{
+    char    *grown;
+    ssize   offset, len;
+
+    offset = *size;
+    len = strlen(str) + 1;
+    if (*strings == NULL && *size > 0) {
+        /* A prior allocation failed. The caller tests for a null strings pointer */
+        return 0;
+    }
+    if ((grown = realloc(*strings, *size + len)) == NULL) {
+        free(*strings);
+        *strings = NULL;
+        return 0;
+    }
+    *strings = grown;
+    memcpy(&(*strings)[offset], str, len);
+    *size += len;
+    return offset;
+}
+
+
+static int addPage(Page **pages, int *count, char *file, char *path, uchar *data, ssize size, cchar *type)
+{
+    Page    *pp;
+
+    if ((*pages = realloc(*pages, (*count + 1) * sizeof(Page))) == NULL) {
+        fprintf(stderr, "Cannot allocate memory\n");
+        return -1;
+    }
+    pp = &(*pages)[(*count)++];
+    memset(pp, 0, sizeof(Page));
+    pp->file = strdup(file);
+    pp->path = strdup(path);
+    pp->data = data;
+    pp->size = size;
+    pp->type = type;
+    return 0;
+}
+
+
+static uchar *readPage(char *file, ssize *size)
+{
+    uchar   *data;
+    ssize   len;
+    int     fd;
+
+    if ((fd = open(file, O_RDONLY | O_BINARY, 0644)) < 0) {
+        return NULL;
+    }
+    *size = 0;
+    data = NULL;
+    do {
+        if ((data = realloc(data, *size + ME_BUFSIZE)) == NULL) {
+            close(fd);
+            return NULL;
+        }
+        len = read(fd, &data[*size], ME_BUFSIZE);
+        if (len > 0) {
+            *size += len;
+        }
+    } while (len > 0);
+    close(fd);
+    if (len < 0) {
+        free(data);
+        return NULL;
+    }
+    return data;
+}
+
+
+/*
+    Compress a page with the system gzip command. The header omits the filename and time so the output is reproducible.
+ */
+static uchar *compress(char *file, ssize size, ssize *compressedSize)
+{
+    FILE    *fp;
+    uchar   *data;
+    char    cmd[ME_GOAHEAD_LIMIT_FILENAME + 32];
+    ssize   len;
+
+    if (strchr(file, '"')) {
+        return NULL;
+    }
+    snprintf(cmd, sizeof(cmd), "gzip -9 -n -c \"%s\"", file);
+    if ((fp = popen(cmd, "r")) == NULL) {
+        return NULL;
+    }
+    if ((data = malloc(size + ME_BUFSIZE)) == NULL) {
+        pclose(fp);
+        return NULL;
+    }
+    /* Stop reading once the output is no smaller than the page */
+    *compressedSize = 0;
+    while (*compressedSize < size && (len = fread(&data[*compressedSize], 1, ME_BUFSIZE, fp)) > 0) {
+        *compressedSize += len;
+    }
+    if (pclose(fp) != 0 || *compressedSize == 0) {
+        free(data);
+        return NULL;
+    }
+    return data;
+}
+
+
+static cchar *getMimeType(cchar *path)
+{
+    cchar   *ext, **mp;
+
+    if ((ext = strrchr(path, '.')) == NULL) {
+        return NULL;
+    }
+    for (mp = mimeTypes; *mp; mp += 2) {
+        if (strcmp(ext, *mp) == 0) {
+            return mp[1];
+        }
+    }
+    return NULL;
+}
+
+
+/*
+    Generate a minimal perfect hash over the page paths using hash and displace. Pages are hashed into buckets and the
+    buckets are placed largest first. A bucket with several pages gets the seed that rehashes them all into free slots.
+    A bucket with one page stores the slot directly as a negative number. The pages are then ordered by slot.
+ */
+static int perfectHash(Page *pages, int count)
+{
+    Page        *sorted;
+    Bucket      *buckets, *bp;
+    char        *used;
+    int         *members, *hashes, *slots, *seeds, i, j, k, next, seed, rc;
+
+    if (count == 0) {
+        return 0;
+    }
+    buckets = calloc(count, sizeof(Bucket));
+    members = calloc(count, sizeof(int));
+    hashes = calloc(count, sizeof(int));
+    used = calloc(count, 1);
+    slots = calloc(count, sizeof(int));
+    seeds = calloc(count, sizeof(int));
+    sorted = calloc(count, sizeof(Page));
+    rc = -1;
+    if (!buckets || !members || !hashes || !used || !slots || !seeds || !sorted) {
+        goto done;
+    }
+    /*
+        Count the pages in each bucket, then give each bucket its slice of the members array
+     */
+    for (i = 0; i < count; i++) {
+        hashes[i] = romHash(pages[i].path, strlen(pages[i].path), 0) % count;
+        buckets[hashes[i]].count++;
+    }
+    for (i = 0, next = 0; i < count; i++) {
+        buckets[i].index = i;
+        buckets[i].pages = &members[next];
+        next += buckets[i].count;
+        buckets[i].count = 0;
+    }
+    for (i = 0; i < count; i++) {
+        bp = &buckets[hashes[i]];
+        bp->pages[bp->count++] = i;
+    }
+    qsort(buckets, count, sizeof(Bucket), byCount);
+
+    for (bp = buckets; bp < &buckets[count] && bp->count > 1; bp++) {
+        for (seed = 1; seed < MAX_SEED; seed++) {
+            for (j = 0; j < bp->count; j++) {
+                slots[j] = romHash(pages[bp->pages[j]].path, strlen(pages[bp->pages[j]].path), seed) % count;
+                for (k = 0; k < j && slots[k] != slots[j]; k++) ;
+                if (used[slots[j]] || k < j) {
+                    break;
+                }
+            }
+            if (j == bp->count) {
+                break;
+            }
+        }
+        if (seed >= MAX_SEED) {
+            goto done;
+        }
+        for (j = 0; j < bp->count; j++) {
+            used[slots[j]] = 1;
+            sorted[slots[j]] = pages[bp->pages[j]];
+        }
+        seeds[bp->index] = seed;
+    }
+    for (next = 0; bp < &buckets[count] && bp->count == 1; bp++) {
+        while (used[next]) {
+            next++;
+        }
+        used[next] = 1;
+        sorted[next] = pages[bp->pages[0]];
+        seeds[bp->index] = -next - 1;
+    }
+    /* Lookups for missing pages may land in empty buckets. Any nonzero seed will do */
+    for (; bp < &buckets[count]; bp++) {
+        seeds[bp->index] = 1;
+    }
+    for (i = 0; i < count; i++) {
+        pages[i] = sorted[i];
+        pages[i].seed = seeds[i];
+    }
+    rc = 0;
+
+done:
+    free(buckets);
+    free(members);
+    free(hashes);
+    free(used);
+    free(slots);
+    free(seeds);
+    free(sorted);
+    return rc;
+}
+
+
+static int byCount(const void *a, const void *b)
+{
+    return ((Bucket*) b)->count - ((Bucket*) a)->count;
+}
+
+
+/*
+    Hash the page content with a 64-bit FNV-1a hash for the entity tag
+ */
+static uint64 hashContent(uchar *data, ssize len)
+{
+    uint64  hash;
+    ssize   i;
+
+    hash = 14695981039346656037ULL;
+    for (i = 0; i < len; i++) {
+        hash = (hash ^ data[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+/*
+    Hash a page path. This must match romHash() in src/fs.c.
+ */
+static uint romHash(cchar *path, ssize len, uint seed)
+{
+    uint    hash;
+    ssize   i;
+
+    hash = 2166136261U ^ seed;
+    if (*path != '/') {
+        hash = (hash ^ '/') * 16777619U;
+    }
+    for (i = 0; i < len; i++) {
+        hash = (hash ^ (uchar) path[i]) * 16777619U;
+    }
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bU;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35U;
+    hash ^= hash >> 16;
+    return hash;
+}
+
 /*
     Copyright (c) Embedthis Software. All Rights Reserved.
     This software is distributed under a commercial license. Consult the LICENSE.md
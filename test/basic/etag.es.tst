@@ -0,0 +1,47 @@
+/*
+    etag.tst - Entity tag and conditional request tests
+ */
+
+const HTTP = tget('TM_HTTP') || "127.0.0.1:8080"
+const URL = HTTP + "/index.html"
+let http: Http = new Http
+
+//  Documents have a strong entity tag
+http.get(URL)
+ttrue(http.status == 200)
+let etag = http.header("ETag")
+ttrue(etag && etag.startsWith('"'))
+http.close()
+
+//  Matching entity tag
+http.setHeader("If-None-Match", etag)
+http.get(URL)
+ttrue(http.status == 304)
+ttrue(http.header("ETag") == etag)
+http.close()
+
+//  Weak comparison and lists
+http.setHeader("If-None-Match", '"other", W/' + etag)
+http.get(URL)
+ttrue(http.status == 304)
+http.close()
+
+http.setHeader("If-None-Match", "*")
+http.get(URL)
+ttrue(http.status == 304)
+http.close()
+
+//  Entity tag that does not match takes precedence over If-Modified-Since
+http.setHeader("If-None-Match", '"other"')
+http.setHeader("If-Modified-Since", "Fri, 01 Jan 2100 00:00:00 GMT")
+http.get(URL)
+ttrue(http.status == 200)
+http.close()
+
+//  If-Range with a matching entity tag sends the range
+http.setHeader("Range", "bytes=0-4")
+http.setHeader("If-Range", etag)
+http.get(URL)
+ttrue(http.status == 206)
+ttrue(http.response.length == 5)
+http.close()
@@ -0,0 +1,23 @@
+/*
+    pool.tst - Test pooled requests do not retain large buffers
+ */
+
+const HTTP = tget('TM_HTTP') || "127.0.0.1:8080"
+
+//  Keep one connection open to query the pool while the other is idle
+let http: Http = new Http
+http.get(HTTP + "/action/poolTest")
+ttrue(http.status == 200)
+
+let post: Http = new Http
+let data = "x".times(16000)
+post.post(HTTP + "/action/test", data)
+ttrue(post.status == 200)
+post.close()
+App.sleep(250)
+
+http.get(HTTP + "/action/poolTest")
+ttrue(http.status == 200)
+let largest = http.response.match(/largest: (\d+)/)
+ttrue(largest && Number(largest[1]) < data.length)
+http.close()
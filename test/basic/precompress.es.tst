@@ -0,0 +1,39 @@
+/*
+    precompress.tst - Precompressed document tests
+ */
+
+const HTTP = tget('TM_HTTP') || "127.0.0.1:8080"
+const URL = HTTP + "/compress/compressed.txt"
+let http: Http = new Http
+
+//  The gzip variant is served to clients that accept it
+http.setHeader("Accept-Encoding", "gzip")
+http.get(URL)
+ttrue(http.status == 200)
+ttrue(http.header("Content-Encoding") == "gzip")
+ttrue(http.header("Vary") == "Accept-Encoding")
+ttrue(http.contentType.contains("text/plain"))
+http.close()
+
+//  Refused encodings are not served
+http.setHeader("Accept-Encoding", "gzip;q=0, identity")
+http.get(URL)
+ttrue(http.status == 200)
+ttrue(!http.header("Content-Encoding"))
+ttrue(http.header("Vary") == "Accept-Encoding")
+http.close()
+
+//  Documents without variants do not vary
+http.setHeader("Accept-Encoding", "gzip")
+http.get(HTTP + "/index.html")
+ttrue(http.status == 200)
+ttrue(!http.header("Content-Encoding"))
+ttrue(!http.header("Vary"))
+http.close()
+
+//  Missing documents are not negotiated
+http.setHeader("Accept-Encoding", "gzip")
+http.get(HTTP + "/compress/missing.txt")
+ttrue(http.status == 404)
+ttrue(!http.header("Vary"))
+http.close()
@@ -0,0 +1,60 @@
+/*
+    range.tst - Http byte range tests
+ */
+
+const HTTP = tget('TM_HTTP') || "127.0.0.1:8080"
+const URL = HTTP + "/big.txt"
+let http: Http = new Http
+
+//  Whole document advertises ranges
+http.get(URL)
+ttrue(http.status == 200)
+ttrue(http.header("Accept-Ranges") == "bytes")
+let size = http.response.length
+http.close()
+
+//  Single range
+http.setHeader("Range", "bytes=0-9")
+http.get(URL)
+ttrue(http.status == 206)
+ttrue(http.response == "0123456789")
+ttrue(http.header("Content-Range") == "bytes 0-9/" + size)
+http.close()
+
+//  Suffix range
+http.setHeader("Range", "bytes=-5")
+http.get(URL)
+ttrue(http.status == 206)
+ttrue(http.response.length == 5)
+ttrue(http.header("Content-Range") == "bytes " + (size - 5) + "-" + (size - 1) + "/" + size)
+http.close()
+
+//  Multiple ranges
+http.setHeader("Range", "bytes=0-4,10-14")
+http.get(URL)
+ttrue(http.status == 206)
+ttrue(http.contentType.contains("multipart/byteranges; boundary="))
+ttrue(http.response.contains("Content-Range: bytes 0-4/" + size))
+ttrue(http.response.contains("Content-Range: bytes 10-14/" + size))
+http.close()
+
+//  Unsatisfiable range
+http.setHeader("Range", "bytes=" + size + "-")
+http.get(URL)
+ttrue(http.status == 416)
+ttrue(http.header("Content-Range") == "bytes */" + size)
+http.close()
+
+//  Invalid ranges are ignored
+http.setHeader("Range", "bytes=9-0")
+http.get(URL)
+ttrue(http.status == 200)
+http.close()
+
+//  If-Range with an entity tag that does not match sends the whole document
+http.setHeader("Range", "bytes=0-9")
+http.setHeader("If-Range", '"no-match"')
+http.get(URL)
+ttrue(http.status == 200)
+ttrue(http.response.length == size)
+http.close()
@@ -0,0 +1,157 @@
+/*
+    routebench.c - Benchmark for the route index
+
+    Copyright (c) All Rights Reserved. See details at the end of the file.
+
+    Usage:
+        routebench [routes] [iterations]
+
+    Loads a synthetic route file and routes a set of request paths with the route index and then with a linear scan
+    of every route. Reports nanoseconds per request and verifies both select the same route.
+ */
+
+/********************************** Includes **********************************/
+
+#include    "goahead.h"
+
+/*********************************** Locals ***********************************/
+
+#define ROUTE_FILE  "routebench.txt"
+
+typedef struct Request {
+    cchar   *method;
+    char    *path;
+} Request;
+
+/***************************** Forward Declarations ***************************/
+
+static int makeRoutes(cchar *path, int count);
+static WebsRoute *route(Webs *wp, Request *rp);
+static double run(Webs *wp, Request *requests, int count, int iterations);
+
+/*********************************** Code *************************************/
+
+MAIN(routebench, int argc, char **argv, char **envp)
+{
+    Webs        wp;
+    Request     requests[6];
+    WebsRoute   *indexed;
+    double      scan, index;
+    int         i, count, iterations;
+
+    count = (argc > 1) ? atoi(argv[1]) : 1000;
+    iterations = (argc > 2) ? atoi(argv[2]) : 2000;
+    if (count <= 0 || iterations <= 0) {
+        fprintf(stderr, "usage: routebench [routes] [iterations]\n");
+        return 1;
+    }
+    websRuntimeOpen();
+    websOpenRoute();
+    websDefineHandler("bench", 0, 0, 0, 0);
+    if (makeRoutes(ROUTE_FILE, count) < 0 || websLoad(ROUTE_FILE) < 0) {
+        fprintf(stderr, "Cannot load %s\n", ROUTE_FILE);
+        return 1;
+    }
+    unlink(ROUTE_FILE);
+
+    requests[0].method = "GET";
+    requests[0].path = sclone("/api/v1/service0/items");
+    requests[1].method = "GET";
+    requests[1].path = sfmt("/api/v1/service%d/items", count / 2);
+    requests[2].method = "POST";
+    requests[2].path = sfmt("/api/v1/service%d/items", count - 1);
+    requests[3].method = "GET";
+    requests[3].path = sfmt("/static/%d/app.js", count - 1);
+    requests[4].method = "GET";
+    requests[4].path = sclone("/index.html");
+    requests[5].method = "GET";
+    requests[5].path = sclone("/unknown/path");
+
+    memset(&wp, 0, sizeof(wp));
+    wp.protocol = "http";
+    for (i = 0; i < 6; i++) {
+        websSetRouteIndex(1);
+        indexed = route(&wp, &requests[i]);
+        websSetRouteIndex(0);
+        if (route(&wp, &requests[i]) != indexed) {
+            printf("Route mismatch for %s %s\n", requests[i].method, requests[i].path);
+            return 1;
+        }
+    }
+    printf("%d routes, %d iterations\n", count, iterations);
+    printf("%-8s %-36s %12s %12s %9s\n", "method", "path", "scan ns", "index ns", "speedup");
+    for (i = 0; i < 6; i++) {
+        websSetRouteIndex(0);
+        scan = run(&wp, &requests[i], 1, iterations);
+        websSetRouteIndex(1);
+        index = run(&wp, &requests[i], 1, iterations);
+        printf("%-8s %-36s %12.0f %12.0f %8.1fx\n", requests[i].method, requests[i].path, scan, index,
+            scan / max(index, 1));
+    }
+    for (i = 0; i < 6; i++) {
+        wfree(requests[i].path);
+    }
+    websReleaseRoutes(&wp);
+    websCloseRoute();
+    return 0;
+}
+
+
+/*
+    Write a route file with count API routes restricted by method, count static routes restricted by extension and a
+    default route.
+ */
+static int makeRoutes(cchar *path, int count)
+{
+    FILE    *fp;
+    int     i;
+
+    if ((fp = fopen(path, "w")) == 0) {
+        return -1;
+    }
+    for (i = 0; i < count; i++) {
+        fprintf(fp, "route uri=/api/v1/service%d/ methods=GET|POST handler=bench\n", i);
+        fprintf(fp, "route uri=/static/%d/ extensions=js,css,png handler=bench\n", i);
+    }
+    fprintf(fp, "route uri=/ handler=bench\n");
+    return fclose(fp) == 0 ? 0 : -1;
+}
+
+
+static WebsRoute *route(Webs *wp, Request *rp)
+{
+    char    *ext;
+
+    wp->method = (char*) rp->method;
+    wp->path = rp->path;
+    wp->url = rp->path;
+    wp->ext = ((ext = strrchr(rp->path, '.')) != 0) ? ext : 0;
+    wp->route = 0;
+    wp->flags = 0;
+    websRouteRequest(wp);
+    return wp->route;
+}
+
+
+/*
+    Return the average nanoseconds to route a request
+ */
+static double run(Webs *wp, Request *requests, int count, int iterations)
+{
+    int64   start;
+    int     i, j;
+
+    start = websGetMicroTicks();
+    for (i = 0; i < iterations; i++) {
+        for (j = 0; j < count; j++) {
+            route(wp, &requests[j]);
+        }
+    }
+    return (double) (websGetMicroTicks() - start) * 1000 / ((double) iterations * count);
+}
+
+/*
+    Copyright (c) Embedthis Software. All Rights Reserved.
+    This software is distributed under a commercial license. Consult the LICENSE.md
+    distributed with this software for full details and copyrights.
+ */
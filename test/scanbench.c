@@ -0,0 +1,201 @@
+/*
+    scanbench.c - Micro-benchmark for the HTTP header terminator scanner
+
+    Copyright (c) All Rights Reserved. See details at the end of the file.
+
+    Usage:
+        scanbench [iterations]
+
+    Measures websFindHeaderEnd against strstr for typical and adversarial header sets and reports bytes per cycle.
+    It also compares rescanning the whole buffer on each read against resuming the scan, when headers arrive a few
+    bytes at a time.
+ */
+
+/********************************** Includes **********************************/
+
+#include    "goahead.h"
+
+#if ME_CPU_ARCH == ME_CPU_X86 || ME_CPU_ARCH == ME_CPU_X64
+    #if defined(_MSC_VER)
+        #include    <intrin.h>
+    #else
+        #include    <x86intrin.h>
+    #endif
+    #define HAS_TSC 1
+#else
+    #define HAS_TSC 0
+#endif
+
+/*********************************** Locals ***********************************/
+
+#define SEGMENT     8               /* Bytes per read for the slow client run */
+
+typedef struct Sample {
+    cchar   *name;
+    char    *headers;
+    ssize   len;
+} Sample;
+
+static volatile ssize sink;
+
+/***************************** Forward Declarations ***************************/
+
+static uint64 cycles(void);
+static char *makeHeaders(cchar *fill, int count);
+static void runSample(Sample *sp, int iterations);
+static void runSlow(Sample *sp, int iterations);
+
+/*********************************** Code *************************************/
+
+MAIN(scanbench, int argc, char **argv, char **envp)
+{
+    Sample  samples[4];
+    int     i, iterations;
+
+    iterations = (argc > 1) ? atoi(argv[1]) : 20000;
+    if (iterations <= 0) {
+        iterations = 20000;
+    }
+    samples[0].name = "typical";
+    samples[0].headers = sclone(
+        "GET /index.html HTTP/1.1\r\n"
+        "Host: www.example.com\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+        "Accept-Language: en-US,en;q=0.9\r\n"
+        "Accept-Encoding: gzip, deflate, br\r\n"
+        "Cookie: session=7f3c2a9b0e1d4c5f8a6b3e2d1c0f9a8b; theme=dark; lang=en\r\n"
+        "Connection: keep-alive\r\n"
+        "Upgrade-Insecure-Requests: 1\r\n\r\n");
+    samples[1].name = "large-cookie";
+    samples[1].headers = makeHeaders("Cookie: k=0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef\r\n", 100);
+    samples[2].name = "many-short";
+    samples[2].headers = makeHeaders("A: b\r\n", 1000);
+    /*
+        Every fourth byte is a CR followed by a LF three bytes later. Each one is a scanner candidate that fails.
+     */
+    samples[3].name = "adversarial";
+    samples[3].headers = makeHeaders("X: \r\n\n\n", 1000);
+
+    printf("%-14s %8s %14s %14s %9s\n", "headers", "bytes", "scan b/cycle", "strstr b/cycle", "speedup");
+    for (i = 0; i < 4; i++) {
+        samples[i].len = slen(samples[i].headers);
+        runSample(&samples[i], iterations);
+    }
+    printf("\nSlow client, %d bytes per read\n", SEGMENT);
+    printf("%-14s %8s %14s %14s %9s\n", "headers", "bytes", "resume cycles", "rescan cycles", "speedup");
+    for (i = 0; i < 4; i++) {
+        runSlow(&samples[i], max(iterations / 100, 1));
+    }
+    for (i = 0; i < 4; i++) {
+        wfree(samples[i].headers);
+    }
+    return 0;
+}
+
+
+/*
+    Build a request with count copies of the fill header
+ */
+static char *makeHeaders(cchar *fill, int count)
+{
+    WebsBuf     buf;
+    char        *result;
+    int         i;
+
+    bufCreate(&buf, 0, 65536);
+    bufPutStr(&buf, "GET / HTTP/1.1\r\nHost: localhost\r\n");
+    for (i = 0; i < count; i++) {
+        bufPutStr(&buf, fill);
+    }
+    bufPutStr(&buf, "\r\n");
+    bufAddNull(&buf);
+    result = sclone(buf.servp);
+    bufFree(&buf);
+    return result;
+}
+
+
+static void runSample(Sample *sp, int iterations)
+{
+    uint64  start, scan, base;
+    int     i;
+
+    if (websFindHeaderEnd(sp->headers, sp->len) != strstr(sp->headers, "\r\n\r\n")) {
+        printf("%-14s scanner mismatch\n", sp->name);
+        exit(1);
+    }
+    start = cycles();
+    for (i = 0; i < iterations; i++) {
+        sink += websFindHeaderEnd(sp->headers, sp->len) - sp->headers;
+    }
+    scan = max(cycles() - start, 1);
+
+    start = cycles();
+    for (i = 0; i < iterations; i++) {
+        sink += strstr(sp->headers, "\r\n\r\n") - sp->headers;
+    }
+    base = max(cycles() - start, 1);
+
+    printf("%-14s %8d %14.2f %14.2f %8.1fx\n", sp->name, (int) sp->len,
+        (double) sp->len * iterations / scan, (double) sp->len * iterations / base, (double) base / scan);
+}
+
+
+/*
+    Simulate headers arriving SEGMENT bytes per read. Compare resuming the scan (as parseIncoming does) with
+    rescanning the entire buffer with strstr on every read.
+ */
+static void runSlow(Sample *sp, int iterations)
+{
+    uint64  start, resume, rescan;
+    ssize   len, scanned, from;
+    char    *buf, *end;
+    int     i;
+
+    buf = walloc(sp->len + 1);
+    memcpy(buf, sp->headers, sp->len + 1);
+    resume = rescan = 0;
+    for (i = 0; i < iterations; i++) {
+        start = cycles();
+        for (len = 0, scanned = 0, end = 0; !end && len < sp->len; ) {
+            len = min(len + SEGMENT, sp->len);
+            from = max(scanned - 3, 0);
+            end = websFindHeaderEnd(&buf[from], len - from);
+            scanned = len;
+        }
+        resume += cycles() - start;
+
+        start = cycles();
+        for (len = 0, end = 0; !end && len < sp->len; ) {
+            len = min(len + SEGMENT, sp->len);
+            buf[len] = '\0';
+            end = strstr(buf, "\r\n\r\n");
+            buf[len] = sp->headers[len];
+        }
+        rescan += cycles() - start;
+        sink += end - buf;
+    }
+    printf("%-14s %8d %14.0f %14.0f %8.1fx\n", sp->name, (int) sp->len,
+        (double) resume / iterations, (double) rescan / iterations, (double) rescan / max(resume, 1));
+    wfree(buf);
+}
+
+
+/*
+    Return a cycle count. Without a time stamp counter, fall back to nanoseconds.
+ */
+static uint64 cycles(void)
+{
+#if HAS_TSC
+    return __rdtsc();
+#else
+    return websGetTicks() * 1000000;
+#endif
+}
+
+/*
+    Copyright (c) Embedthis Software. All Rights Reserved.
+    This software is distributed under a commercial license. Consult the LICENSE.md
+    distributed with this software for full details and copyrights.
+ */
@@ -53,3 +53,19 @@ for (count = 0; (n = s.read(response, -1)) != null; count += n) { }
 ttrue(response.toString().contains('200 OK'))
 ttrue(response.toString().contains('Hello /index'))
 s.close()
+
+//  Headers trickled a few bytes at a time with the terminator split across writes
+s = new Socket
+s.connect(HTTP.address)
+let request = "GET /index.html HTTP/1.0\r\nAccept: */*\r\nUser-Agent: delay\r\n\r"
+for (i = 0; i < request.length; i += 5) {
+    s.write(request.slice(i, i + 5))
+    App.sleep(10)
+}
+App.sleep(DELAY)
+s.write("\n")
+response = new ByteArray
+for (count = 0; (n = s.read(response, -1)) != null; count += n) { }
+ttrue(response.toString().contains('200 OK'))
+ttrue(response.toString().contains('Hello /index'))
+s.close()
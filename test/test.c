@@ -52,6 +52,7 @@ static int aspTest(int eid, Webs *wp, int argc, char **argv);
 static int bigTest(int eid, Webs *wp, int argc, char **argv);
 #endif
 static void actionTest(Webs *wp);
+static void poolTest(Webs *wp);
 static void sessionTest(Webs *wp);
 static void showTest(Webs *wp);
 #if ME_GOAHEAD_UPLOAD && !ME_ROM
@@ -114,6 +115,11 @@ MAIN(goahead, int argc, char **argv, char **envp)
         } else if (smatch(argp, "--route") || smatch(argp, "-r")) {
             route = argv[++argind];
 
+#if ME_GOAHEAD_THREADS
+        } else if (smatch(argp, "--threads")) {
+            websSetThreads(atoi(argv[++argind]));
+#endif
+
         } else if (smatch(argp, "--version") || smatch(argp, "-V")) {
             printf("%s\n", ME_VERSION);
             exit(0);
@@ -174,6 +180,7 @@ MAIN(goahead, int argc, char **argv, char **envp)
     websDefineJst("bigTest", bigTest);
 #endif
     websDefineAction("test", actionTest);
+    websDefineAction("poolTest", poolTest);
     websDefineAction("sessionTest", sessionTest);
     websDefineAction("showTest", showTest);
 #if ME_GOAHEAD_UPLOAD && !ME_ROM
@@ -339,6 +346,22 @@ static void actionTest(Webs *wp)
 }
 
 
+/*
+    Implement /action/poolTest. Report the request pool statistics of this thread.
+ */
+static void poolTest(Webs *wp)
+{
+    WebsPoolStats   stats;
+
+    websGetPoolStats(&stats);
+    websSetStatus(wp, 200);
+    websWriteHeaders(wp, -1, 0);
+    websWriteEndHeaders(wp);
+    websWrite(wp, "<html><body><p>idle: %d, largest: %d</p></body></html>\n", stats.idle, (int) stats.largestBuffer);
+    websDone(wp);
+}
+
+
 static void sessionTest(Webs *wp)
 {
 	cchar	*number;
@@ -365,6 +388,7 @@ static void showTest(Webs *wp)
     websWriteHeaders(wp, -1, 0);
     websWriteEndHeaders(wp);
     websWrite(wp, "<html><body><pre>\n");
+    websSetHeaderVars(wp);
     for (s = hashFirst(wp->vars); s; s = hashNext(wp->vars, s)) {
         websWrite(wp, "%s=%s\n", s->name.value.string, s->content.value.string);
     }
@@ -402,6 +426,7 @@ static void uploadTest(Webs *wp)
             wfree(upfile);
         }
         websWrite(wp, "\r\nVARS:\r\n");
+        websSetHeaderVars(wp);
         for (s = hashFirst(wp->vars); s; s = hashNext(wp->vars, s)) {
             websWrite(wp, "%s=%s\r\n", s->name.value.string, s->content.value.string);
         }